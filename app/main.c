@@ -3,224 +3,712 @@
 #include <stdio.h>
 #include <string.h>
 #include <sys/wait.h>
+#include <time.h>
 #include <unistd.h>
 #include <readline/readline.h>
 #include <readline/history.h>
 
 #include "../src/lab.h"
+#include "../src/eventloop.h"
+#include "../src/histfile.h"
+#include "../src/jobs.h"
+#include "../src/launch.h"
+#include "../src/linereader.h"
+#include "../src/pathcache.h"
+#include "../src/reaper.h"
+#include "../src/redirect.h"
+#include "../src/server.h"
+#include "../src/shstat.h"
+#include "../src/usage.h"
+#include "../src/zygote.h"
 
 /**
- * @brief creates a jobNode from a job in order to add it to a jobNode linked list.
+ * @brief helper/wrapper function that prepares for program exit by freeing
+ * memory owned by the parameters.
+ *
+ * @param sh the shell struct to call sh_destroy on.
+ * @param table the table of jobs to free.
+ */
+void prepareForExit(struct shell *sh, jobTable *table)
+{
+    zygote_stop();
+    sh_destroy(sh);
+    jobs_destroy(table);
+}
+
+/**
+ * @brief what happened when a line was run.
+ */
+typedef enum lineResult {
+    LINE_DONE,    // Keep reading lines
+    LINE_EXIT,    // The exit builtin was run
+    LINE_FAILED,  // Memory ran out, so the shell has to stop
+} lineResult;
+
+/**
+ * @brief true for the pids of running jobs.
+ */
+static bool isJob(pid_t pid, void *context)
+{
+    UNUSED(context);
+    return jobs_find_pid(&jobs, pid) != NULL;
+}
+
+/**
+ * @brief true for the process being waited for.
+ */
+static bool isPid(pid_t pid, void *waitingFor)
+{
+    return pid == *(pid_t *)waitingFor;
+}
+
+/**
+ * @brief true for the process being waited for, and for running jobs.
+ */
+static bool isPidOrJob(pid_t pid, void *waitingFor)
+{
+    return pid == *(pid_t *)waitingFor || isJob(pid, NULL);
+}
+
+/**
+ * @brief waits for every process of a foreground pipeline, then takes the
+ * terminal back if the shell is interactive. While jobs are queued, the jobs
+ * that finish meanwhile are marked done so queued ones can take their slots.
  *
- * @param newJob the job to create a jobNode from
- * @return a jobNode containing the info from newJob, ready to be added to a
- * jobNode linked list.
+ * @param sh the shell
+ * @param pids the processes to wait for
+ * @param count the number of processes
+ * @param usage set to the resources the processes used, summed with usage_add
+ * @return the wait status of the last process, or 0 if there were none
  */
-jobNode *createJobNode(job newJob)
+int waitForForeground(struct shell *sh, const pid_t *pids, size_t count, struct rusage *usage)
 {
-    jobNode *newJobNode = (jobNode *)malloc(sizeof(jobNode));
-    if (newJobNode == NULL) {
-        perror("Error allocating job node.");
-        return NULL;
+    int status = 0;
+    memset(usage, 0, sizeof(*usage));
+    SHSTAT_BEGIN(waitStart);
+    for (size_t idx = 0; idx < count; idx++)
+    {
+        pid_t waitingFor = pids[idx];
+        childExit exited;
+        while (true)
+        {
+            reaper_wait_matching(jobs.firstQueued != NULL ? isPidOrJob : isPid, &waitingFor, &exited);
+            if (exited.pid == waitingFor)
+                break;
+            finishJob(sh, &jobs, &exited);
+        }
+        usage_add(usage, &exited.usage);
+        status = exited.status;
+    }
+    SHSTAT_END(waitStart, SHSTAT_WAIT);
+    if (!sh->shell_is_interactive)
+    {
+        return status;
     }
 
-    newJobNode->info = newJob;
-    newJobNode->next = NULL;
-    return newJobNode;
+    SHSTAT_BEGIN(terminalStart);
+    pid_t processGroup = getpgid(getpid());
+    if (processGroup == (pid_t)-1)
+    {
+        perror("Error getting process group of parent process");
+    }
+    int result = tcsetpgrp(sh->shell_terminal, processGroup); // Regain control of the terminal
+    if (result == -1)
+    {
+        perror("Error setting terminal foreground process group");
+    }
+
+    // Restore the shell's terminal modes in case the child process messed it up.
+    tcsetattr(sh->shell_terminal, TCSADRAIN, &sh->shell_tmodes);
+    SHSTAT_END(terminalStart, SHSTAT_TERMINAL);
+    return status;
+}
+
+/**
+ * @brief reports the jobs that finished, then starts queued jobs in the
+ * slots they freed.
+ */
+void manageJobs(struct shell *sh)
+{
+    reportAndManageFinishedJobs(&jobs, sh->shell_is_interactive, false);
+    admitQueuedJobs(sh, &jobs);
+}
+
+/**
+ * @brief returns the seconds from startTime, by CLOCK_MONOTONIC, until now.
+ */
+double secondsSince(const struct timespec *startTime)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - startTime->tv_sec) + (now.tv_nsec - startTime->tv_nsec) / 1e9;
+}
+
+/**
+ * @brief turns a wait status into an exit status, which is 128 plus the
+ * signal number for a process that was killed.
+ */
+int exitStatus(int waitStatus)
+{
+    return WIFSIGNALED(waitStatus) ? 128 + WTERMSIG(waitStatus) : WEXITSTATUS(waitStatus);
+}
+
+/**
+ * @brief prints the timing option's line for a foreground pipeline to stderr:
+ * real 0.105s user 0.001s sys 0.002s maxrss 1780KB csw 2/0
+ *
+ * @param startTime when the pipeline was started, by CLOCK_MONOTONIC
+ * @param usage what its processes used
+ */
+void printTiming(const struct timespec *startTime, const struct rusage *usage)
+{
+    fprintf(stderr, "real %.3fs ", secondsSince(startTime));
+    usage_print(stderr, usage);
+    fprintf(stderr, "\n");
 }
 
 /**
- * @brief frees a linked list of jobs and any memory owned by the job structs.
+ * @brief runs a builtin with its redirections applied to the shell, then
+ * puts the shell's descriptors back. A command of only redirections just
+ * opens and closes its files, so "> file" empties file. The exit status is
+ * left in sh->status.
  *
- * @param jobList a pointer to a jobNode serving as the head of the list.
+ * @param sh the shell
+ * @param cmd the command to run
+ * @return whether the shell should keep going
  */
-void freeList(jobNode *jobList)
+lineResult runInShell(struct shell *sh, command *cmd)
 {
-    jobNode *current = jobList;
-    jobNode *next;
-    while (current != NULL)
+    sh->status = 0;
+    if (redirect_open(cmd) != 0)
     {
-        next = current->next;
-        freeUp((void **)&current->info.command);
-        freeUp((void **)&current);
-        current = next;
+        sh->status = 1;
+        return LINE_DONE;
+    }
+    if (cmd->argv[0] != NULL)
+    {
+        int saved[cmd->redirectCount + 1];
+        if (redirect_apply(cmd, saved) == 0)
+        {
+            SHSTAT_BEGIN(start);
+            do_builtin(sh, cmd->argv);
+            SHSTAT_END(start, SHSTAT_BUILTIN);
+        }
+        else
+        {
+            perror("Error redirecting");
+            sh->status = 1;
+        }
+        redirect_restore(cmd, saved);
     }
+    redirect_close(cmd);
+    return sh->exiting ? LINE_EXIT : LINE_DONE;
 }
 
 /**
- * @brief adds an entry to the end of a jobNode linked list.
+ * @brief runs one pipeline of a line, either a builtin in the shell or
+ * external commands, and leaves its exit status in sh->status. Finished
+ * jobs are left for executeLine to report, and the parsed line for it to
+ * free.
  *
- * @param head a pointer to a pointer to the head of the jobNode linked list.
- * @param newJob a job to add to the end of the linked list.
- * @return true if successful, false if an error occurred.
+ * @param sh the shell
+ * @param line the line the pipeline came from
+ * @param parsed the pipeline to run
+ * @param reader the reader the line came from, or NULL if it was typed in
+ * @param result gets the pipeline's exit status, which is 0 for a
+ * background job, and the time and resources its foreground commands used
+ * @param reportJobs set to true if finished jobs should be reported after
+ * the line, which builtins leave to the next external command
+ * @return whether the shell should keep going
  */
-bool append(jobNode **head, job newJob)
+static lineResult executePipeline(struct shell *sh, const char *line, pipeline *parsed, lineReader *reader,
+                                  lineUsage *result, bool *reportJobs)
 {
-    jobNode *previousNode = NULL;
-    jobNode *currentNode = *head;
+    struct timespec startTime;
+    clock_gettime(CLOCK_MONOTONIC, &startTime);
+    memset(result, 0, sizeof(*result));
+
+    // Builtins, and lines of only redirections, run in the shell itself
+    command *first = &parsed->commands[0];
+    if (parsed->count == 1 && (first->argv[0] == NULL || is_builtin(first->argv[0])))
+    {
+        // The shell itself does the work, so its own usage is what the pipeline used
+        struct rusage start;
+        getrusage(RUSAGE_SELF, &start);
+        lineResult ran = runInShell(sh, first);
+        getrusage(RUSAGE_SELF, &result->usage);
+        usage_since(&result->usage, &start);
+        result->real = secondsSince(&startTime);
+        result->status = sh->status;
+        if (parsed->timed)
+        {
+            usage_print_time(result->real, &result->usage, result->status);
+        }
+        admitQueuedJobs(sh, &jobs);
+        return ran;
+    }
+    *reportJobs = true;
+    sh->status = 0;
+
+    // A job is only this pipeline's part of the line, so a queued one can be parsed again on its own
+    char *jobText = NULL;
+    if (parsed->background)
+    {
+        jobText = strndup(line + parsed->sourceStart, parsed->sourceEnd - parsed->sourceStart);
+        if (jobText == NULL)
+        {
+            perror("Error allocating job");
+            return LINE_FAILED;
+        }
+    }
+
+    // Past the maxjobs limit, or behind jobs already waiting, a background job waits its turn
+    if (parsed->background && options.maxJobs > 0 &&
+        (jobs.firstQueued != NULL || jobs.runningCount >= (size_t)options.maxJobs))
+    {
+        jobEntry *queued = jobs_add(&jobs, 0, jobText);
+        freeUp((void **)&jobText);
+        if (queued == NULL)
+        {
+            perror("Error allocating job");
+            return LINE_FAILED;
+        }
+        if (sh->shell_is_interactive)
+            printJobQueued(queued->info);
+        result->real = secondsSince(&startTime);
+        return LINE_DONE;
+    }
 
-    // Find the last element of the list, store it in previousNode
-    while (currentNode != NULL)
+    // Let the commands read any input the shell has buffered but not run, and
+    // get the shell's own output out before theirs
+    if (reader != NULL)
     {
-        previousNode = currentNode;
-        currentNode = currentNode->next;
+        linereader_unread(reader);
     }
+    fflush(stdout);
 
+    bool isForeground = !parsed->background;
+    pid_t *pids = malloc(sizeof(pid_t) * (2 * parsed->count - 1));
+    if (pids == NULL)
+    {
+        perror("Error starting new process");
+        freeUp((void **)&jobText);
+        return LINE_FAILED;
+    }
+    size_t started;
+    if (start_pipeline(sh, parsed, isForeground, pids, &started) != 0)
+    {
+        isForeground = true; // Don't leave a half started job behind
+    }
 
-    if (previousNode == NULL)
-    {   // The list was empty, make the new node the head
-        *head = createJobNode(newJob);
-        return head != NULL;
+    lineResult ran = LINE_DONE;
+    if (isForeground)
+    {
+        // Wait for the children to complete before continuing execution
+        int status = waitForForeground(sh, pids, started, &result->usage);
+        result->real = secondsSince(&startTime);
+        result->status = started > 0 ? exitStatus(status) : 127;
+        if (parsed->timed)
+        {
+            usage_print_time(result->real, &result->usage, result->status);
+        }
+        else if (options.timing && started > 0)
+        {
+            printTiming(&startTime, &result->usage);
+        }
     }
     else
-    {   // Add the new node after the last node
-        previousNode->next = createJobNode(newJob);
-        return previousNode->next != NULL;
+    {
+        // The pipeline is running in the background, so we make a new job entry
+        // for it. The job is done when its last command is.
+        jobEntry *newJob = jobs_add(&jobs, pids[started - 1], jobText);
+        if (newJob == NULL)
+        {
+            perror("Error allocating job");
+            ran = LINE_FAILED;
+        }
+        else if (sh->shell_is_interactive)
+        {
+            printJob(newJob->info);
+        }
+        result->real = secondsSince(&startTime);
     }
+    sh->status = result->status;
+
+    freeUp((void **)&jobText);
+    freeUp((void **)&pids);
+    return ran;
 }
 
 /**
- * @brief helper/wrapper function that prepares for program exit by freeing
- * memory owned by the parameters.
+ * @brief parses and runs one line of input, a list of pipelines, and
+ * reports any background jobs that finished meanwhile. After each
+ * pipeline, && runs the next one only if its status was 0 and || only if
+ * it was not, and a skipped pipeline leaves the status as it was. The line
+ * is parsed once, and jobs are reported once at its end.
  *
- * @param sh the shell struct to call sh_destroy on.
- * @param jobList the linked list of jobs to free.
+ * @param sh the shell
+ * @param line the line to run
+ * @param reader the reader the line came from, or NULL if it was typed in
+ * @param result if not NULL, gets the line's exit status, which is that of
+ * the last pipeline run, or 2 for a line that does not parse, with the
+ * time the line took and the resources its pipelines used, summed with
+ * usage_add
+ * @return whether the shell should keep going
  */
-void prepareForExit(struct shell *sh, jobNode *jobList)
+lineResult executeLine(struct shell *sh, char *line, lineReader *reader, lineUsage *result)
 {
-    sh_destroy(sh);
-    freeList(jobList);
+    lineUsage unused;
+    if (result == NULL)
+    {
+        result = &unused;
+    }
+    memset(result, 0, sizeof(*result));
+    struct timespec startTime;
+    clock_gettime(CLOCK_MONOTONIC, &startTime);
+    commandList list;
+    SHSTAT_BEGIN(parseStart);
+    int parseResult = cmd_parse_list(line, &list);
+    SHSTAT_END(parseStart, SHSTAT_PARSE);
+    if (parseResult != 0)
+    {
+        result->status = sh->status = 2;
+        cmd_free(NULL);
+        return errno == EINVAL ? LINE_DONE : LINE_FAILED;
+    }
+
+    // A blank line just reports the jobs that finished
+    bool reportJobs = list.count == 0;
+    lineResult ran = LINE_DONE;
+    bool runNext = true;
+    for (size_t idx = 0; idx < list.count && ran == LINE_DONE; idx++)
+    {
+        pipeline *parsed = &list.pipelines[idx];
+        if (runNext)
+        {
+            lineUsage one;
+            ran = executePipeline(sh, line, parsed, reader, &one, &reportJobs);
+            usage_add(&result->usage, &one.usage);
+            result->status = one.status;
+        }
+        runNext = parsed->next == LIST_THEN || (parsed->next == LIST_AND) == (result->status == 0);
+    }
+    result->real = secondsSince(&startTime);
+
+    if (reportJobs)
+    {
+        manageJobs(sh);
+    }
+    cmd_free(NULL);
+    return ran;
 }
 
 /**
- * @brief helper function to free the provided pointers, and save the user's
- * input to the history.
- *
- * @param strArray the array of strings created with cmd_parse that represents
- * the command the user is running.
- * @param line the line returned by readline, which is the raw string the user
- * typed in.
+ * @brief what the prompt is waiting on. While a line is being typed, one
+ * event loop watches the terminal, a pidfd for each running job and the
+ * TMOUT timer, so jobs are finished, and queued ones started, the moment a
+ * running one exits, without polling. A job's pidfd is watched from when
+ * it starts until it is finished, so the prompt coming back costs nothing
+ * per job.
+ */
+typedef struct promptState {
+    struct shell *sh;
+    eventLoop loop;
+    char *line;       // What readline handed over, NULL at end of file
+    bool lineDone;
+    bool timedOut;
+} promptState;
+
+static promptState prompt;
+
+/**
+ * @brief readline's callback for a finished line. It takes the handler
+ * away so readline does not print the prompt again while the line runs.
+ */
+static void onLine(char *line)
+{
+    prompt.line = line;
+    prompt.lineDone = true;
+    rl_callback_handler_remove();
+}
+
+/**
+ * @brief the terminal is readable, so readline takes the next character.
+ */
+static void onInput(int watch, void *context)
+{
+    UNUSED(watch);
+    UNUSED(context);
+    rl_callback_read_char();
+}
+
+/**
+ * @brief TMOUT seconds went by without a line being entered.
+ */
+static void onTimeout(int watch, void *context)
+{
+    UNUSED(watch);
+    UNUSED(context);
+    prompt.timedOut = true;
+}
+
+static void onJobExit(int watch, void *context);
+
+/**
+ * @brief the jobs table's watcher: a job started, so watch its pidfd. A job
+ * whose process was already reaped gets no watch, since its exit is waiting
+ * in the reaper.
  */
-void afterLineProcessed(char **strArray, char *line)
+static int watchJob(pid_t pid, void *context)
 {
-    cmd_free(strArray);
-    add_history(line);
-    freeUp((void **)&line);
+    UNUSED(context);
+    int watch = eventloop_watch_pid(&prompt.loop, pid, onJobExit, NULL);
+    if (watch < 0 && errno != ESRCH)
+    {
+        perror("Error watching jobs");
+    }
+    return watch;
 }
 
 /**
- * @brief Sets the specified process's process group to its own group, and
- * if isForeground is true, grabs control of the console.
+ * @brief the jobs table's watcher: a job finished, so close its pidfd.
+ */
+static void unwatchJob(int watch, void *context)
+{
+    UNUSED(context);
+    eventloop_unwatch(&prompt.loop, watch);
+}
+
+static const jobWatcher promptWatcher = {watchJob, unwatchJob, NULL};
+
+/**
+ * @brief finishes the jobs the reaper saw exit, which starts queued ones.
+ * Finishing a job removes its watch and starting one adds a watch, and a
+ * started job that exits before it could be watched is still read here.
  *
- * @param id the process ID.
- * @param sh the shell struct containing info on the file descriptor associated
- * with the terminal to take control of.
- * @param isForeground whether or not the process with pid id should run in the
- * foreground and take control of the console.
+ * @return true if any job finished
  */
-void setUpChildProcessGroupAndForeground(pid_t id, struct shell *sh, bool isForeground)
+static bool collectFinishedJobs(void)
 {
-    setpgid(id, id);
-    if (isForeground)
-        tcsetpgrp(sh->shell_terminal, id);
+    bool any = false;
+    childExit exited;
+    while (reaper_next(&exited))
+    {
+        any |= finishJob(prompt.sh, &jobs, &exited);
+    }
+    cmd_free(NULL);
+    return any;
 }
 
 /**
- * @brief returns the number of tokens in a command.
+ * @brief a running job exited while the prompt was up. With the notify
+ * option it is reported at once, above the line being typed.
+ */
+static void onJobExit(int watch, void *context)
+{
+    UNUSED(watch);
+    UNUSED(context);
+    if (collectFinishedJobs() && options.notify)
+    {
+        rl_crlf();
+        reportAndManageFinishedJobs(&jobs, true, false);
+        fflush(stdout);
+        rl_on_new_line();
+        rl_redisplay();
+    }
+}
+
+/**
+ * @brief returns the TMOUT variable's seconds, or 0 if it is not a positive
+ * number.
+ */
+static long idleTimeout(void)
+{
+    const char *value = getenv("TMOUT");
+    if (value == NULL)
+    {
+        return 0;
+    }
+    char *end;
+    long seconds = strtol(value, &end, 10);
+    return *value != '\0' && *end == '\0' && seconds > 0 ? seconds : 0;
+}
+
+/**
+ * @brief shows the prompt and runs the event loop until a line is entered,
+ * the input ends or TMOUT runs out.
  *
- * @param command an array of strings representing a command to the shell.
- * @return the length of the command array.
+ * @param sh the shell
+ * @return the line, which the caller must free, or NULL at end of input or
+ * when prompt.timedOut is set
  */
-int getLength(char **command)
+static char *readPromptLine(struct shell *sh)
 {
-    int len = 0;
-    while (command[len] != NULL)
+    prompt.line = NULL;
+    prompt.lineDone = false;
+    prompt.timedOut = false;
+    long timeout = idleTimeout();
+    int timer = timeout > 0 ? eventloop_watch_timer(&prompt.loop, timeout * 1000, onTimeout, NULL) : -1;
+    rl_callback_handler_install(sh->prompt, onLine);
+    collectFinishedJobs();
+    while (!prompt.lineDone && !prompt.timedOut)
+    {
+        if (eventloop_wait(&prompt.loop) < 0)
+        {
+            perror("Error waiting for input");
+            break;
+        }
+    }
+    if (!prompt.lineDone)
     {
-        len++;
+        rl_callback_handler_remove();
     }
-    return len;
+    eventloop_unwatch(&prompt.loop, timer);
+    return prompt.line;
 }
 
 /**
- * @brief checks if the command's last character is an ampersand ('&'),
- * and should be run in the background. If true, this function also deletes
- * the ampersand character from the argument command string array.
+ * @brief reads lines with readline until the user exits, sends EOF or is
+ * idle for TMOUT seconds, saving each one to the history.
  *
- * @param command The array of strings representing the command.
- * @return true if the command should be run in the background, false if not.
+ * @param sh the shell
+ * @return the status of the last pipeline run, or 1 if memory ran out
  */
-bool getIsBackground(char **command)
+int runInteractive(struct shell *sh)
 {
-    // Get the last character of the command
-    int cmd_len = getLength(command);
-    char *lastWord = command[cmd_len - 1];
-    int wordLen = strlen(lastWord);
-    if (wordLen < 1)
+    histfile_init();
+    prompt.sh = sh;
+    if (eventloop_init(&prompt.loop, EVENT_IO_URING) != 0 ||
+        eventloop_watch_fd(&prompt.loop, STDIN_FILENO, onInput, NULL) < 0)
     {
-        return false;
+        perror("Error starting the event loop");
+        return 1;
     }
-    char lastChar = lastWord[wordLen - 1];
+    jobs.watcher = &promptWatcher;
 
-    // If it is '&', remove it from the command string array and return true
-    if (lastChar == '&')
+    while (true)
     {
-        lastWord[wordLen - 1] = '\0';
-        // It's not enough to just remove the '&', now remove dangling whitespace and delete that entry if it's empty.
-        command[cmd_len - 1] = trim_white(lastWord);
-        freeUp((void **)&lastWord);
-        if (strlen(command[cmd_len - 1]) == 0) {
-            freeUp((void**)&command[cmd_len - 1]);
-            command[cmd_len - 1] = NULL;
+        char *line = readPromptLine(sh);
+        if (line == NULL)
+        {
+            if (prompt.timedOut)
+                fprintf(stderr, "\ntimed out waiting for input: auto-logout\n");
+            else
+                fprintf(stdout, "\n");
+            break;
+        }
+        lineResult result = executeLine(sh, line, NULL, NULL);
+        histfile_add(line);
+        freeUp((void **)&line);
+        if (result == LINE_EXIT)
+        {
+            break;
+        }
+        if (result == LINE_FAILED)
+        {
+            reportAndManageFinishedJobs(&jobs, true, false);
+            sh->status = 1;
+            break;
         }
-        return true;
     }
-    return false;
+
+    // The loop closes the pidfds, so the jobs still running keep stale ids
+    jobs.watcher = NULL;
+    eventloop_destroy(&prompt.loop);
+    return sh->status;
 }
 
 /**
- * @brief returns the highest job number of all jobs in the given jobList.
- * Note: this does not care if the jobs in the list are running or done.
- * It returns the max job number of all of them.
+ * @brief waits until the last queued job has started, since every queued
+ * job was promised a run.
+ */
+static void finishQueuedJobs(struct shell *sh)
+{
+    while (jobs.firstQueued != NULL)
+    {
+        childExit exited;
+        reaper_wait_matching(isJob, NULL, &exited);
+        finishJob(sh, &jobs, &exited);
+        cmd_free(NULL);
+    }
+}
+
+/**
+ * @brief runs every line of the -c string, the script file, or stdin when it
+ * is not a terminal. Lines are read in large blocks with no prompt and are
+ * not saved to the history.
  *
- * @param jobList the linked list of jobs to check.
- * @return the highest job number of any job in the list.
+ * @param sh the shell
+ * @return the status of the last pipeline run, or 1 if memory ran out
  */
-int getHighestJobNumber(jobNode *jobList)
+int runScript(struct shell *sh)
 {
-    int highestNumber = 0;
-    jobNode *currentNode = jobList;
-    while (currentNode != NULL)
+    lineReader reader;
+    int opened;
+    if (input.command != NULL)
+        opened = linereader_open_string(&reader, input.command);
+    else if (input.file != NULL)
+        opened = linereader_open_file(&reader, input.file);
+    else
+        opened = linereader_open_fd(&reader, STDIN_FILENO);
+    if (opened != 0)
+    {
+        perror(input.file != NULL ? input.file : "Error reading commands");
+        return 127;
+    }
+
+    char *line;
+    while ((line = linereader_next(&reader)))
     {
-        int currentJobNumber = currentNode->info.jobNum;
-        if (currentJobNumber > highestNumber)
+        lineResult result = executeLine(sh, line, &reader, NULL);
+        if (result == LINE_EXIT)
         {
-            highestNumber = currentJobNumber;
+            break;
+        }
+        if (result == LINE_FAILED)
+        {
+            sh->status = 1;
+            break;
         }
-        currentNode = currentNode->next;
     }
 
-    return highestNumber;
+    linereader_close(&reader);
+    finishQueuedJobs(sh);
+    return sh->status;
 }
 
 /**
- * @brief a helper function for exiting the program early when something goes wrong.
- * 
- * @param cmd the parsed command to free
- * @param line the line read in from the user to free
- * @param sh the shell struct to destroy
+ * @brief runs a line a client of the command server sent, stopping the
+ * server when it runs exit or memory runs out.
  */
-void exitEarly(char** cmd, char* line, struct shell* sh)
+static bool serveLine(char *line, lineUsage *result, void *context)
 {
-    reportAndManageFinishedJobs(&jobList, true, false);
-    afterLineProcessed(cmd, line);
-    prepareForExit(sh, jobList);
-    exit(1);
+    return executeLine(context, line, NULL, result) == LINE_DONE;
+}
+
+/**
+ * @brief serves command lines on the -S socket until a client runs exit.
+ * The commands' output goes to the shell's own stdout and stderr unless a
+ * line redirects it.
+ *
+ * @param sh the shell
+ * @return the shell's exit status
+ */
+int runServer(struct shell *sh)
+{
+    if (server_run(input.socket, serveLine, sh) != 0)
+    {
+        perror(input.socket);
+        return 1;
+    }
+    finishQueuedJobs(sh);
+    // Only exit stops the server cleanly; otherwise memory ran out
+    return sh->exiting ? 0 : 1;
 }
 
 int main(int argc, char **argv)
 {
     // Initial setup
-    jobList = NULL;
     parse_args(argc, argv);
     struct shell sh;
 
@@ -229,133 +717,19 @@ int main(int argc, char **argv)
         sh_destroy(&sh);
         exit(1);
     }
-
-    char *line;
-    using_history();
-
-    // Main execution loop
-    while ((line = readline(sh.prompt)))
+    // Fork the zygote while the shell is as small as it will ever be
+    if (options.launcher == LAUNCH_ZYGOTE && zygote_start(&sh) != 0)
     {
-        // Get input
-        char **formatted = cmd_parse(line);
-        if (formatted == NULL) {
-            exitEarly(formatted, line, &sh);
-        }
-        if (formatted[0] == NULL)
-        {   // They inputted a blank line
-            reportAndManageFinishedJobs(&jobList, true, false);
-            afterLineProcessed(formatted, line);
-            continue;
-        }
-
-        // Attempt to do builtin command
-        bool was_builtin = do_builtin(&sh, formatted);
-        if (was_builtin)
-        {
-            if (sh.exiting)
-            {
-                afterLineProcessed(formatted, line);
-                prepareForExit(&sh, jobList);
-                return 0;
-            }
-        }
-        else
-        {   // Command was not builtin
-            // Check if command should be run in the background
-            bool isForeground = !getIsBackground(formatted);
-
-            if (formatted[0] == NULL)
-            {   // They inputted a blank line
-                reportAndManageFinishedJobs(&jobList, true, false);
-                afterLineProcessed(formatted, line);
-                continue;
-            }
-
-            // Fork and do command
-            pid_t my_id = fork();
-            if (my_id == -1)
-            {
-                // Fork failed
-                perror("Error starting new process");
-                exitEarly(formatted, line, &sh);
-            }
-            else if (my_id == 0)
-            {
-                // Child process
-                if (sh.shell_is_interactive)
-                {
-                    pid_t child = getpid();
-                    setUpChildProcessGroupAndForeground(child, &sh, isForeground);
-                    signal(SIGINT, SIG_DFL);
-                    signal(SIGQUIT, SIG_DFL);
-                    signal(SIGTSTP, SIG_DFL);
-                    signal(SIGTTIN, SIG_DFL);
-                    signal(SIGTTOU, SIG_DFL);
-                }
-                char *cmdName = formatted[0];
-                // Transform yourself into the new process and execute
-                execvp(cmdName, formatted);
-
-                perror("An error occured while executing the command");
-                cmd_free(formatted);
-                freeUp((void **)&line);
-                prepareForExit(&sh, jobList);
-                exit(1);
-            }
-            else
-            {
-                // Parent process
-                if (sh.shell_is_interactive)
-                {
-                    setUpChildProcessGroupAndForeground(my_id, &sh, isForeground);
-
-                    if (isForeground)
-                    {
-                        waitpid(my_id, NULL, 0); // The child is in the foreground, so wait for it to complete before continuing execution
-                        pid_t processGroup = getpgid(getpid());
-                        if (processGroup == (pid_t)-1)
-                        {
-                            perror("Error getting process group of parent process");
-                        }
-                        int result = tcsetpgrp(sh.shell_terminal, processGroup); // Regain control of the terminal
-                        if (result == -1)
-                        {
-                            perror("Error setting terminal foreground process group");
-                        }
-
-                        // Restore the shell's terminal modes in case the child process messed it up.
-                        tcsetattr(sh.shell_terminal, TCSADRAIN, &sh.shell_tmodes);
-                    }
-                    else
-                    {
-                        // Child is running in the background, so we make a new job entry for it
-                        job newJob;
-                        newJob.command = strdup(line);
-                        newJob.jobNum = getHighestJobNumber(jobList) + 1;
-                        newJob.pid = my_id;
-                        bool successful = append(&jobList, newJob);
-                        if (!successful) {
-                            exitEarly(formatted, line, &sh);
-                        }
-                        printJob(newJob);
-                    }
-                    reportAndManageFinishedJobs(&jobList, true, false);
-                }
-                else
-                {
-                    // Parent is not running interactively.
-                    reportAndManageFinishedJobs(&jobList, false, false);
-                    waitpid(my_id, NULL, 0);
-                }
-            }
-        }
-
-        afterLineProcessed(formatted, line);
+        perror("Error starting the zygote");
     }
 
-    fprintf(stdout, "\n");
-    freeUp((void **)&line);
-    prepareForExit(&sh, jobList);
+    using_history();
+    int status;
+    if (input.socket != NULL)
+        status = runServer(&sh);
+    else
+        status = sh.shell_is_interactive ? runInteractive(&sh) : runScript(&sh);
 
-    return 0;
+    prepareForExit(&sh, &jobs);
+    return status;
 }
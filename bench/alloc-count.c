@@ -0,0 +1,44 @@
+#include <stddef.h>
+
+#include "bench.h"
+
+/*
+ * Interpose the allocator so the benchmarks can report allocations per
+ * operation. glibc exports its real allocator as __libc_*, and routes its own
+ * internal calls (strdup, getline, ...) through the interposed symbols, so
+ * every allocation made on behalf of the shell is counted.
+ */
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+
+static size_t allocCount = 0;
+
+size_t bench_alloc_count(void)
+{
+    return allocCount;
+}
+
+void *malloc(size_t size)
+{
+    allocCount++;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size)
+{
+    allocCount++;
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    allocCount++;
+    return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr)
+{
+    __libc_free(ptr);
+}
@@ -0,0 +1,125 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "../src/lab.h"
+#include "../src/launch.h"
+#include "../src/options.h"
+#include "../src/pathcache.h"
+
+#define BUILTIN_CALLS 1000000
+#define UTILITY_CALLS 100000
+#define EXTERNAL_CALLS 2000
+
+/**
+ * @brief returns the nanoseconds is_builtin takes to look up name.
+ */
+static double lookupNs(const char *name)
+{
+    volatile bool found = false;
+    double start = bench_now_ns();
+    for (int idx = 0; idx < BUILTIN_CALLS; idx++)
+    {
+        found = is_builtin(name);
+    }
+    (void)found;
+    return (bench_now_ns() - start) / BUILTIN_CALLS;
+}
+
+/**
+ * @brief returns the nanoseconds do_builtin takes to dispatch and run line,
+ * which must print nothing.
+ */
+static double dispatchNs(struct shell *sh, const char *line, int calls)
+{
+    char **argv = cmd_parse(line);
+    double start = bench_now_ns();
+    for (int idx = 0; idx < calls; idx++)
+    {
+        do_builtin(sh, argv);
+    }
+    double elapsed = bench_now_ns() - start;
+    cmd_free(argv);
+    return elapsed / calls;
+}
+
+/**
+ * @brief returns the nanoseconds one run of line takes with its output going
+ * to /dev/null, either as a builtin or, if external, as the program of the
+ * same name started with the launcher option and waited for.
+ */
+static double utilityNs(struct shell *sh, const char *line, bool external)
+{
+    char **argv = cmd_parse(line);
+    command cmd = {argv, pathcache_lookup(argv[0]), NULL, 0};
+    if (external && cmd.path == NULL)
+    {
+        cmd_free(argv);
+        return 0;
+    }
+    int calls = external ? EXTERNAL_CALLS : UTILITY_CALLS;
+    fflush(stdout);
+    int savedOut = dup(STDOUT_FILENO);
+    int nullFd = open("/dev/null", O_WRONLY);
+    dup2(nullFd, STDOUT_FILENO);
+    close(nullFd);
+
+    double start = bench_now_ns();
+    for (int idx = 0; idx < calls; idx++)
+    {
+        if (!external)
+        {
+            do_builtin(sh, argv);
+            continue;
+        }
+        pid_t pid = launch_command(options.launcher, sh, &cmd, STDIN_FILENO);
+        if (pid != -1)
+        {
+            waitpid(pid, NULL, 0);
+        }
+    }
+    double elapsed = bench_now_ns() - start;
+
+    dup2(savedOut, STDOUT_FILENO);
+    close(savedOut);
+    cmd_free(argv);
+    return elapsed / calls;
+}
+
+void bench_builtin(void)
+{
+    // Two builtins, and a program the dispatcher doesn't know
+    static const char *const names[] = {"jobs", "exit", "ls"};
+    for (size_t idx = 0; idx < sizeof(names) / sizeof(names[0]); idx++)
+    {
+        char caseName[64];
+        snprintf(caseName, sizeof(caseName), "is_builtin=%s", names[idx]);
+        bench_report("builtin", caseName, "ns_per_call", lookupNs(names[idx]));
+    }
+
+    struct shell sh;
+    memset(&sh, 0, sizeof(sh));
+    static const char *const lines[] = {"jobs", "set -o timing=off", "hash true", "cd ."};
+    for (size_t idx = 0; idx < sizeof(lines) / sizeof(lines[0]); idx++)
+    {
+        char caseName[64];
+        snprintf(caseName, sizeof(caseName), "do_builtin=%s", lines[idx]);
+        bench_report("builtin", caseName, "ns_per_call", dispatchNs(&sh, lines[idx], BUILTIN_CALLS / 10));
+    }
+
+    // The utilities the shell runs itself, against the programs they replace
+    static const char *const utilities[] = {"true", "echo hello world", "printf '%s=%d' x 42",
+                                            "test -f /etc/passwd", "[ 3 -lt 5 ]", "pwd"};
+    for (size_t idx = 0; idx < sizeof(utilities) / sizeof(utilities[0]); idx++)
+    {
+        char caseName[64];
+        snprintf(caseName, sizeof(caseName), "builtin:%s", utilities[idx]);
+        bench_report("builtin", caseName, "ns_per_call", utilityNs(&sh, utilities[idx], false));
+        snprintf(caseName, sizeof(caseName), "external:%s", utilities[idx]);
+        bench_report("builtin", caseName, "ns_per_call", utilityNs(&sh, utilities[idx], true));
+    }
+    pathcache_clear();
+}
@@ -0,0 +1,51 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "../src/histindex.h"
+
+static void countFound(uint32_t id, void *ctx)
+{
+    (void)id;
+    (*(size_t *)ctx)++;
+}
+
+void bench_history(void)
+{
+    static const char *const verbs[] = {"make", "git commit -m", "ls -la", "cd", "grep -rn", "ssh", "cat", "vim"};
+    static const char *const patterns[] = {"build-7", "report-12345", "src/module-99/", "ls"};
+    const uint32_t entryCount = 1000000;
+
+    histIndex index;
+    memset(&index, 0, sizeof(index));
+    char line[128];
+    srand(452);
+    double start = bench_now_ns();
+    for (uint32_t idx = 0; idx < entryCount; idx++)
+    {
+        int len = snprintf(line, sizeof(line), "%s src/module-%d/file-%d.c build-%d report-%u",
+                           verbs[rand() % 8], rand() % 1000, rand() % 100000, rand() % 50, idx);
+        histindex_add(&index, line, (size_t)len);
+    }
+    bench_report("history", "entries=1000000", "index_build_ms", (bench_now_ns() - start) / 1e6);
+
+    for (size_t pattern = 0; pattern < sizeof(patterns) / sizeof(patterns[0]); pattern++)
+    {
+        size_t matches = 0;
+        int iterations = 20;
+        start = bench_now_ns();
+        for (int idx = 0; idx < iterations; idx++)
+        {
+            matches = 0;
+            histindex_search(&index, patterns[pattern], countFound, &matches);
+        }
+        double elapsed = (bench_now_ns() - start) / iterations;
+
+        char caseName[96];
+        snprintf(caseName, sizeof(caseName), "entries=1000000,pattern=%s", patterns[pattern]);
+        bench_report("history", caseName, "search_us", elapsed / 1e3);
+        bench_report("history", caseName, "matches", (double)matches);
+    }
+    histindex_destroy(&index);
+}
@@ -0,0 +1,86 @@
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "bench.h"
+#include "../src/jobs.h"
+#include "../src/launch.h"
+#include "../src/pathcache.h"
+#include "../src/reaper.h"
+
+#define IDLE_REPORTS 1000000
+
+/**
+ * @brief returns the nanoseconds reportAndManageFinishedJobs takes when none
+ * of jobCount running jobs has finished, the usual case at every prompt.
+ */
+static double idleReportNs(int jobCount)
+{
+    jobTable table = {NULL, NULL, NULL, 0, NULL, 0, 0, 0, 0, NULL, NULL};
+    for (int idx = 0; idx < jobCount; idx++)
+    {   // Pids far above pid_max, so no real exit can match them
+        jobs_add(&table, 1 << 30 | idx, "sleep 100 &");
+    }
+    double start = bench_now_ns();
+    for (int idx = 0; idx < IDLE_REPORTS; idx++)
+    {
+        reportAndManageFinishedJobs(&table, false, false);
+    }
+    double elapsed = bench_now_ns() - start;
+    jobs_destroy(&table);
+    return elapsed / IDLE_REPORTS;
+}
+
+/**
+ * @brief starts jobCount background true jobs, lets them all exit, then
+ * returns the nanoseconds per job reportAndManageFinishedJobs takes to reap
+ * and remove them.
+ */
+static double reapNsPerJob(struct shell *sh, int jobCount)
+{
+    jobTable table = {NULL, NULL, NULL, 0, NULL, 0, 0, 0, 0, NULL, NULL};
+    char *argv[] = {"true", NULL};
+    const char *path = pathcache_lookup("true");
+    for (int idx = 0; idx < jobCount; idx++)
+    {
+        pid_t pid = launch_process(LAUNCH_SPAWN, sh, path, argv, false);
+        if (pid == -1)
+        {
+            perror("launch_process");
+            break;
+        }
+        jobs_add(&table, pid, "true &");
+    }
+
+    // true exits at once, so this is long enough for all of them
+    struct timespec pause = {0, 200000000};
+    nanosleep(&pause, NULL);
+
+    double start = bench_now_ns();
+    while (table.count > 0)
+    {
+        reportAndManageFinishedJobs(&table, false, false);
+    }
+    double elapsed = bench_now_ns() - start;
+    jobs_destroy(&table);
+    return elapsed / jobCount;
+}
+
+void bench_jobs(void)
+{
+    static const int jobCounts[] = {10, 1000, 10000};
+    struct shell sh;
+    memset(&sh, 0, sizeof(sh));
+    reaper_install();
+
+    for (size_t idx = 0; idx < sizeof(jobCounts) / sizeof(jobCounts[0]); idx++)
+    {
+        char caseName[64];
+        snprintf(caseName, sizeof(caseName), "jobs=%d", jobCounts[idx]);
+        bench_report("jobs", caseName, "idle_report_ns", idleReportNs(jobCounts[idx]));
+        bench_report("jobs", caseName, "reap_ns_per_job", reapNsPerJob(&sh, jobCounts[idx]));
+    }
+    signal(SIGCHLD, SIG_DFL);
+    pathcache_clear();
+}
@@ -0,0 +1,78 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "../src/lexscan.h"
+#include "../src/tokenizer.h"
+
+/**
+ * @brief builds a synthetic command line of len bytes: a command followed by
+ * space separated file paths, like the argument lists our scripts generate.
+ * The caller frees the result.
+ */
+static char *makePathLine(size_t len)
+{
+    static const char *const parts[] = {"/usr/", "lib/", "x86_64-linux-gnu/", "share/", "src/", "build-output/"};
+    char *line = malloc(len + 1);
+    size_t used = 0;
+    size_t part = 0;
+    memcpy(line, "cp ", len < 3 ? len : 3);
+    used = len < 3 ? len : 3;
+    while (used < len)
+    {
+        const char *text = parts[part % 6];
+        size_t textLen = strlen(text);
+        if (part % 4 == 3)
+        {   // End the path with a file name and a separating space
+            text = "libexample-1.2.3.so ";
+            textLen = strlen(text);
+        }
+        if (textLen > len - used)
+        {
+            textLen = len - used;
+        }
+        memcpy(line + used, text, textLen);
+        used += textLen;
+        part++;
+    }
+    line[len] = '\0';
+    return line;
+}
+
+void bench_lex(void)
+{
+    static const size_t sizes[] = {64, 1024, 64 * 1024, 2 * 1024 * 1024};
+    static const lexImpl impls[] = {LEX_SCALAR, LEX_SSE2, LEX_AVX2};
+    tokenizer t = {NULL, 0, 0};
+
+    for (size_t size = 0; size < sizeof(sizes) / sizeof(sizes[0]); size++)
+    {
+        char *line = makePathLine(sizes[size]);
+        size_t iterations = (256 * 1024 * 1024) / sizes[size];
+
+        for (size_t impl = 0; impl < sizeof(impls) / sizeof(impls[0]); impl++)
+        {
+            lexImpl selected = lex_select(impls[impl]);
+            if (selected != impls[impl])
+            {
+                continue; // Not supported on this CPU
+            }
+
+            double start = bench_now_ns();
+            for (size_t idx = 0; idx < iterations; idx++)
+            {
+                tokenize(&t, line, sizes[size]);
+            }
+            double elapsed = bench_now_ns() - start;
+
+            char caseName[64];
+            snprintf(caseName, sizeof(caseName), "impl=%s,len=%zu", lex_impl_name(selected), sizes[size]);
+            bench_report("lex", caseName, "MB_per_s", (double)sizes[size] * iterations / 1e6 / (elapsed / 1e9));
+        }
+        free(line);
+    }
+
+    lex_select(LEX_AUTO);
+    tokenizer_destroy(&t);
+}
@@ -0,0 +1,145 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+
+#include "bench.h"
+#include "../src/lab.h"
+
+/**
+ * @brief builds a command line of tokenCount tokens, each tokenLen bytes long,
+ * separated by single spaces. The caller frees the result.
+ */
+static char *makeLine(int tokenCount, int tokenLen)
+{
+    size_t len = (size_t)tokenCount * (tokenLen + 1);
+    char *line = malloc(len + 1);
+    for (size_t idx = 0; idx < len; idx++)
+    {
+        line[idx] = (idx % (tokenLen + 1) == (size_t)tokenLen) ? ' ' : 'a' + idx % 26;
+    }
+    line[len] = '\0';
+    return line;
+}
+
+/**
+ * @brief builds a pipeline of commandCount commands, like
+ * "grep -n pattern 2>/dev/null | grep -n pattern 2>/dev/null > out". The
+ * caller frees the result.
+ */
+static char *makePipelineLine(int commandCount)
+{
+    static const char stage[] = "grep -n pattern 2>/dev/null";
+    char *line = malloc(commandCount * (sizeof(stage) + 3) + 8);
+    char *end = line;
+    for (int idx = 0; idx < commandCount; idx++)
+    {
+        end += sprintf(end, idx == 0 ? "%s" : " | %s", stage);
+    }
+    strcpy(end, " > out");
+    return line;
+}
+
+/**
+ * @brief reports how long cmd_parse_pipeline, which the shell runs on every
+ * line, takes for pipelines of several lengths.
+ */
+static void benchPipelineParse(void)
+{
+    static const int commandCounts[] = {1, 4, 16};
+    for (size_t shape = 0; shape < sizeof(commandCounts) / sizeof(commandCounts[0]); shape++)
+    {
+        char *line = makePipelineLine(commandCounts[shape]);
+        int iterations = 1000000 / commandCounts[shape];
+        pipeline parsed;
+
+        double start = bench_now_ns();
+        for (int idx = 0; idx < iterations; idx++)
+        {
+            cmd_parse_pipeline(line, &parsed);
+            cmd_free(NULL);
+        }
+        double elapsed = bench_now_ns() - start;
+
+        char caseName[64];
+        snprintf(caseName, sizeof(caseName), "pipeline=%d,len=%zu", commandCounts[shape], strlen(line));
+        bench_report("parse", caseName, "ns_per_line", elapsed / iterations);
+        free(line);
+    }
+}
+
+/**
+ * @brief reports how long cmd_parse_list takes for lines packing several
+ * commands, like "test -f a && echo a; test -f a && echo a", per line and
+ * per command.
+ */
+static void benchListParse(void)
+{
+    static const char item[] = "test -f a && echo a";
+    static const int itemCounts[] = {1, 8, 64};
+    for (size_t shape = 0; shape < sizeof(itemCounts) / sizeof(itemCounts[0]); shape++)
+    {
+        char *line = malloc(itemCounts[shape] * (sizeof(item) + 2) + 1);
+        char *end = line;
+        for (int idx = 0; idx < itemCounts[shape]; idx++)
+        {
+            end += sprintf(end, idx == 0 ? "%s" : "; %s", item);
+        }
+        int iterations = 1000000 / itemCounts[shape];
+        commandList list;
+
+        double start = bench_now_ns();
+        for (int idx = 0; idx < iterations; idx++)
+        {
+            cmd_parse_list(line, &list);
+            cmd_free(NULL);
+        }
+        double elapsed = bench_now_ns() - start;
+
+        char caseName[64];
+        snprintf(caseName, sizeof(caseName), "list=%d,len=%zu", 2 * itemCounts[shape], strlen(line));
+        bench_report("parse", caseName, "ns_per_line", elapsed / iterations);
+        bench_report("parse", caseName, "ns_per_command", elapsed / iterations / (2 * itemCounts[shape]));
+        free(line);
+    }
+}
+
+void bench_parse(void)
+{
+    static const int shapes[][2] = {
+        {2, 4},   // "ls -a" sized lines
+        {8, 8},
+        {64, 16},
+        {1024, 32},
+    };
+
+    for (size_t shape = 0; shape < sizeof(shapes) / sizeof(shapes[0]); shape++)
+    {
+        int tokenCount = shapes[shape][0];
+        int tokenLen = shapes[shape][1];
+        char *line = makeLine(tokenCount, tokenLen);
+        int iterations = 2000000 / tokenCount;
+
+        struct rusage usageBefore, usageAfter;
+        getrusage(RUSAGE_SELF, &usageBefore);
+        size_t allocsBefore = bench_alloc_count();
+        double start = bench_now_ns();
+        for (int idx = 0; idx < iterations; idx++)
+        {
+            char **argv = cmd_parse(line);
+            cmd_free(argv);
+        }
+        double elapsed = bench_now_ns() - start;
+        size_t allocs = bench_alloc_count() - allocsBefore;
+        getrusage(RUSAGE_SELF, &usageAfter);
+
+        char caseName[64];
+        snprintf(caseName, sizeof(caseName), "tokens=%d,len=%zu", tokenCount, strlen(line));
+        bench_report("parse", caseName, "ns_per_line", elapsed / iterations);
+        bench_report("parse", caseName, "allocs_per_line", (double)allocs / iterations);
+        bench_report("parse", caseName, "minor_faults_per_line", (double)(usageAfter.ru_minflt - usageBefore.ru_minflt) / iterations);
+        free(line);
+    }
+    benchPipelineParse();
+    benchListParse();
+}
@@ -0,0 +1,68 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "bench.h"
+#include "../src/launch.h"
+#include "../src/pathcache.h"
+#include "../src/reaper.h"
+
+#define PIPELINE_BYTES "2G"
+#define PIPELINE_GB 2.147483648
+
+/**
+ * @brief runs head -c PIPELINE_BYTES /dev/zero | cat | dd of=/dev/null with
+ * the current pipesize and relay options and returns the throughput in GB/s.
+ */
+static double pipelineThroughput(struct shell *sh)
+{
+    char *producer[] = {"head", "-c", PIPELINE_BYTES, "/dev/zero", NULL};
+    char *filter[] = {"cat", NULL};
+    char *consumer[] = {"dd", "of=/dev/null", "bs=1M", "status=none", NULL};
+    command commands[] = {
+        {producer, pathcache_lookup("head"), NULL, 0},
+        {filter, pathcache_lookup("cat"), NULL, 0},
+        {consumer, pathcache_lookup("dd"), NULL, 0},
+    };
+    pipeline line = {commands, 3, false, false, LIST_THEN, 0, 0};
+
+    pid_t pids[5];
+    size_t started;
+    double start = bench_now_ns();
+    if (launch_pipeline(LAUNCH_SPAWN, sh, &line, true, pids, &started) != 0)
+    {
+        perror("launch_pipeline");
+        return 0;
+    }
+    for (size_t idx = 0; idx < started; idx++)
+    {
+        reaper_wait(pids[idx], NULL);
+    }
+    double elapsed = bench_now_ns() - start;
+    return PIPELINE_GB / (elapsed / 1e9);
+}
+
+void bench_pipeline(void)
+{
+    static const struct {
+        const char *name;
+        const char *options[2];
+    } cases[] = {
+        {"default", {"pipesize=0", "relay=off"}},
+        {"pipesize=1M", {"pipesize=1048576", "relay=off"}},
+        {"relay", {"pipesize=0", "relay=on"}},
+        {"relay,pipesize=1M", {"pipesize=1048576", "relay=on"}},
+    };
+
+    struct shell sh;
+    memset(&sh, 0, sizeof(sh));
+    reaper_install();
+
+    for (size_t idx = 0; idx < sizeof(cases) / sizeof(cases[0]); idx++)
+    {
+        options_set(cases[idx].options[0]);
+        options_set(cases[idx].options[1]);
+        bench_report("pipeline", cases[idx].name, "gb_per_sec", pipelineThroughput(&sh));
+    }
+    options_set("pipesize=0");
+    options_set("relay=off");
+}
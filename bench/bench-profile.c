@@ -0,0 +1,134 @@
+#include <fcntl.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "bench.h"
+
+extern char **environ;
+
+/**
+ * @brief the shells to compare when BENCH_SHELLS is not set, named by the
+ * Makefile profile that builds them.
+ */
+#define BENCH_DEFAULT_SHELLS "debug=./myprogram,release=build/release/myprogram,pgo=build/pgo/myprogram"
+
+#define PROFILE_LINES 20000
+
+/**
+ * @brief lines that run in the shell itself, where the build profile shows.
+ */
+static const char *const builtinLines[] = {
+    "cd /tmp",
+    "set -o maxjobs=0",
+    "hash true",
+    "cd / > /dev/null",
+    "set -o timing=off 2>&1",
+    "hash -r",
+    "jobs",
+    "cd 'a quoted name' \"and another\" a\\ b 2>/dev/null",
+};
+
+/**
+ * @brief the same builtins, with a quarter of the lines starting external
+ * commands and pipelines, whose launch cost does not depend on the profile.
+ */
+static const char *const mixedLines[] = {
+    "cd /tmp",
+    "set -o maxjobs=0",
+    "true > /dev/null",
+    "hash -r",
+    "jobs",
+    "set -o timing=off",
+    "true 'quoted arg' \"another one\" a\\ b | true",
+    "cd /",
+};
+
+#define LINE_COUNT(lines) (sizeof(lines) / sizeof(lines[0]))
+
+/**
+ * @brief writes a script of lineCount lines, cycling through lines, to a
+ * temporary file and returns its path in path.
+ */
+static void makeScript(char *path, const char *const *lines, size_t count, int lineCount)
+{
+    FILE *script = fdopen(mkstemp(path), "w");
+    for (int idx = 0; idx < lineCount; idx++)
+    {
+        fprintf(script, "%s\n", lines[idx % count]);
+    }
+    fclose(script);
+}
+
+/**
+ * @brief runs the shell at shellPath on the script, with its output thrown
+ * away, and returns the commands it ran per second, or 0 if it failed.
+ */
+static double commandsPerSecond(const char *shellPath, const char *script, int lineCount)
+{
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+    posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+
+    char *argv[] = {(char *)shellPath, (char *)script, NULL};
+    double start = bench_now_ns();
+    pid_t pid;
+    int result = posix_spawn(&pid, shellPath, &actions, NULL, argv, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    if (result != 0)
+    {
+        fprintf(stderr, "%s: %s\n", shellPath, strerror(result));
+        return 0;
+    }
+    int status;
+    waitpid(pid, &status, 0);
+    double elapsed = bench_now_ns() - start;
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    {
+        fprintf(stderr, "%s: exited with status %d\n", shellPath, status);
+        return 0;
+    }
+    return lineCount / (elapsed / 1e9);
+}
+
+void bench_profile(void)
+{
+    const char *shells = getenv("BENCH_SHELLS");
+    char *list = strdup(shells != NULL ? shells : BENCH_DEFAULT_SHELLS);
+    char builtinPath[] = "/tmp/bench-profile-XXXXXX";
+    char mixedPath[] = "/tmp/bench-profile-XXXXXX";
+    makeScript(builtinPath, builtinLines, LINE_COUNT(builtinLines), PROFILE_LINES);
+    makeScript(mixedPath, mixedLines, LINE_COUNT(mixedLines), PROFILE_LINES / 4);
+
+    // Each entry is name=path, and shells that have not been built are skipped
+    char *save;
+    for (char *entry = strtok_r(list, ",", &save); entry != NULL; entry = strtok_r(NULL, ",", &save))
+    {
+        char *equals = strchr(entry, '=');
+        if (equals == NULL)
+        {
+            fprintf(stderr, "BENCH_SHELLS: %s: expected name=path\n", entry);
+            continue;
+        }
+        *equals = '\0';
+        const char *shellPath = equals + 1;
+        if (access(shellPath, X_OK) != 0)
+        {
+            fprintf(stderr, "%s: not built, skipping profile %s\n", shellPath, entry);
+            continue;
+        }
+
+        char caseName[64];
+        snprintf(caseName, sizeof(caseName), "profile=%s,lines=builtin", entry);
+        bench_report("profile", caseName, "commands_per_s", commandsPerSecond(shellPath, builtinPath, PROFILE_LINES));
+        snprintf(caseName, sizeof(caseName), "profile=%s,lines=mixed", entry);
+        bench_report("profile", caseName, "commands_per_s", commandsPerSecond(shellPath, mixedPath, PROFILE_LINES / 4));
+    }
+    unlink(builtinPath);
+    unlink(mixedPath);
+    free(list);
+}
@@ -0,0 +1,86 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <readline/readline.h>
+
+#include "bench.h"
+#include "../src/lab.h"
+#include "../src/linereader.h"
+
+/**
+ * @brief writes a script of lineCount typical command lines to a temporary
+ * file and returns its path in path.
+ */
+static void makeScript(char *path, int lineCount)
+{
+    static const char *const commands[] = {"ls -la /tmp", "cd ..", "grep -rn TODO src", "make -j8 all", "echo build finished"};
+    FILE *script = fdopen(mkstemp(path), "w");
+    for (int idx = 0; idx < lineCount; idx++)
+    {
+        fprintf(script, "%s %d\n", commands[idx % 5], idx);
+    }
+    fclose(script);
+}
+
+/**
+ * @brief reads and parses the script the way the shell used to when stdin
+ * was not a terminal, with readline and a prompt.
+ */
+static int readWithReadline(const char *path)
+{
+    FILE *in = fopen(path, "r");
+    FILE *out = fopen("/dev/null", "w");
+    rl_instream = in;
+    rl_outstream = out;
+
+    int lines = 0;
+    char *line;
+    while ((line = readline("shell>")))
+    {
+        cmd_free(cmd_parse(line));
+        free(line);
+        lines++;
+    }
+    rl_instream = NULL;
+    rl_outstream = NULL;
+    fclose(in);
+    fclose(out);
+    return lines;
+}
+
+static int readWithLineReader(const char *path)
+{
+    lineReader reader;
+    linereader_open_file(&reader, path);
+    int lines = 0;
+    char *line;
+    while ((line = linereader_next(&reader)))
+    {
+        cmd_free(cmd_parse(line));
+        lines++;
+    }
+    linereader_close(&reader);
+    return lines;
+}
+
+void bench_script(void)
+{
+    char path[] = "/tmp/bench-script-XXXXXX";
+    makeScript(path, 100000);
+
+    static const struct {
+        const char *name;
+        int (*read)(const char *path);
+    } readers[] = {
+        {"readline", readWithReadline},
+        {"linereader", readWithLineReader},
+    };
+    for (size_t idx = 0; idx < sizeof(readers) / sizeof(readers[0]); idx++)
+    {
+        double start = bench_now_ns();
+        int lines = readers[idx].read(path);
+        double elapsed = bench_now_ns() - start;
+        bench_report("script", readers[idx].name, "lines_per_sec", lines / (elapsed / 1e9));
+    }
+    unlink(path);
+}
@@ -0,0 +1,134 @@
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+
+#include "bench.h"
+#include "../src/launch.h"
+#include "../src/pathcache.h"
+#include "../src/reaper.h"
+#include "../src/zygote.h"
+
+#define LATENCY_LAUNCHES 1000
+
+/**
+ * @brief launches true count times with the given method, waiting for each
+ * one, and returns the number of launches per second.
+ */
+static double spawnsPerSecond(launchMethod method, struct shell *sh, int count)
+{
+    const char *path = pathcache_lookup("true");
+    char *argv[] = {"true", NULL};
+
+    double start = bench_now_ns();
+    for (int idx = 0; idx < count; idx++)
+    {
+        pid_t pid = launch_process(method, sh, path, argv, true);
+        if (pid == -1)
+        {
+            perror("launch_process");
+            return 0;
+        }
+        waitpid(pid, NULL, 0);
+    }
+    double elapsed = bench_now_ns() - start;
+    return count / (elapsed / 1e9);
+}
+
+static int compareDoubles(const void *a, const void *b)
+{
+    double left = *(const double *)a;
+    double right = *(const double *)b;
+    return (left > right) - (left < right);
+}
+
+/**
+ * @brief launches true LATENCY_LAUNCHES times with the given method and sets
+ * the median and 99th percentile microseconds launch_process took to return.
+ * Waiting for each child is not counted.
+ */
+static void launchLatency(launchMethod method, struct shell *sh, double *p50, double *p99)
+{
+    static double samples[LATENCY_LAUNCHES];
+    const char *path = pathcache_lookup("true");
+    char *argv[] = {"true", NULL};
+    for (int idx = 0; idx < LATENCY_LAUNCHES; idx++)
+    {
+        double start = bench_now_ns();
+        pid_t pid = launch_process(method, sh, path, argv, true);
+        samples[idx] = (bench_now_ns() - start) / 1e3;
+        if (pid != -1)
+        {
+            waitpid(pid, NULL, 0);
+        }
+    }
+    qsort(samples, LATENCY_LAUNCHES, sizeof(double), compareDoubles);
+    *p50 = samples[LATENCY_LAUNCHES / 2];
+    *p99 = samples[LATENCY_LAUNCHES * 99 / 100];
+}
+
+/**
+ * @brief runs the line "true" count times the way the shell does, parsing it,
+ * starting it with start_pipeline and waiting for the reaper to see it exit,
+ * and returns the number of lines per second.
+ */
+static double shellLinesPerSecond(struct shell *sh, int count)
+{
+    reaper_install();
+    double start = bench_now_ns();
+    for (int idx = 0; idx < count; idx++)
+    {
+        pipeline parsed;
+        pid_t pid;
+        size_t started;
+        cmd_parse_pipeline("true", &parsed);
+        if (start_pipeline(sh, &parsed, true, &pid, &started) != 0)
+        {
+            cmd_free(NULL);
+            return 0;
+        }
+        reaper_wait(pid, NULL);
+        cmd_free(NULL);
+    }
+    double elapsed = bench_now_ns() - start;
+    signal(SIGCHLD, SIG_DFL);
+    return count / (elapsed / 1e9);
+}
+
+void bench_spawn(void)
+{
+    // Simulate a shell that has grown a large heap (history, job list, ...)
+    static const size_t heapSizes[] = {0, 64 << 20, 512 << 20};
+    static const launchMethod methods[] = {LAUNCH_FORK, LAUNCH_SPAWN, LAUNCH_ZYGOTE};
+    static const char *const methodNames[] = {"fork", "spawn", "zygote"};
+
+    struct shell sh;
+    memset(&sh, 0, sizeof(sh));
+    zygote_start(&sh); // Before the heap grows, as the shell does
+
+    for (size_t size = 0; size < sizeof(heapSizes) / sizeof(heapSizes[0]); size++)
+    {
+        char *ballast = NULL;
+        if (heapSizes[size] > 0)
+        {
+            ballast = malloc(heapSizes[size]);
+            memset(ballast, 1, heapSizes[size]); // Touch it so it is really mapped
+        }
+
+        for (size_t method = 0; method < sizeof(methods) / sizeof(methods[0]); method++)
+        {
+            char caseName[64];
+            snprintf(caseName, sizeof(caseName), "method=%s,heap_mb=%zu", methodNames[method], heapSizes[size] >> 20);
+            bench_report("spawn", caseName, "spawns_per_s", spawnsPerSecond(methods[method], &sh, 500));
+            double p50, p99;
+            launchLatency(methods[method], &sh, &p50, &p99);
+            bench_report("spawn", caseName, "launch_p50_us", p50);
+            bench_report("spawn", caseName, "launch_p99_us", p99);
+        }
+        free(ballast);
+    }
+    bench_report("spawn", "line=true", "lines_per_s", shellLinesPerSecond(&sh, 500));
+    zygote_stop();
+    pathcache_clear();
+}
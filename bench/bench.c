@@ -0,0 +1,52 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "bench.h"
+
+static const benchSuite suites[] = {
+    {"parse", bench_parse},
+    {"lex", bench_lex},
+    {"spawn", bench_spawn},
+    {"history", bench_history},
+    {"script", bench_script},
+    {"pipeline", bench_pipeline},
+    {"profile", bench_profile},
+    {"builtin", bench_builtin},
+    {"jobs", bench_jobs},
+};
+
+double bench_now_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec * 1e9 + (double)now.tv_nsec;
+}
+
+void bench_report(const char *suite, const char *caseName, const char *metric, double value)
+{
+    printf("{\"suite\":\"%s\",\"case\":\"%s\",\"metric\":\"%s\",\"value\":%.3f}\n",
+           suite, caseName, metric, value);
+    fflush(stdout);
+}
+
+/**
+ * @brief runs every suite, or only the suites named on the command line.
+ */
+int main(int argc, char **argv)
+{
+    const int suiteCount = sizeof(suites) / sizeof(suites[0]);
+    for (int idx = 0; idx < suiteCount; idx++)
+    {
+        bool selected = argc < 2;
+        for (int arg = 1; arg < argc && !selected; arg++)
+        {
+            selected = strcmp(argv[arg], suites[idx].name) == 0;
+        }
+        if (selected)
+        {
+            suites[idx].run();
+        }
+    }
+    return 0;
+}
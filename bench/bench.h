@@ -0,0 +1,58 @@
+#ifndef BENCH_H
+#define BENCH_H
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /**
+     * @brief a benchmark suite. Each suite runs its cases and reports every
+     * measurement through bench_report.
+     */
+    typedef struct benchSuite {
+        const char *name;
+        void (*run)(void);
+    } benchSuite;
+
+    /**
+     * @brief returns the current time of the monotonic clock in nanoseconds.
+     */
+    double bench_now_ns(void);
+
+    /**
+     * @brief reports a single measurement as one JSON object on its own line
+     * of stdout, for example:
+     * {"suite":"parse","case":"len=64","metric":"ns_per_line","value":12.5}
+     *
+     * @param suite the suite the measurement belongs to
+     * @param caseName the case within the suite
+     * @param metric what was measured, including its unit
+     * @param value the measured value
+     */
+    void bench_report(const char *suite, const char *caseName, const char *metric, double value);
+
+    /**
+     * @brief returns the number of calls made to malloc, calloc, realloc and
+     * the strdup family since the program started. Only meaningful in the
+     * benchmark binary, which interposes the allocator to count calls.
+     */
+    size_t bench_alloc_count(void);
+
+    void bench_parse(void);
+    void bench_lex(void);
+    void bench_spawn(void);
+    void bench_history(void);
+    void bench_script(void);
+    void bench_pipeline(void);
+    void bench_profile(void);
+    void bench_builtin(void);
+    void bench_jobs(void);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif
@@ -0,0 +1,34 @@
+cd /tmp
+cd /
+hash true
+hash ls
+hash cat
+hash -r
+set -o maxjobs=0
+set -o timing=off
+set -o
+true
+true arg 'single quoted' "double quoted" back\ slash
+ls / > /dev/null
+ls -l /tmp >> /dev/null 2>&1
+cat < /dev/null
+true | true
+ls / | cat | cat > /dev/null
+echo one two three | cat > /dev/null
+true 2>&1 | cat
+true 3>&- 4>/dev/null
+> /dev/null
+false
+time true
+true &
+true | true &
+sleep 0 &
+jobs
+jobs -l
+times
+shstat
+parallel -j 2 true ::: a b c d
+nosuchcommand-for-training
+ls | | cat
+true > /nonexistent/dir/file
+cd /nonexistent/dir
@@ -0,0 +1,106 @@
+#include "arena.h"
+
+#include <stdalign.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_MIN_BLOCK_SIZE 4096
+#define ARENA_ALIGN alignof(max_align_t)
+
+/**
+ * @brief allocates a new, empty block able to hold at least size bytes.
+ *
+ * @param size the minimum number of usable bytes in the block
+ * @return the new block, or NULL if malloc failed
+ */
+static arenaBlock *newBlock(size_t size)
+{
+    if (size < ARENA_MIN_BLOCK_SIZE)
+    {
+        size = ARENA_MIN_BLOCK_SIZE;
+    }
+
+    arenaBlock *block = malloc(sizeof(arenaBlock) + size);
+    if (block == NULL)
+    {
+        return NULL;
+    }
+
+    block->next = NULL;
+    block->size = size;
+    block->used = 0;
+    return block;
+}
+
+void *arena_alloc(arena *a, size_t size)
+{
+    size_t aligned = (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+    arenaBlock *block = a->head;
+
+    if (block == NULL || block->size - block->used < aligned)
+    {   // Out of room, chain a new block at least twice as big as the last one
+        size_t wanted = block == NULL ? aligned : block->size * 2;
+        if (wanted < aligned)
+        {
+            wanted = aligned;
+        }
+        arenaBlock *bigger = newBlock(wanted);
+        if (bigger == NULL)
+        {
+            return NULL;
+        }
+        bigger->next = block;
+        a->head = bigger;
+        a->capacity += bigger->size;
+        block = bigger;
+    }
+
+    void *mem = block->data + block->used;
+    block->used += aligned;
+    return mem;
+}
+
+char *arena_strndup(arena *a, const char *str, size_t len)
+{
+    char *copy = arena_alloc(a, len + 1);
+    if (copy == NULL)
+    {
+        return NULL;
+    }
+    memcpy(copy, str, len);
+    copy[len] = '\0';
+    return copy;
+}
+
+void arena_reset(arena *a)
+{
+    arenaBlock *block = a->head;
+    if (block == NULL)
+    {
+        return;
+    }
+
+    if (block->next != NULL)
+    {   // Coalesce into one block sized for everything the last round needed
+        size_t capacity = a->capacity;
+        arena_destroy(a);
+        a->head = newBlock(capacity);
+        a->capacity = a->head == NULL ? 0 : a->head->size;
+        return;
+    }
+
+    block->used = 0;
+}
+
+void arena_destroy(arena *a)
+{
+    arenaBlock *block = a->head;
+    while (block != NULL)
+    {
+        arenaBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+    a->head = NULL;
+    a->capacity = 0;
+}
@@ -0,0 +1,74 @@
+#ifndef ARENA_H
+#define ARENA_H
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /**
+     * @brief one contiguous block of arena memory. Blocks are chained together
+     * when a single line needs more memory than the current block holds.
+     */
+    typedef struct arenaBlock {
+        struct arenaBlock *next;
+        size_t size;
+        size_t used;
+        char data[];
+    } arenaBlock;
+
+    /**
+     * @brief a bump allocator. Allocations are carved out of large blocks and
+     * are never freed individually; arena_reset releases all of them at once.
+     */
+    typedef struct arena {
+        arenaBlock *head;
+        size_t capacity;
+    } arena;
+
+    /**
+     * @brief allocates size bytes from the arena, aligned for any type. The
+     * memory stays valid until the next call to arena_reset or arena_destroy.
+     * A new block is chained on when the current one is full.
+     *
+     * @param a the arena to allocate from
+     * @param size the number of bytes to allocate
+     * @return the allocated memory, or NULL if the system is out of memory
+     */
+    void *arena_alloc(arena *a, size_t size);
+
+    /**
+     * @brief copies the first len bytes of str into the arena and NUL
+     * terminates the copy.
+     *
+     * @param a the arena to allocate from
+     * @param str the string to copy
+     * @param len the number of bytes of str to copy
+     * @return the copy, or NULL if the system is out of memory
+     */
+    char *arena_strndup(arena *a, const char *str, size_t len);
+
+    /**
+     * @brief releases every allocation made from the arena in O(1). If the
+     * last round of allocations needed more than one block, the blocks are
+     * replaced by a single block big enough to hold all of them, so that a
+     * steady stream of similar lines stops calling malloc altogether.
+     *
+     * @param a the arena to reset
+     */
+    void arena_reset(arena *a);
+
+    /**
+     * @brief frees all memory owned by the arena. The arena may be used
+     * again afterwards.
+     *
+     * @param a the arena to destroy
+     */
+    void arena_destroy(arena *a);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif
@@ -0,0 +1,547 @@
+#define _GNU_SOURCE
+#include "eventloop.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#ifndef LAB_NO_IO_URING
+#include <linux/io_uring.h>
+#endif
+
+#define EVENT_RING_ENTRIES 64   // Submission queue size; more polls are flushed in batches
+#define EVENT_READY_BATCH 64    // Ready watches collected before their callbacks run
+#define EVENT_CANCEL_DATA UINT64_MAX  // user_data of the requests that cancel polls
+
+/**
+ * @brief what a watch was made for, and so what removing it must close.
+ */
+typedef enum watchKind {
+    WATCH_FREE,   // An unused slot
+    WATCH_FD,     // A descriptor the caller owns
+    WATCH_PID,    // A pidfd the loop opened
+    WATCH_TIMER,  // A timerfd the loop made
+} watchKind;
+
+struct eventWatch {
+    watchKind kind;
+    int fd;
+    eventCallback callback;
+    void *context;
+    uint32_t generation;  // Bumped on removal so stale completions are ignored
+    bool armed;           // An io_uring poll for it is in flight
+};
+
+/**
+ * @brief the io_uring submission and completion queues, mapped from the
+ * kernel. The head and tail indices are shared with it, so they are read
+ * and written with acquire and release ordering.
+ */
+struct eventRing {
+    void *sqMap;
+    size_t sqMapSize;
+    void *cqMap;
+    size_t cqMapSize;
+    void *sqeMap;
+    size_t sqeMapSize;
+    unsigned *sqHead;
+    unsigned *sqTail;
+    unsigned sqMask;
+    unsigned *sqArray;
+    unsigned *cqHead;
+    unsigned *cqTail;
+    unsigned cqMask;
+    unsigned pending;  // Requests queued but not yet submitted
+#ifndef LAB_NO_IO_URING
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+#endif
+};
+
+/**
+ * @brief packs a watch's slot and generation into the user_data of its
+ * requests and the data of its epoll events.
+ */
+static uint64_t watchData(const eventLoop *loop, int watch)
+{
+    return ((uint64_t)loop->watches[watch].generation << 32) | (uint32_t)watch;
+}
+
+/**
+ * @brief finds the watch a completion or event is for.
+ *
+ * @return the watch's id, or -1 if it has been removed since
+ */
+static int watchFromData(const eventLoop *loop, uint64_t data)
+{
+    size_t slot = (uint32_t)data;
+    if (slot >= loop->capacity)
+    {
+        return -1;
+    }
+    const eventWatch *watch = &loop->watches[slot];
+    if (watch->kind == WATCH_FREE || watch->generation != (uint32_t)(data >> 32))
+    {
+        return -1;
+    }
+    return (int)slot;
+}
+
+#ifndef LAB_NO_IO_URING
+static int ioUringSetup(unsigned entries, struct io_uring_params *params)
+{
+    return (int)syscall(SYS_io_uring_setup, entries, params);
+}
+
+static int ioUringEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags)
+{
+    return (int)syscall(SYS_io_uring_enter, fd, toSubmit, minComplete, flags, NULL, 0);
+}
+
+static void unmapRing(eventRing *ring)
+{
+    if (ring->sqeMap)
+    {
+        munmap(ring->sqeMap, ring->sqeMapSize);
+    }
+    if (ring->cqMap && ring->cqMap != ring->sqMap)
+    {
+        munmap(ring->cqMap, ring->cqMapSize);
+    }
+    if (ring->sqMap)
+    {
+        munmap(ring->sqMap, ring->sqMapSize);
+    }
+    free(ring);
+}
+
+/**
+ * @brief creates an io_uring and maps its queues.
+ *
+ * @return 0 on success, or -1 with errno set
+ */
+static int startIoUring(eventLoop *loop)
+{
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int fd = ioUringSetup(EVENT_RING_ENTRIES, &params);
+    if (fd < 0)
+    {
+        return -1;
+    }
+    eventRing *ring = calloc(1, sizeof(*ring));
+    if (!ring)
+    {
+        close(fd);
+        return -1;
+    }
+    ring->sqMapSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cqMapSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    bool singleMap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (singleMap && ring->cqMapSize > ring->sqMapSize)
+    {
+        ring->sqMapSize = ring->cqMapSize;
+    }
+    ring->sqMap = mmap(NULL, ring->sqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (ring->sqMap == MAP_FAILED)
+    {
+        ring->sqMap = NULL;
+        goto fail;
+    }
+    ring->cqMap = singleMap ? ring->sqMap
+        : mmap(NULL, ring->cqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    if (ring->cqMap == MAP_FAILED)
+    {
+        ring->cqMap = NULL;
+        goto fail;
+    }
+    ring->sqeMapSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqeMap = mmap(NULL, ring->sqeMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (ring->sqeMap == MAP_FAILED)
+    {
+        ring->sqeMap = NULL;
+        goto fail;
+    }
+    char *sq = ring->sqMap;
+    char *cq = ring->cqMap;
+    ring->sqHead = (unsigned *)(sq + params.sq_off.head);
+    ring->sqTail = (unsigned *)(sq + params.sq_off.tail);
+    ring->sqMask = *(unsigned *)(sq + params.sq_off.ring_mask);
+    ring->sqArray = (unsigned *)(sq + params.sq_off.array);
+    ring->cqHead = (unsigned *)(cq + params.cq_off.head);
+    ring->cqTail = (unsigned *)(cq + params.cq_off.tail);
+    ring->cqMask = *(unsigned *)(cq + params.cq_off.ring_mask);
+    ring->sqes = ring->sqeMap;
+    ring->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+    loop->fd = fd;
+    loop->ring = ring;
+    return 0;
+
+fail:;
+    int error = errno;
+    unmapRing(ring);
+    close(fd);
+    errno = error;
+    return -1;
+}
+
+/**
+ * @brief hands the queued requests to the kernel without waiting.
+ *
+ * @return 0 on success, or -1 with errno set
+ */
+static int flushRequests(eventLoop *loop)
+{
+    eventRing *ring = loop->ring;
+    while (ring->pending > 0)
+    {
+        int submitted = ioUringEnter(loop->fd, ring->pending, 0, 0);
+        if (submitted < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return -1;
+        }
+        ring->pending -= (unsigned)submitted;
+    }
+    return 0;
+}
+
+/**
+ * @brief takes the next free submission queue entry, flushing the queue to
+ * the kernel first if it is full.
+ *
+ * @return the entry, cleared, or NULL with errno set
+ */
+static struct io_uring_sqe *nextRequest(eventLoop *loop)
+{
+    eventRing *ring = loop->ring;
+    unsigned tail = *ring->sqTail;
+    if (tail - __atomic_load_n(ring->sqHead, __ATOMIC_ACQUIRE) > ring->sqMask)
+    {
+        if (flushRequests(loop) != 0)
+        {
+            return NULL;
+        }
+    }
+    unsigned index = tail & ring->sqMask;
+    struct io_uring_sqe *sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    ring->sqArray[index] = index;
+    __atomic_store_n(ring->sqTail, tail + 1, __ATOMIC_RELEASE);
+    ring->pending++;
+    return sqe;
+}
+
+/**
+ * @brief queues a one-shot poll for a watch's descriptor becoming readable.
+ */
+static int armWatch(eventLoop *loop, int watch)
+{
+    struct io_uring_sqe *sqe = nextRequest(loop);
+    if (!sqe)
+    {
+        return -1;
+    }
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = loop->watches[watch].fd;
+    sqe->poll32_events = POLLIN;
+    sqe->user_data = watchData(loop, watch);
+    loop->watches[watch].armed = true;
+    return 0;
+}
+
+/**
+ * @brief queues the cancellation of a watch's poll. Its completion, and
+ * the poll's own, are ignored when they arrive.
+ */
+static void disarmWatch(eventLoop *loop, int watch)
+{
+    struct io_uring_sqe *sqe = nextRequest(loop);
+    if (sqe)
+    {
+        sqe->opcode = IORING_OP_POLL_REMOVE;
+        sqe->fd = -1;
+        sqe->addr = watchData(loop, watch);
+        sqe->user_data = EVENT_CANCEL_DATA;
+    }
+    loop->watches[watch].armed = false;
+}
+
+/**
+ * @brief arms every watch that is not armed, submits, and waits for at
+ * least one completion. Then it collects the watches that are ready.
+ *
+ * @return the number of watches put in ready, or -1 with errno set
+ */
+static int waitIoUring(eventLoop *loop, uint64_t *ready, int capacity)
+{
+    for (size_t slot = 0; slot < loop->capacity; slot++)
+    {
+        if (loop->watches[slot].kind != WATCH_FREE && !loop->watches[slot].armed && armWatch(loop, (int)slot) != 0)
+        {
+            return -1;
+        }
+    }
+    eventRing *ring = loop->ring;
+    if (*ring->cqHead == __atomic_load_n(ring->cqTail, __ATOMIC_ACQUIRE))
+    {
+        int submitted = ioUringEnter(loop->fd, ring->pending, 1, IORING_ENTER_GETEVENTS);
+        if (submitted < 0)
+        {
+            return errno == EINTR ? 0 : -1;
+        }
+        ring->pending -= (unsigned)submitted;
+    }
+    int count = 0;
+    unsigned head = *ring->cqHead;
+    while (count < capacity && head != __atomic_load_n(ring->cqTail, __ATOMIC_ACQUIRE))
+    {
+        const struct io_uring_cqe *cqe = &ring->cqes[head & ring->cqMask];
+        head++;
+        if (cqe->user_data == EVENT_CANCEL_DATA)
+        {
+            continue;
+        }
+        int watch = watchFromData(loop, cqe->user_data);
+        if (watch < 0)
+        {
+            continue;
+        }
+        loop->watches[watch].armed = false;
+        if (cqe->res >= 0)
+        {
+            ready[count++] = cqe->user_data;
+        }
+    }
+    __atomic_store_n(ring->cqHead, head, __ATOMIC_RELEASE);
+    return count;
+}
+#endif
+
+/**
+ * @brief collects the ready watches from epoll.
+ *
+ * @return the number of watches put in ready, or -1 with errno set
+ */
+static int waitEpoll(eventLoop *loop, uint64_t *ready, int capacity)
+{
+    struct epoll_event events[EVENT_READY_BATCH];
+    int count = epoll_wait(loop->fd, events, capacity < EVENT_READY_BATCH ? capacity : EVENT_READY_BATCH, -1);
+    if (count < 0)
+    {
+        return errno == EINTR ? 0 : -1;
+    }
+    for (int i = 0; i < count; i++)
+    {
+        ready[i] = events[i].data.u64;
+    }
+    return count;
+}
+
+int eventloop_init(eventLoop *loop, eventBackend preferred)
+{
+    memset(loop, 0, sizeof(*loop));
+    loop->fd = -1;
+#ifndef LAB_NO_IO_URING
+    if (preferred == EVENT_IO_URING && startIoUring(loop) == 0)
+    {
+        loop->backend = EVENT_IO_URING;
+        return 0;
+    }
+#else
+    (void)preferred;
+#endif
+    loop->backend = EVENT_EPOLL;
+    loop->fd = epoll_create1(EPOLL_CLOEXEC);
+    return loop->fd < 0 ? -1 : 0;
+}
+
+void eventloop_destroy(eventLoop *loop)
+{
+    for (size_t slot = 0; slot < loop->capacity; slot++)
+    {
+        eventloop_unwatch(loop, (int)slot);
+    }
+#ifndef LAB_NO_IO_URING
+    if (loop->ring)
+    {
+        unmapRing(loop->ring);
+    }
+#endif
+    if (loop->fd >= 0)
+    {
+        close(loop->fd);
+    }
+    free(loop->watches);
+    memset(loop, 0, sizeof(*loop));
+    loop->fd = -1;
+}
+
+const char *eventloop_backend_name(const eventLoop *loop)
+{
+    return loop->backend == EVENT_IO_URING ? "io_uring" : "epoll";
+}
+
+/**
+ * @brief takes a free slot for a watch, growing the table if it is full.
+ *
+ * @return the slot, or -1 with errno set
+ */
+static int addWatch(eventLoop *loop, watchKind kind, int fd, eventCallback callback, void *context)
+{
+    size_t slot = 0;
+    while (slot < loop->capacity && loop->watches[slot].kind != WATCH_FREE)
+    {
+        slot++;
+    }
+    if (slot == loop->capacity)
+    {
+        size_t capacity = loop->capacity ? loop->capacity * 2 : 8;
+        eventWatch *watches = realloc(loop->watches, capacity * sizeof(*watches));
+        if (!watches)
+        {
+            return -1;
+        }
+        memset(watches + loop->capacity, 0, (capacity - loop->capacity) * sizeof(*watches));
+        loop->watches = watches;
+        loop->capacity = capacity;
+    }
+    eventWatch *watch = &loop->watches[slot];
+    watch->kind = kind;
+    watch->fd = fd;
+    watch->callback = callback;
+    watch->context = context;
+    watch->armed = false;
+    if (loop->backend == EVENT_EPOLL)
+    {
+        struct epoll_event event = { .events = EPOLLIN, .data.u64 = watchData(loop, (int)slot) };
+        if (epoll_ctl(loop->fd, EPOLL_CTL_ADD, fd, &event) != 0)
+        {
+            watch->kind = WATCH_FREE;
+            return -1;
+        }
+    }
+    return (int)slot;
+}
+
+int eventloop_watch_fd(eventLoop *loop, int fd, eventCallback callback, void *context)
+{
+    return addWatch(loop, WATCH_FD, fd, callback, context);
+}
+
+/**
+ * @brief adds a watch for a descriptor the loop made, closing it if the
+ * watch cannot be added.
+ */
+static int addOwnedWatch(eventLoop *loop, watchKind kind, int fd, eventCallback callback, void *context)
+{
+    if (fd < 0)
+    {
+        return -1;
+    }
+    int watch = addWatch(loop, kind, fd, callback, context);
+    if (watch < 0)
+    {
+        int error = errno;
+        close(fd);
+        errno = error;
+    }
+    return watch;
+}
+
+int eventloop_watch_pid(eventLoop *loop, pid_t pid, eventCallback callback, void *context)
+{
+    // pidfds are always close-on-exec
+    int fd = (int)syscall(SYS_pidfd_open, pid, 0);
+    return addOwnedWatch(loop, WATCH_PID, fd, callback, context);
+}
+
+int eventloop_watch_timer(eventLoop *loop, long milliseconds, eventCallback callback, void *context)
+{
+    int fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    if (fd < 0)
+    {
+        return -1;
+    }
+    struct itimerspec when = {
+        .it_value = {
+            .tv_sec = milliseconds / 1000,
+            .tv_nsec = (milliseconds % 1000) * 1000000,
+        },
+    };
+    // A zero it_value would disarm the timer, so one that is already due fires after 1ns
+    if (milliseconds <= 0)
+    {
+        when.it_value.tv_sec = 0;
+        when.it_value.tv_nsec = 1;
+    }
+    if (timerfd_settime(fd, 0, &when, NULL) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+    return addOwnedWatch(loop, WATCH_TIMER, fd, callback, context);
+}
+
+void eventloop_unwatch(eventLoop *loop, int watch)
+{
+    if (watch < 0 || (size_t)watch >= loop->capacity || loop->watches[watch].kind == WATCH_FREE)
+    {
+        return;
+    }
+    eventWatch *entry = &loop->watches[watch];
+#ifndef LAB_NO_IO_URING
+    if (loop->backend == EVENT_IO_URING && entry->armed)
+    {
+        disarmWatch(loop, watch);
+    }
+#endif
+    if (loop->backend == EVENT_EPOLL)
+    {
+        epoll_ctl(loop->fd, EPOLL_CTL_DEL, entry->fd, NULL);
+    }
+    if (entry->kind != WATCH_FD)
+    {
+        close(entry->fd);
+    }
+    entry->kind = WATCH_FREE;
+    entry->fd = -1;
+    entry->generation++;
+}
+
+int eventloop_wait(eventLoop *loop)
+{
+    uint64_t ready[EVENT_READY_BATCH];
+    int count;
+#ifndef LAB_NO_IO_URING
+    if (loop->backend == EVENT_IO_URING)
+    {
+        count = waitIoUring(loop, ready, EVENT_READY_BATCH);
+    }
+    else
+#endif
+    {
+        count = waitEpoll(loop, ready, EVENT_READY_BATCH);
+    }
+    int ran = 0;
+    for (int i = 0; i < count; i++)
+    {
+        // An earlier callback may have removed this watch, or reused its slot
+        int watch = watchFromData(loop, ready[i]);
+        if (watch >= 0)
+        {
+            loop->watches[watch].callback(watch, loop->watches[watch].context);
+            ran++;
+        }
+    }
+    return count < 0 ? -1 : ran;
+}
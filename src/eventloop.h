@@ -0,0 +1,113 @@
+#ifndef EVENTLOOP_H
+#define EVENTLOOP_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /**
+     * @brief how an event loop waits.
+     */
+    typedef enum eventBackend {
+        EVENT_IO_URING,  // One-shot IORING_OP_POLL_ADD requests, re-armed before each wait
+        EVENT_EPOLL,     // Level-triggered epoll
+    } eventBackend;
+
+    /**
+     * @brief called when a watch is ready. It may add and remove watches,
+     * including its own.
+     *
+     * @param watch the id of the watch that is ready
+     * @param context what was given when the watch was added
+     */
+    typedef void (*eventCallback)(int watch, void *context);
+
+    typedef struct eventWatch eventWatch;
+    typedef struct eventRing eventRing;
+
+    /**
+     * @brief waits for descriptors to become readable, processes to exit and
+     * timers to expire, and runs their callbacks. Processes are watched
+     * through pidfds and timers through timerfds, so everything is a
+     * descriptor and nothing is polled.
+     */
+    typedef struct eventLoop {
+        eventBackend backend;
+        int fd;             // The io_uring or the epoll instance
+        eventRing *ring;    // The mapped io_uring queues, NULL with epoll
+        eventWatch *watches;
+        size_t capacity;
+    } eventLoop;
+
+    /**
+     * @brief sets up an event loop. If preferred is EVENT_IO_URING but
+     * io_uring is not available, or the shell was built with
+     * -DLAB_NO_IO_URING, it uses epoll instead.
+     *
+     * @param loop the loop to set up
+     * @param preferred the backend to use if it is available
+     * @return 0 on success, or -1 with errno set
+     */
+    int eventloop_init(eventLoop *loop, eventBackend preferred);
+
+    /**
+     * @brief removes every watch and frees the loop.
+     */
+    void eventloop_destroy(eventLoop *loop);
+
+    /**
+     * @brief returns the name of the backend the loop uses.
+     */
+    const char *eventloop_backend_name(const eventLoop *loop);
+
+    /**
+     * @brief calls callback whenever fd is readable, until the watch is
+     * removed. The loop does not close fd.
+     *
+     * @return the watch's id, or -1 with errno set
+     */
+    int eventloop_watch_fd(eventLoop *loop, int fd, eventCallback callback, void *context);
+
+    /**
+     * @brief calls callback once the process has exited. The process must be
+     * a child that has not been waited for yet, or it is gone and the watch
+     * cannot be added.
+     *
+     * @return the watch's id, or -1 with errno set, ESRCH if the process has
+     * already been reaped
+     */
+    int eventloop_watch_pid(eventLoop *loop, pid_t pid, eventCallback callback, void *context);
+
+    /**
+     * @brief calls callback once, milliseconds from now.
+     *
+     * @return the watch's id, or -1 with errno set
+     */
+    int eventloop_watch_timer(eventLoop *loop, long milliseconds, eventCallback callback, void *context);
+
+    /**
+     * @brief removes a watch, closing the pidfd or timerfd it made. Removing
+     * an id that was already removed does nothing.
+     */
+    void eventloop_unwatch(eventLoop *loop, int watch);
+
+    /**
+     * @brief blocks until at least one watch is ready or a signal arrives,
+     * then runs the callbacks of the ready watches. A pid or timer watch
+     * stays ready until it is removed.
+     *
+     * @return the number of callbacks run, or -1 with errno set. It is 0
+     * when a signal interrupted the wait, so callers wait in a loop.
+     */
+    int eventloop_wait(eventLoop *loop);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif
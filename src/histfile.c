@@ -0,0 +1,268 @@
+#define _GNU_SOURCE
+#include "histfile.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <readline/history.h>
+
+#include "histindex.h"
+
+histFile historyFile = {-1, 0, 0};
+
+int histfile_open(histFile *hf, const char *path, long fileLimit)
+{
+    hf->fd = open(path, O_RDWR | O_APPEND | O_CREAT | O_CLOEXEC, 0600);
+    if (hf->fd == -1)
+    {
+        return -1;
+    }
+    hf->fileLimit = fileLimit;
+    hf->appendsSinceCheck = 0;
+    return 0;
+}
+
+/**
+ * @brief returns the offset of the first of the last maxLines lines of the
+ * mapped file, scanning backwards so only the tail is touched.
+ */
+static size_t findTailStart(const char *map, size_t size, long maxLines)
+{
+    if (maxLines <= 0)
+    {
+        return size;
+    }
+
+    size_t end = size;
+    if (end > 0 && map[end - 1] == '\n')
+    {
+        end--; // The newline ending the last line doesn't start a new one
+    }
+
+    long lines = 0;
+    while (end > 0)
+    {
+        const char *newline = memrchr(map, '\n', end);
+        if (newline == NULL)
+        {
+            return 0;
+        }
+        if (++lines == maxLines)
+        {
+            return (size_t)(newline - map) + 1;
+        }
+        end = (size_t)(newline - map);
+    }
+    return 0;
+}
+
+/**
+ * @brief maps the whole file. The caller must hold a lock on it.
+ *
+ * @param size set to the size of the file
+ * @return the mapping, or NULL if the file is empty or could not be mapped
+ */
+static char *mapFile(histFile *hf, int prot, size_t *size)
+{
+    struct stat info;
+    if (fstat(hf->fd, &info) == -1 || info.st_size == 0)
+    {
+        *size = 0;
+        return NULL;
+    }
+    *size = (size_t)info.st_size;
+    char *map = mmap(NULL, *size, prot, MAP_SHARED, hf->fd, 0);
+    return map == MAP_FAILED ? NULL : map;
+}
+
+long histfile_load(histFile *hf, long maxEntries, void (*add)(const char *line, size_t len, void *ctx), void *ctx)
+{
+    if (flock(hf->fd, LOCK_SH) == -1)
+    {
+        return -1;
+    }
+
+    size_t size;
+    char *map = mapFile(hf, PROT_READ, &size);
+    long loaded = 0;
+    if (map != NULL && maxEntries > 0)
+    {
+        size_t start = findTailStart(map, size, maxEntries);
+        size_t pageStart = start & ~((size_t)sysconf(_SC_PAGESIZE) - 1);
+        madvise(map + pageStart, size - pageStart, MADV_SEQUENTIAL);
+        while (start < size)
+        {
+            const char *newline = memchr(map + start, '\n', size - start);
+            size_t end = newline == NULL ? size : (size_t)(newline - map);
+            add(map + start, end - start, ctx);
+            loaded++;
+            start = end + 1;
+        }
+    }
+
+    if (map != NULL)
+    {
+        munmap(map, size);
+    }
+    flock(hf->fd, LOCK_UN);
+    return loaded;
+}
+
+/**
+ * @brief trims the file to its last fileLimit lines. The caller must hold an
+ * exclusive lock on it.
+ */
+static int compactLocked(histFile *hf)
+{
+    size_t size;
+    char *map = mapFile(hf, PROT_READ | PROT_WRITE, &size);
+    if (map == NULL)
+    {
+        return 0;
+    }
+
+    // Only compact once the file has a quarter more lines than it should keep
+    long slack = hf->fileLimit / 4 + 1;
+    size_t keepFrom = findTailStart(map, size, hf->fileLimit);
+    int result = 0;
+    if (keepFrom > 0 && findTailStart(map, keepFrom, slack) > 0)
+    {
+        memmove(map, map + keepFrom, size - keepFrom);
+        result = ftruncate(hf->fd, (off_t)(size - keepFrom));
+    }
+    munmap(map, size);
+    return result;
+}
+
+int histfile_compact(histFile *hf)
+{
+    if (flock(hf->fd, LOCK_EX) == -1)
+    {
+        return -1;
+    }
+    int result = compactLocked(hf);
+    flock(hf->fd, LOCK_UN);
+    return result;
+}
+
+int histfile_append(histFile *hf, const char *line)
+{
+    size_t len = strlen(line);
+    char stackBuffer[512];
+    char *buffer = len + 1 <= sizeof(stackBuffer) ? stackBuffer : malloc(len + 1);
+    if (buffer == NULL)
+    {
+        return -1;
+    }
+    memcpy(buffer, line, len);
+    buffer[len] = '\n';
+
+    // One write per line, so a line from another shell can never land inside ours
+    int result = flock(hf->fd, LOCK_EX);
+    if (result == 0)
+    {
+        if (write(hf->fd, buffer, len + 1) != (ssize_t)(len + 1))
+        {
+            result = -1;
+        }
+        if (result == 0 && ++hf->appendsSinceCheck >= HISTFILE_COMPACT_INTERVAL)
+        {
+            hf->appendsSinceCheck = 0;
+            result = compactLocked(hf);
+        }
+        flock(hf->fd, LOCK_UN);
+    }
+
+    if (buffer != stackBuffer)
+    {
+        free(buffer);
+    }
+    return result;
+}
+
+void histfile_close(histFile *hf)
+{
+    if (hf->fd != -1)
+    {
+        close(hf->fd);
+        hf->fd = -1;
+    }
+}
+
+/**
+ * @brief reads a positive number from an environment variable.
+ *
+ * @return the number, or fallback if the variable is unset or not a number
+ */
+static long envLimit(const char *name, long fallback)
+{
+    const char *value = getenv(name);
+    if (value == NULL || *value == '\0')
+    {
+        return fallback;
+    }
+    char *end;
+    long limit = strtol(value, &end, 10);
+    return (*end != '\0' || limit < 0) ? fallback : limit;
+}
+
+/**
+ * @brief adds a line from the history file to readline's history.
+ */
+static void addToReadline(const char *line, size_t len, void *ctx)
+{
+    (void)ctx;
+    char *copy = strndup(line, len);
+    if (copy != NULL)
+    {
+        add_history(copy);
+        free(copy);
+    }
+}
+
+void histfile_init(void)
+{
+    long memoryLimit = envLimit("HISTSIZE", HISTFILE_DEFAULT_MEMORY);
+    stifle_history(memoryLimit > INT_MAX ? INT_MAX : (int)memoryLimit);
+
+    const char *path = getenv("HISTFILE");
+    char *defaultPath = NULL;
+    if (path == NULL)
+    {
+        const char *home = getenv("HOME");
+        if (home == NULL)
+        {
+            return;
+        }
+        defaultPath = malloc(strlen(home) + sizeof(HISTFILE_DEFAULT_NAME) + 1);
+        if (defaultPath == NULL)
+        {
+            return;
+        }
+        sprintf(defaultPath, "%s/%s", home, HISTFILE_DEFAULT_NAME);
+        path = defaultPath;
+    }
+
+    if (*path != '\0' && histfile_open(&historyFile, path, envLimit("HISTFILESIZE", HISTFILE_DEFAULT_SIZE)) == 0)
+    {
+        histfile_load(&historyFile, memoryLimit, addToReadline, NULL);
+    }
+    free(defaultPath);
+}
+
+void histfile_add(const char *line)
+{
+    add_history(line);
+    history_index_line(line);
+    if (historyFile.fd != -1)
+    {
+        histfile_append(&historyFile, line);
+    }
+}
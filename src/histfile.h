@@ -0,0 +1,99 @@
+#ifndef HISTFILE_H
+#define HISTFILE_H
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define HISTFILE_DEFAULT_NAME ".simple_shell_history"
+#define HISTFILE_DEFAULT_SIZE 2000     // Lines kept in the file, HISTFILESIZE
+#define HISTFILE_DEFAULT_MEMORY 1000   // Lines kept in memory, HISTSIZE
+#define HISTFILE_COMPACT_INTERVAL 64   // Appends between checks for compaction
+
+    /**
+     * @brief an append-only history file that any number of shells on the same
+     * host can share. Every line is appended with a single write while holding
+     * an exclusive flock, and compaction happens in place under the same lock,
+     * so no shell ever loses an append.
+     */
+    typedef struct histFile {
+        int fd;
+        long fileLimit;
+        unsigned appendsSinceCheck;
+    } histFile;
+
+    /**
+     * @brief the shell's own history file, opened by histfile_init.
+     */
+    extern histFile historyFile;
+
+    /**
+     * @brief opens (creating if needed) a history file.
+     *
+     * @param hf the history file to open
+     * @param path where the file lives
+     * @param fileLimit the most lines the file keeps after compaction
+     * @return 0 on success, -1 with errno set on error
+     */
+    int histfile_open(histFile *hf, const char *path, long fileLimit);
+
+    /**
+     * @brief memory-maps the file and passes each of its last maxEntries lines
+     * to add, oldest first. Only the tail of the file that holds those lines
+     * is read, and the lines are not NUL terminated.
+     *
+     * @param hf the history file
+     * @param maxEntries the most lines to load
+     * @param add called once for every line
+     * @param ctx passed through to add
+     * @return the number of lines loaded, or -1 with errno set on error
+     */
+    long histfile_load(histFile *hf, long maxEntries, void (*add)(const char *line, size_t len, void *ctx), void *ctx);
+
+    /**
+     * @brief appends one line to the file. Every HISTFILE_COMPACT_INTERVAL
+     * appends, the file is compacted if it has grown well past its limit.
+     *
+     * @param hf the history file
+     * @param line the line to append, without a trailing newline
+     * @return 0 on success, -1 with errno set on error
+     */
+    int histfile_append(histFile *hf, const char *line);
+
+    /**
+     * @brief trims the file down to its last fileLimit lines, in place. Does
+     * nothing unless the file holds at least a quarter more lines than that,
+     * so that the file is not rewritten after every append.
+     *
+     * @param hf the history file
+     * @return 0 on success, -1 with errno set on error
+     */
+    int histfile_compact(histFile *hf);
+
+    /**
+     * @brief closes the history file.
+     */
+    void histfile_close(histFile *hf);
+
+    /**
+     * @brief sets up persistent history for the interactive shell: caps
+     * readline's history at $HISTSIZE entries, opens $HISTFILE (by default
+     * ~/.simple_shell_history) capped at $HISTFILESIZE lines, and loads the
+     * most recent entries into readline.
+     */
+    void histfile_init(void);
+
+    /**
+     * @brief adds a line to readline's history, to the history search index,
+     * and to the history file if one was opened by histfile_init.
+     */
+    void histfile_add(const char *line);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif
@@ -0,0 +1,397 @@
+#define _GNU_SOURCE
+#include "histindex.h"
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <readline/history.h>
+
+#include "histfile.h"
+#include "outbuf.h"
+
+#define HISTINDEX_MIN_TABLE 1024
+#define HISTINDEX_MAX_TRIGRAMS 64 // Trigrams of a pattern used to narrow a search
+
+/**
+ * @brief packs three bytes into a key, offset by one so 0 means empty.
+ */
+static inline uint32_t trigramAt(const char *text)
+{
+    const unsigned char *bytes = (const unsigned char *)text;
+    return ((uint32_t)bytes[0] << 16 | (uint32_t)bytes[1] << 8 | bytes[2]) + 1;
+}
+
+static inline size_t trigramSlot(uint32_t trigram, size_t capacity)
+{
+    return (trigram * 2654435761u) & (capacity - 1);
+}
+
+/**
+ * @brief returns the slot for a trigram, or the empty slot where it belongs.
+ */
+static trigramPostings *findPostings(trigramPostings *table, size_t capacity, uint32_t trigram)
+{
+    size_t idx = trigramSlot(trigram, capacity);
+    while (table[idx].trigram != 0 && table[idx].trigram != trigram)
+    {
+        idx = (idx + 1) & (capacity - 1);
+    }
+    return &table[idx];
+}
+
+/**
+ * @brief doubles the trigram table once it is half full.
+ */
+static bool reserveTrigram(histIndex *index)
+{
+    if ((index->tableUsed + 1) * 2 <= index->tableCapacity)
+    {
+        return true;
+    }
+
+    size_t capacity = index->tableCapacity == 0 ? HISTINDEX_MIN_TABLE : index->tableCapacity * 2;
+    trigramPostings *table = calloc(capacity, sizeof(trigramPostings));
+    if (table == NULL)
+    {
+        return false;
+    }
+    for (size_t idx = 0; idx < index->tableCapacity; idx++)
+    {
+        if (index->table[idx].trigram != 0)
+        {
+            *findPostings(table, capacity, index->table[idx].trigram) = index->table[idx];
+        }
+    }
+    free(index->table);
+    index->table = table;
+    index->tableCapacity = capacity;
+    return true;
+}
+
+/**
+ * @brief records that entry id contains trigram.
+ */
+static bool addPosting(histIndex *index, uint32_t trigram, uint32_t id)
+{
+    if (!reserveTrigram(index))
+    {
+        return false;
+    }
+
+    trigramPostings *postings = findPostings(index->table, index->tableCapacity, trigram);
+    if (postings->trigram == 0)
+    {
+        postings->trigram = trigram;
+        index->tableUsed++;
+    }
+    else if (postings->entries[postings->count - 1] == id)
+    {   // The entry has this trigram more than once
+        return true;
+    }
+
+    if (postings->count == postings->capacity)
+    {
+        uint32_t capacity = postings->capacity == 0 ? 4 : postings->capacity * 2;
+        uint32_t *entries = realloc(postings->entries, capacity * sizeof(uint32_t));
+        if (entries == NULL)
+        {
+            return false;
+        }
+        postings->entries = entries;
+        postings->capacity = capacity;
+    }
+    postings->entries[postings->count++] = id;
+    return true;
+}
+
+int histindex_add(histIndex *index, const char *line, size_t len)
+{
+    if (index->count == UINT32_MAX)
+    {
+        return -1;
+    }
+    if (index->textUsed + len + 1 > index->textCapacity)
+    {
+        size_t capacity = index->textCapacity == 0 ? 65536 : index->textCapacity;
+        while (index->textUsed + len + 1 > capacity)
+        {
+            capacity *= 2;
+        }
+        char *text = realloc(index->text, capacity);
+        if (text == NULL)
+        {
+            return -1;
+        }
+        index->text = text;
+        index->textCapacity = capacity;
+    }
+    if (index->count == index->offsetsCapacity)
+    {
+        uint32_t capacity = index->offsetsCapacity == 0 ? 1024 : index->offsetsCapacity * 2;
+        size_t *offsets = realloc(index->offsets, capacity * sizeof(size_t));
+        if (offsets == NULL)
+        {
+            return -1;
+        }
+        index->offsets = offsets;
+        index->offsetsCapacity = capacity;
+    }
+
+    uint32_t id = index->count;
+    char *entry = index->text + index->textUsed;
+    memcpy(entry, line, len);
+    entry[len] = '\0';
+    index->offsets[id] = index->textUsed;
+    index->textUsed += len + 1;
+    index->count++;
+
+    for (size_t idx = 0; idx + 3 <= len; idx++)
+    {
+        if (!addPosting(index, trigramAt(entry + idx), id))
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+const char *histindex_entry(const histIndex *index, uint32_t id, size_t *len)
+{
+    size_t end = id + 1 < index->count ? index->offsets[id + 1] : index->textUsed;
+    *len = end - index->offsets[id] - 1;
+    return index->text + index->offsets[id];
+}
+
+/**
+ * @brief returns true if entries[from..count) contains id, advancing *from
+ * past every entry smaller than id. Gallops, then binary searches, so a short
+ * candidate list intersects a long posting list quickly.
+ */
+static bool containsFrom(const trigramPostings *postings, uint32_t *from, uint32_t id)
+{
+    uint32_t low = *from;
+    uint32_t step = 1;
+    uint32_t high = low;
+    while (high < postings->count && postings->entries[high] < id)
+    {
+        low = high + 1;
+        high += step;
+        step *= 2;
+    }
+    if (high > postings->count)
+    {
+        high = postings->count;
+    }
+    while (low < high)
+    {
+        uint32_t mid = low + (high - low) / 2;
+        if (postings->entries[mid] < id)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    *from = low;
+    return low < postings->count && postings->entries[low] == id;
+}
+
+/**
+ * @brief checks the pattern against the entry itself, since having all of the
+ * pattern's trigrams doesn't mean having them in the right order.
+ */
+static bool entryMatches(const histIndex *index, uint32_t id, const char *pattern, size_t patternLen)
+{
+    size_t len;
+    const char *entry = histindex_entry(index, id, &len);
+    return memmem(entry, len, pattern, patternLen) != NULL;
+}
+
+/**
+ * @brief orders posting lists from shortest to longest, for qsort.
+ */
+static int comparePostingsLength(const void *left, const void *right)
+{
+    uint32_t leftCount = (*(const trigramPostings *const *)left)->count;
+    uint32_t rightCount = (*(const trigramPostings *const *)right)->count;
+    return (leftCount > rightCount) - (leftCount < rightCount);
+}
+
+size_t histindex_search(const histIndex *index, const char *pattern, void (*found)(uint32_t id, void *ctx), void *ctx)
+{
+    size_t patternLen = strlen(pattern);
+    size_t matches = 0;
+
+    if (patternLen < 3 || index->count == 0)
+    {   // No trigrams to narrow it down, check every entry
+        for (uint32_t id = 0; id < index->count; id++)
+        {
+            if (entryMatches(index, id, pattern, patternLen))
+            {
+                found(id, ctx);
+                matches++;
+            }
+        }
+        return matches;
+    }
+
+    // No entry is long enough to have a trigram, so none can hold the pattern
+    if (index->tableCapacity == 0)
+    {
+        return 0;
+    }
+
+    // Gather the pattern's posting lists, stopping early if a trigram never occurs
+    const trigramPostings *lists[HISTINDEX_MAX_TRIGRAMS];
+    size_t listCount = 0;
+    for (size_t idx = 0; idx + 3 <= patternLen && listCount < HISTINDEX_MAX_TRIGRAMS; idx++)
+    {
+        const trigramPostings *postings = findPostings(index->table, index->tableCapacity, trigramAt(pattern + idx));
+        if (postings->trigram == 0)
+        {
+            return 0;
+        }
+        lists[listCount++] = postings;
+    }
+
+    // Walk the shortest list, checking the other lists shortest first since
+    // they are the most likely to rule an entry out
+    qsort(lists, listCount, sizeof(lists[0]), comparePostingsLength);
+    uint32_t cursors[HISTINDEX_MAX_TRIGRAMS] = {0};
+    for (uint32_t pos = 0; pos < lists[0]->count; pos++)
+    {
+        uint32_t id = lists[0]->entries[pos];
+        bool inAll = true;
+        for (size_t idx = 1; idx < listCount && inAll; idx++)
+        {
+            inAll = containsFrom(lists[idx], &cursors[idx], id);
+        }
+        if (inAll && entryMatches(index, id, pattern, patternLen))
+        {
+            found(id, ctx);
+            matches++;
+        }
+    }
+    return matches;
+}
+
+void histindex_destroy(histIndex *index)
+{
+    for (size_t idx = 0; idx < index->tableCapacity; idx++)
+    {
+        free(index->table[idx].entries);
+    }
+    free(index->table);
+    free(index->text);
+    free(index->offsets);
+    memset(index, 0, sizeof(*index));
+}
+
+/**
+ * @brief the index of the shell's history, built on the first search.
+ */
+static histIndex shellIndex;
+static bool shellIndexBuilt = false;
+
+static void indexFileLine(const char *line, size_t len, void *ctx)
+{
+    histindex_add((histIndex *)ctx, line, len);
+}
+
+/**
+ * @brief builds the shell's index from the whole history file, or from the
+ * in-memory history when there is no history file.
+ */
+static void buildShellIndex(void)
+{
+    shellIndexBuilt = true;
+    if (historyFile.fd != -1)
+    {
+        histfile_load(&historyFile, LONG_MAX, indexFileLine, &shellIndex);
+        return;
+    }
+
+    HIST_ENTRY **allHistory = history_list();
+    for (int idx = 0; allHistory != NULL && allHistory[idx] != NULL; idx++)
+    {
+        histindex_add(&shellIndex, allHistory[idx]->line, strlen(allHistory[idx]->line));
+    }
+}
+
+void history_index_line(const char *line)
+{
+    if (shellIndexBuilt)
+    {
+        histindex_add(&shellIndex, line, strlen(line));
+    }
+}
+
+void history_index_destroy(void)
+{
+    histindex_destroy(&shellIndex);
+    shellIndexBuilt = false;
+}
+
+/**
+ * @brief prints one history entry in the history builtin's format.
+ */
+static void printEntry(outBuffer *out, const char *line, size_t len)
+{
+    outbuf_write(out, "\t- ", 3);
+    outbuf_write(out, line, len);
+    outbuf_write(out, "\n", 1);
+}
+
+static void printFound(uint32_t id, void *ctx)
+{
+    size_t len;
+    const char *line = histindex_entry(&shellIndex, id, &len);
+    printEntry((outBuffer *)ctx, line, len);
+}
+
+int history_builtin(char **argv)
+{
+    static outBuffer out;
+    outbuf_init(&out, STDOUT_FILENO);
+
+    if (argv[1] != NULL && strcmp(argv[1], "-s") == 0)
+    {
+        if (argv[2] == NULL)
+        {
+            fprintf(stderr, "history: usage: history [N | -s pattern]\n");
+            return 1;
+        }
+        if (!shellIndexBuilt)
+        {
+            buildShellIndex();
+        }
+        histindex_search(&shellIndex, argv[2], printFound, &out);
+        outbuf_flush(&out);
+        return 0;
+    }
+
+    long last = LONG_MAX;
+    if (argv[1] != NULL)
+    {
+        char *end;
+        last = strtol(argv[1], &end, 10);
+        if (*end != '\0' || last < 0)
+        {
+            fprintf(stderr, "history: %s: numeric argument required\n", argv[1]);
+            return 1;
+        }
+    }
+
+    HIST_ENTRY **allHistory = history_list();
+    if (allHistory)
+    {
+        long count = history_length;
+        long idx = count > last ? count - last : 0;
+        for (; allHistory[idx] != NULL; idx++)
+        {
+            printEntry(&out, allHistory[idx]->line, strlen(allHistory[idx]->line));
+        }
+    }
+    outbuf_flush(&out);
+    return 0;
+}
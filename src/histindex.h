@@ -0,0 +1,98 @@
+#ifndef HISTINDEX_H
+#define HISTINDEX_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /**
+     * @brief the list of entries containing one trigram, in ascending order.
+     */
+    typedef struct trigramPostings {
+        uint32_t trigram; // The three bytes, plus one so that 0 marks an empty slot
+        uint32_t count;
+        uint32_t capacity;
+        uint32_t *entries;
+    } trigramPostings;
+
+    /**
+     * @brief a substring search index over history entries. Every entry is
+     * split into overlapping three byte trigrams, and each trigram maps to the
+     * entries that contain it. A search only has to check the entries that
+     * contain every trigram of the pattern.
+     */
+    typedef struct histIndex {
+        char *text;          // Every entry, each followed by a NUL
+        size_t textUsed;
+        size_t textCapacity;
+        size_t *offsets;     // Where each entry starts in text
+        uint32_t count;
+        uint32_t offsetsCapacity;
+        trigramPostings *table; // Open addressing hash table keyed by trigram
+        size_t tableCapacity;
+        size_t tableUsed;
+    } histIndex;
+
+    /**
+     * @brief adds an entry to the end of the index.
+     *
+     * @param index the index
+     * @param line the entry, need not be NUL terminated
+     * @param len the length of the entry
+     * @return 0 on success, -1 if out of memory
+     */
+    int histindex_add(histIndex *index, const char *line, size_t len);
+
+    /**
+     * @brief returns entry number id of the index.
+     */
+    const char *histindex_entry(const histIndex *index, uint32_t id, size_t *len);
+
+    /**
+     * @brief finds every entry containing pattern and passes its number to
+     * found, oldest first. Patterns shorter than three bytes have no trigrams,
+     * so they are matched against every entry.
+     *
+     * @param index the index
+     * @param pattern the substring to look for
+     * @param found called with the number of every matching entry
+     * @param ctx passed through to found
+     * @return the number of matching entries
+     */
+    size_t histindex_search(const histIndex *index, const char *pattern, void (*found)(uint32_t id, void *ctx), void *ctx);
+
+    /**
+     * @brief frees everything owned by the index.
+     */
+    void histindex_destroy(histIndex *index);
+
+    /**
+     * @brief the history builtin. With no arguments every entry is printed,
+     * "history N" prints the last N entries and "history -s pattern" prints
+     * the persisted entries containing pattern, using a trigram index built
+     * the first time it is needed.
+     *
+     * @param argv the command, starting with "history"
+     * @return 0 on success, 1 on a usage error
+     */
+    int history_builtin(char **argv);
+
+    /**
+     * @brief adds a new history line to the search index, if it was built.
+     */
+    void history_index_line(const char *line);
+
+    /**
+     * @brief frees the shell's history search index.
+     */
+    void history_index_destroy(void);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif
@@ -0,0 +1,291 @@
+#include "jobs.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define JOBS_MIN_CAPACITY 16
+
+/**
+ * @brief spreads pids over the hash table, since they are often sequential.
+ */
+static size_t hashPid(pid_t pid, size_t capacity)
+{
+    return ((uint32_t)pid * 2654435761u) & (capacity - 1);
+}
+
+/**
+ * @brief puts an entry into a pid hash table that has room for it.
+ */
+static void insertByPid(jobEntry **byPid, size_t capacity, jobEntry *entry)
+{
+    size_t idx = hashPid(entry->info.pid, capacity);
+    while (byPid[idx] != NULL)
+    {
+        idx = (idx + 1) & (capacity - 1);
+    }
+    byPid[idx] = entry;
+}
+
+/**
+ * @brief makes sure both indexes have room for one more job with the given
+ * job number. The pid table is kept at most half full.
+ *
+ * @return true if successful, false if out of memory.
+ */
+static bool reserveJob(jobTable *table, int jobNum)
+{
+    if ((size_t)jobNum >= table->byNumCapacity)
+    {
+        size_t capacity = table->byNumCapacity == 0 ? JOBS_MIN_CAPACITY : table->byNumCapacity;
+        while (capacity <= (size_t)jobNum)
+        {
+            capacity *= 2;
+        }
+        jobEntry **byNum = realloc(table->byNum, capacity * sizeof(jobEntry *));
+        if (byNum == NULL)
+        {
+            return false;
+        }
+        memset(byNum + table->byNumCapacity, 0, (capacity - table->byNumCapacity) * sizeof(jobEntry *));
+        table->byNum = byNum;
+        table->byNumCapacity = capacity;
+    }
+
+    if ((table->count + 1) * 2 > table->byPidCapacity)
+    {
+        size_t capacity = table->byPidCapacity == 0 ? JOBS_MIN_CAPACITY : table->byPidCapacity * 2;
+        jobEntry **byPid = calloc(capacity, sizeof(jobEntry *));
+        if (byPid == NULL)
+        {
+            return false;
+        }
+        for (jobEntry *entry = table->head; entry != NULL; entry = entry->next)
+        {   // Only running jobs are indexed, and only they are taken out again
+            if (entry->info.state == JOB_RUNNING && entry->info.pid != 0)
+            {
+                insertByPid(byPid, capacity, entry);
+            }
+        }
+        free(table->byPid);
+        table->byPid = byPid;
+        table->byPidCapacity = capacity;
+    }
+    return true;
+}
+
+/**
+ * @brief tells the table's watcher that entry's process is running.
+ */
+static void startWatching(const jobTable *table, jobEntry *entry)
+{
+    if (table->watcher != NULL)
+    {
+        entry->watch = table->watcher->watch(entry->info.pid, table->watcher->context);
+    }
+}
+
+/**
+ * @brief tells the table's watcher that entry's process is no longer
+ * running.
+ */
+static void stopWatching(const jobTable *table, jobEntry *entry)
+{
+    if (table->watcher != NULL && entry->watch >= 0)
+    {
+        table->watcher->unwatch(entry->watch, table->watcher->context);
+    }
+    entry->watch = -1;
+}
+
+jobEntry *jobs_add(jobTable *table, pid_t pid, const char *command)
+{
+    // Jobs are only ever added at the end, so the tail has the highest number
+    int jobNum = table->tail == NULL ? 1 : table->tail->info.jobNum + 1;
+    if (!reserveJob(table, jobNum))
+    {
+        return NULL;
+    }
+
+    jobEntry *entry = malloc(sizeof(jobEntry));
+    if (entry == NULL)
+    {
+        return NULL;
+    }
+    entry->info.command = strdup(command);
+    if (entry->info.command == NULL)
+    {
+        free(entry);
+        return NULL;
+    }
+    entry->info.jobNum = jobNum;
+    entry->info.pid = pid;
+    entry->info.state = pid == 0 ? JOB_QUEUED : JOB_RUNNING;
+    entry->info.status = 0;
+    memset(&entry->info.usage, 0, sizeof(entry->info.usage));
+    entry->watch = -1;
+
+    entry->next = NULL;
+    entry->prev = table->tail;
+    if (table->tail == NULL)
+        table->head = entry;
+    else
+        table->tail->next = entry;
+    table->tail = entry;
+
+    table->byNum[jobNum] = entry;
+    if (pid == 0)
+    {
+        if (table->firstQueued == NULL)
+            table->firstQueued = entry;
+    }
+    else
+    {
+        insertByPid(table->byPid, table->byPidCapacity, entry);
+        table->runningCount++;
+        startWatching(table, entry);
+    }
+    table->count++;
+    return entry;
+}
+
+/**
+ * @brief returns the first queued job after entry, in the order they were
+ * added. Only jobs that were started right away can lie in between.
+ */
+static jobEntry *nextQueued(jobEntry *entry)
+{
+    for (entry = entry->next; entry != NULL; entry = entry->next)
+    {
+        if (entry->info.state == JOB_QUEUED)
+        {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+void jobs_start(jobTable *table, jobEntry *entry, pid_t pid)
+{
+    table->firstQueued = nextQueued(entry);
+    entry->info.pid = pid;
+    entry->info.state = JOB_RUNNING;
+    insertByPid(table->byPid, table->byPidCapacity, entry);
+    table->runningCount++;
+    startWatching(table, entry);
+}
+
+jobEntry *jobs_find_num(const jobTable *table, int jobNum)
+{
+    if (jobNum < 0 || (size_t)jobNum >= table->byNumCapacity)
+    {
+        return NULL;
+    }
+    return table->byNum[jobNum];
+}
+
+jobEntry *jobs_find_pid(const jobTable *table, pid_t pid)
+{
+    if (table->count == 0)
+    {
+        return NULL;
+    }
+
+    size_t idx = hashPid(pid, table->byPidCapacity);
+    while (table->byPid[idx] != NULL)
+    {
+        if (table->byPid[idx]->info.pid == pid)
+        {
+            return table->byPid[idx];
+        }
+        idx = (idx + 1) & (table->byPidCapacity - 1);
+    }
+    return NULL;
+}
+
+/**
+ * @brief takes an entry out of the pid hash table, shifting back any entries
+ * after it in the same probe run so lookups never need tombstones.
+ */
+static void removeByPid(jobTable *table, jobEntry *entry)
+{
+    size_t mask = table->byPidCapacity - 1;
+    size_t hole = hashPid(entry->info.pid, table->byPidCapacity);
+    while (table->byPid[hole] != entry)
+    {
+        hole = (hole + 1) & mask;
+    }
+
+    size_t idx = hole;
+    while (true)
+    {
+        idx = (idx + 1) & mask;
+        jobEntry *candidate = table->byPid[idx];
+        if (candidate == NULL)
+        {
+            break;
+        }
+        // Move it into the hole if the hole lies between its home slot and where it is now
+        size_t home = hashPid(candidate->info.pid, table->byPidCapacity);
+        if (((idx - home) & mask) >= ((idx - hole) & mask))
+        {
+            table->byPid[hole] = candidate;
+            hole = idx;
+        }
+    }
+    table->byPid[hole] = NULL;
+}
+
+void jobs_finish(jobTable *table, jobEntry *entry)
+{
+    if (entry->info.state == JOB_RUNNING)
+    {
+        removeByPid(table, entry);
+        table->runningCount--;
+        stopWatching(table, entry);
+    }
+    else if (entry->info.state == JOB_QUEUED && table->firstQueued == entry)
+    {
+        table->firstQueued = nextQueued(entry);
+    }
+    entry->info.state = JOB_DONE;
+    table->doneCount++;
+}
+
+void jobs_remove(jobTable *table, jobEntry *entry)
+{
+    if (entry->info.state != JOB_DONE)
+    {
+        jobs_finish(table, entry);
+    }
+    table->doneCount--;
+    table->byNum[entry->info.jobNum] = NULL;
+
+    if (entry->prev == NULL)
+        table->head = entry->next;
+    else
+        entry->prev->next = entry->next;
+    if (entry->next == NULL)
+        table->tail = entry->prev;
+    else
+        entry->next->prev = entry->prev;
+
+    table->count--;
+    freeUp((void **)&entry->info.command);
+    freeUp((void **)&entry);
+}
+
+void jobs_destroy(jobTable *table)
+{
+    jobEntry *entry = table->head;
+    while (entry != NULL)
+    {
+        jobEntry *next = entry->next;
+        freeUp((void **)&entry->info.command);
+        freeUp((void **)&entry);
+        entry = next;
+    }
+    free(table->byNum);
+    free(table->byPid);
+    memset(table, 0, sizeof(*table));
+}
@@ -0,0 +1,78 @@
+#ifndef JOBS_H
+#define JOBS_H
+#include <stdbool.h>
+#include <sys/types.h>
+
+#include "lab.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /**
+     * @brief adds a job to the end of the table. Its job number is one more
+     * than the highest job number in the table, or 1 if the table is empty.
+     * A job added with a pid is running, and the table's watcher is told.
+     *
+     * @param table the table to add to
+     * @param pid the process ID of the job, or 0 to queue it
+     * @param command the command line of the job, which is copied
+     * @return the new entry, or NULL if out of memory
+     */
+    jobEntry *jobs_add(jobTable *table, pid_t pid, const char *command);
+
+    /**
+     * @brief marks the oldest queued job as running, and tells the table's
+     * watcher. The next queued job becomes the oldest.
+     *
+     * @param table the table holding the job
+     * @param entry the job, which must be table->firstQueued
+     * @param pid the process ID it was started as
+     */
+    void jobs_start(jobTable *table, jobEntry *entry, pid_t pid);
+
+    /**
+     * @brief marks a running or queued job as done. It stays in the table,
+     * but can no longer be found by pid, since the pid may be reused. The
+     * watcher stops watching a job that was running.
+     *
+     * @param table the table holding the job
+     * @param entry the job that finished
+     */
+    void jobs_finish(jobTable *table, jobEntry *entry);
+
+    /**
+     * @brief finds a job by its job number.
+     *
+     * @return the entry, or NULL if there is no such job
+     */
+    jobEntry *jobs_find_num(const jobTable *table, int jobNum);
+
+    /**
+     * @brief finds a running job by its process ID.
+     *
+     * @return the entry, or NULL if there is no such job
+     */
+    jobEntry *jobs_find_pid(const jobTable *table, pid_t pid);
+
+    /**
+     * @brief removes a job from the table and frees it.
+     *
+     * @param table the table holding the job
+     * @param entry the job to remove
+     */
+    void jobs_remove(jobTable *table, jobEntry *entry);
+
+    /**
+     * @brief frees every job in the table and the table's indexes.
+     *
+     * @param table the table to destroy
+     */
+    void jobs_destroy(jobTable *table);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif
@@ -1,12 +1,40 @@
 #include "lab.h"
+#include "arena.h"
+#include "histfile.h"
+#include "histindex.h"
+#include "jobs.h"
+#include "launch.h"
+#include "options.h"
+#include "parallel.h"
+#include "pathcache.h"
+#include "pipeline.h"
+#include "reaper.h"
+#include "redirect.h"
+#include "shstat.h"
+#include "tokenizer.h"
+#include "usage.h"
+#include "utilities.h"
 
 #include <errno.h>
 #include <pwd.h>
 #include <signal.h>
 #include <string.h>
 #include <stdio.h>
-#include <wait.h>
-#include <readline/history.h>
+#include <sys/wait.h>
+
+jobTable jobs = {NULL, NULL, NULL, 0, NULL, 0, 0, 0, 0, NULL, NULL};
+shellInput input = {NULL, NULL, NULL};
+
+/**
+ * @brief the arena holding every command parsed from the current line. It is
+ * reset by cmd_free once the line has been processed.
+ */
+static arena lineArena = {NULL, 0};
+
+/**
+ * @brief the token spans of the line being parsed, reused for every line.
+ */
+static tokenizer lineTokens = {NULL, 0, 0};
 
 void printJob(job info)
 {
@@ -18,6 +46,11 @@ void printJobRunning(job info)
     printf("[%d] %d Running %s\n", info.jobNum, info.pid, info.command);
 }
 
+void printJobQueued(job info)
+{
+    printf("[%d] Queued %s\n", info.jobNum, info.command);
+}
+
 void printDone(job doneJob)
 {
     printf("[%d] Done %s\n", doneJob.jobNum, doneJob.command);
@@ -30,64 +63,156 @@ void freeUp(void **ptr)
 }
 
 /**
- * @brief removes an element from a linked list of jobs.
- *
- * @param jobList a pointer to a pointer to the head of the job linked list.
- * @param current the jobNode to remove from the list. Should never be NULL.
- * @param previous the jobNode before current in the list. If current is the
- * first element of the list, previous should be NULL.
- * @param next the jobNode after current in the list. If current is the last
- * element of the list, next should be NULL.
+ * @brief prints a finished job with how it ended and what it used:
+ * [n] process-id Done command (exit 0, user 0.001s sys 0.002s maxrss 1780KB csw 2/0)
  */
-void removeFromList(jobNode **jobList, jobNode *current, jobNode *previous, jobNode *next)
+static void printDoneLong(job doneJob)
 {
-    // Current will never be null.
-    // Current could be the first item, in which case previous would be null.
-    // Next always may or may not be null.
-    freeUp((void **)&current->info.command);
-    freeUp((void **)&current);
-
-    if (previous == NULL)
-    {
-        *jobList = next;
-    }
+    printf("[%d] %d Done %s (", doneJob.jobNum, doneJob.pid, doneJob.command);
+    if (WIFSIGNALED(doneJob.status))
+        printf("signal %d, ", WTERMSIG(doneJob.status));
     else
-    {
-        previous->next = next;
-    }
+        printf("exit %d, ", WEXITSTATUS(doneJob.status));
+    usage_print(stdout, &doneJob.usage);
+    printf(")\n");
 }
 
-void reportAndManageFinishedJobs(jobNode **jobList, bool printAny, bool printAll)
+/**
+ * @brief records how a job's last command ended and marks the job done.
+ */
+static void recordExit(jobTable *table, jobEntry *entry, const childExit *exited)
 {
-    if (jobList == NULL) // This shouldn't happen.
+    entry->info.status = exited->status;
+    entry->info.usage = exited->usage;
+    jobs_finish(table, entry);
+}
+
+/**
+ * @brief reportAndManageFinishedJobs, where longFormat prints finished jobs
+ * with printDoneLong, as the timing option also does.
+ */
+static void reportJobs(jobTable *table, bool printAny, bool printAll, bool longFormat)
+{
+    longFormat = longFormat || options.timing;
+    if (table == NULL) // This shouldn't happen.
     {
         errno = EINVAL;
         perror("Error while reporting and managing jobs");
         return;
     }
 
-    jobNode *previousNode = NULL;
-    jobNode *currentNode = *jobList;
-    while (currentNode != NULL) // Iterate through the whole list
+    // Handle only the jobs the reaper saw exit
+    bool listAll = printAny && printAll;
+    childExit exited;
+    while (reaper_next(&exited))
+    {
+        jobEntry *entry = jobs_find_pid(table, exited.pid);
+        if (entry == NULL)
+        {   // A foreground child, nothing to report
+            continue;
+        }
+
+        recordExit(table, entry, &exited);
+        if (listAll)
+        {   // Leave it in the table so the jobs listing stays in order
+            continue;
+        }
+        if (printAny && longFormat)
+            printDoneLong(entry->info);
+        else if (printAny)
+            printDone(entry->info);
+        jobs_remove(table, entry);
+    }
+
+    if (!listAll && table->doneCount == 0)
+    {
+        return;
+    }
+
+    jobEntry *entry = table->head;
+    while (entry != NULL) // Iterate through every job in order
     {
-        jobNode *nextNode = currentNode->next;
-        int doneWaiting = waitpid(currentNode->info.pid, NULL, WNOHANG); // Check if still waiting for the job to complete.
-        if (doneWaiting != 0)
+        jobEntry *next = entry->next;
+        if (entry->info.state == JOB_DONE)
         {   // Job finished
-            if (printAny)
-                printDone(currentNode->info);
-            removeFromList(jobList, currentNode, previousNode, nextNode);
+            if (printAny && longFormat)
+                printDoneLong(entry->info);
+            else if (printAny)
+                printDone(entry->info);
+            jobs_remove(table, entry);
         }
-        else
+        else if (listAll && entry->info.state == JOB_RUNNING)
         {   // Job still running
-            previousNode = currentNode;
-            if (printAny && printAll)
-                printJobRunning(currentNode->info);
+            printJobRunning(entry->info);
+        }
+        else if (listAll)
+        {   // Job waiting for a slot
+            printJobQueued(entry->info);
+        }
+        entry = next;
+    }
+}
+
+void reportAndManageFinishedJobs(jobTable *table, bool printAny, bool printAll)
+{
+    SHSTAT_BEGIN(start);
+    reportJobs(table, printAny, printAll, false);
+    SHSTAT_END(start, SHSTAT_REPORT);
+}
+
+/**
+ * @brief starts one queued job from its command line.
+ *
+ * @return true if it is running
+ */
+static bool startQueuedJob(struct shell *sh, jobTable *table, jobEntry *entry)
+{
+    pipeline parsed;
+    if (cmd_parse_pipeline(entry->info.command, &parsed) != 0 || parsed.count == 0)
+    {
+        return false;
+    }
+
+    pid_t pids[2 * parsed.count - 1];
+    size_t started;
+    fflush(stdout);
+    if (start_pipeline(sh, &parsed, false, pids, &started) != 0)
+    {   // Don't leave a half started job behind
+        for (size_t idx = 0; idx < started; idx++)
+        {
+            reaper_wait(pids[idx], NULL);
+        }
+        return false;
+    }
+    jobs_start(table, entry, pids[started - 1]);
+    return true;
+}
+
+void admitQueuedJobs(struct shell *sh, jobTable *table)
+{
+    while (table->firstQueued != NULL && (options.maxJobs == 0 || table->runningCount < (size_t)options.maxJobs))
+    {
+        jobEntry *entry = table->firstQueued;
+        if (!startQueuedJob(sh, table, entry))
+        {
+            entry->info.status = W_EXITCODE(127, 0);
+            jobs_finish(table, entry);
         }
-        currentNode = nextNode;
     }
 }
 
+bool finishJob(struct shell *sh, jobTable *table, const childExit *exited)
+{
+    jobEntry *entry = jobs_find_pid(table, exited->pid);
+    if (entry == NULL)
+    {
+        return false;
+    }
+    recordExit(table, entry, exited);
+    admitQueuedJobs(sh, table);
+    return true;
+}
+
 /**
  * @brief a helper function for testing if 2 strings are equivalent.
  *
@@ -175,154 +300,354 @@ int change_dir(char **dir)
 
 char **cmd_parse(char const *line)
 {
-    const char *delims = " ";
+    size_t len = strlen(line);
 
-    // Trim white
-    char *destroyableLine = strdup(line);
-    char *trimmed = trim_white(destroyableLine);
-    freeUp((void **)&destroyableLine);
-
-    // Allocate array
-    const int maxArgCount = sysconf(_SC_ARG_MAX);
-    char **arrayOfStrings = malloc(sizeof(char *) * maxArgCount + 1);
-    if (arrayOfStrings == NULL) {
+    // Find the token boundaries in a single pass over the original line
+    if (tokenize(&lineTokens, line, len) < 0)
+    {
         perror("Error when parsing command");
         return NULL;
     }
 
-    // Split trimmed string into tokens by spaces
-    char *currentToken = strtok(trimmed, delims);
-    int currentTokenIndex = 0;
-    while (currentToken != NULL && currentTokenIndex < maxArgCount)
+    // Copy the line once, and terminate the tokens in place inside the copy
+    char *text = arena_strndup(&lineArena, line, len);
+    char **arrayOfStrings = text == NULL ? NULL : tokens_to_argv(&lineTokens, text, &lineArena);
+    if (arrayOfStrings == NULL)
     {
-        arrayOfStrings[currentTokenIndex] = strdup(currentToken); // Duplicate all the tokens for cleaner memory management
-        currentTokenIndex++;
-        currentToken = strtok(NULL, delims);
+        perror("Error when parsing command");
+        return NULL;
     }
 
-    freeUp((void **)&trimmed); // Free all of original string, which has been broken up by strtok
-    arrayOfStrings[currentTokenIndex] = NULL; // Put an end cap on the array
-
     return arrayOfStrings;
 }
 
-void cmd_free(char **line)
+int cmd_parse_pipeline(char const *line, pipeline *out)
 {
-    int strIdx = 0;
-    while (line[strIdx] != NULL)
+    size_t len = strlen(line);
+    if (tokenize(&lineTokens, line, len) < 0)
     {
-        freeUp((void **)&line[strIdx]);
-        strIdx++;
+        perror("Error when parsing command");
+        return -1;
     }
 
-    freeUp((void **)&line);
+    char *text = arena_strndup(&lineArena, line, len);
+    if (text == NULL)
+    {
+        perror("Error when parsing command");
+        return -1;
+    }
+    if (pipeline_parse(&lineTokens, text, &lineArena, out) != 0)
+    {
+        if (errno != EINVAL) // Syntax errors have already been reported
+            perror("Error when parsing command");
+        return -1;
+    }
+    return 0;
 }
 
-char *trim_white(char *line)
+int cmd_parse_list(char const *line, commandList *out)
 {
-    char *trimmed = strdup(line); // Let's not operate on the original string they passed in. Instead, return a modified copy.
-
-    if (trimmed == NULL)
+    size_t len = strlen(line);
+    if (tokenize(&lineTokens, line, len) < 0)
     {
-        return trimmed;
+        perror("Error when parsing command");
+        return -1;
     }
 
-    if (strlen(trimmed) == 0)
+    char *text = arena_strndup(&lineArena, line, len);
+    if (text == NULL)
     {
-        return trimmed;
+        perror("Error when parsing command");
+        return -1;
     }
-
-    int idx = 0;
-    while (idx < (int)strlen(trimmed) && trimmed[idx] == ' ')
+    if (list_parse(&lineTokens, text, &lineArena, out) != 0)
     {
-        idx++;
+        if (errno != EINVAL) // Syntax errors have already been reported
+            perror("Error when parsing command");
+        return -1;
     }
+    return 0;
+}
+
+int start_pipeline(struct shell *sh, pipeline *parsed, bool isForeground, pid_t *pids, size_t *started)
+{
+    *started = 0;
 
-    int endIdx = strlen(trimmed);
-    while (endIdx > 0 && trimmed[endIdx - 1] == ' ')
+    // Find the programs in the parent, so the locations are remembered for
+    // next time. Builtins are left without one, and run in a copy of the shell.
+    SHSTAT_BEGIN(lookupStart);
+    for (size_t idx = 0; idx < parsed->count; idx++)
     {
-        endIdx--;
+        command *cmd = &parsed->commands[idx];
+        if (cmd->argv[0] != NULL && is_builtin(cmd->argv[0]))
+        {
+            cmd->path = NULL;
+            continue;
+        }
+        cmd->path = pathcache_lookup(cmd->argv[0]);
+        if (cmd->path == NULL)
+        {
+            fprintf(stderr, "%s: command not found\n", cmd->argv[0]);
+            return -1;
+        }
     }
+    SHSTAT_END(lookupStart, SHSTAT_LOOKUP);
 
-    trimmed[endIdx] = '\0'; // End the string at the first trailing space
-    char *trimmedRet = &trimmed[idx]; // Start the string after the first leading space
+    // Open every redirected file before starting anything
+    for (size_t idx = 0; idx < parsed->count; idx++)
+    {
+        if (redirect_open(&parsed->commands[idx]) != 0)
+        {
+            for (size_t opened = 0; opened < idx; opened++)
+            {
+                redirect_close(&parsed->commands[opened]);
+            }
+            return -1;
+        }
+    }
 
-    // Duplicate the output string and free the modified one for clean memory management
-    char *final = strdup(trimmedRet);
-    freeUp((void **)&trimmed);
+    SHSTAT_BEGIN(launchStart);
+    int result = launch_pipeline(options.launcher, sh, parsed, isForeground, pids, started);
+    SHSTAT_END(launchStart, SHSTAT_LAUNCH);
+    if (result != 0)
+    {
+        perror("Error starting new process");
+    }
+    for (size_t idx = 0; idx < parsed->count; idx++)
+    {   // The children have their own copies
+        redirect_close(&parsed->commands[idx]);
+    }
+    return result;
+}
 
-    return final;
+void cmd_free(char **line)
+{
+    UNUSED(line);
+    arena_reset(&lineArena);
 }
 
-bool do_builtin(struct shell *sh, char **argv)
+char *trim_white(char *line)
 {
-    if (argv == NULL)
+    if (line == NULL)
     {
-        errno = EINVAL;
-        perror("Invalid command string");
-        return false;
+        return line;
     }
 
-    if (argv[0] == NULL)
+    size_t start = 0;
+    while (line[start] == ' ' || line[start] == '\t')
     {
-        errno = EINVAL;
-        perror("Invalid command string portion");
-        return false;
+        start++;
     }
 
-    char *cmd = argv[0];
-
-    // If it is the jobs command, print all jobs and exit.
-    bool printAll = false;
-    if (is(cmd, "jobs"))
+    size_t end = start + strlen(line + start);
+    while (end > start && (line[end - 1] == ' ' || line[end - 1] == '\t'))
     {
-        printAll = true;
+        end--;
     }
 
-    reportAndManageFinishedJobs(&jobList, true, printAll); // Still need to report finished jobs and manage the list even if it wasn't the jobs command.
+    // Move the printable characters to the front of the string
+    memmove(line, line + start, end - start);
+    line[end - start] = '\0';
 
-    if (printAll)
-    {
-        return true;
-    }
+    return line;
+}
+
+/**
+ * @brief runs a builtin. Every builtin has this signature, whatever it needs.
+ *
+ * @return the builtin's exit status
+ */
+typedef int (*builtinHandler)(struct shell *sh, char **argv);
+
+typedef struct builtinEntry {
+    const char *name;
+    builtinHandler run;
+} builtinEntry;
+
+static int jobsBuiltin(struct shell *sh, char **argv)
+{
+    UNUSED(sh);
+    reportJobs(&jobs, true, true, argv[1] != NULL && is(argv[1], "-l"));
+    return 0;
+}
+
+static int cdBuiltin(struct shell *sh, char **argv)
+{
+    UNUSED(sh);
+    return change_dir(argv) == 0 ? 0 : 1;
+}
+
+static int historyBuiltin(struct shell *sh, char **argv)
+{
+    UNUSED(sh);
+    return history_builtin(argv);
+}
+
+static int hashBuiltin(struct shell *sh, char **argv)
+{
+    UNUSED(sh);
+    return pathcache_builtin(argv);
+}
+
+static int setBuiltin(struct shell *sh, char **argv)
+{
+    UNUSED(sh);
+    return options_builtin(argv);
+}
+
+static int shstatBuiltin(struct shell *sh, char **argv)
+{
+    UNUSED(sh);
+    return shstat_builtin(argv);
+}
+
+static int timesBuiltin(struct shell *sh, char **argv)
+{
+    UNUSED(sh);
+    return times_builtin(argv);
+}
+
+static int echoBuiltin(struct shell *sh, char **argv)
+{
+    UNUSED(sh);
+    return echo_builtin(argv);
+}
+
+static int printfBuiltin(struct shell *sh, char **argv)
+{
+    UNUSED(sh);
+    return printf_builtin(argv);
+}
+
+static int testBuiltin(struct shell *sh, char **argv)
+{
+    UNUSED(sh);
+    return test_builtin(argv);
+}
+
+static int trueBuiltin(struct shell *sh, char **argv)
+{
+    UNUSED(sh);
+    UNUSED(argv);
+    return 0;
+}
+
+static int falseBuiltin(struct shell *sh, char **argv)
+{
+    UNUSED(sh);
+    UNUSED(argv);
+    return 1;
+}
 
-    // If it was not the jobs command, continue execution here.
-    if (is(cmd, "cd"))
+static int pwdBuiltin(struct shell *sh, char **argv)
+{
+    UNUSED(sh);
+    return pwd_builtin(argv);
+}
+
+static int exitBuiltin(struct shell *sh, char **argv)
+{
+    UNUSED(argv);
+    sh->exiting = true;
+    return 0;
+}
+
+#define BUILTIN_SLOTS 32 // A power of two, at least twice the number of builtins
+
+/**
+ * @brief the slot of a builtin name in builtinTable, from its length and its
+ * first and last characters. The multipliers were searched for so that no
+ * two builtins share a slot, which makes the table a perfect hash.
+ */
+#define BUILTIN_SLOT(len, first, last) \
+    (((len) + (unsigned char)(first) * 5u + (unsigned char)(last) * 8u) & (BUILTIN_SLOTS - 1))
+
+/**
+ * @brief places a builtin in its slot at compile time. A builtin that
+ * collides with another overwrites it, which -Wextra warns about, so the
+ * multipliers in BUILTIN_SLOT must be searched for again.
+ */
+#define BUILTIN(name, first, last, run) [BUILTIN_SLOT(sizeof(name) - 1, first, last)] = {name, run}
+
+/**
+ * @brief every command do_builtin handles, with empty slots in between.
+ */
+static const builtinEntry builtinTable[BUILTIN_SLOTS] = {
+    BUILTIN("jobs", 'j', 's', jobsBuiltin),
+    BUILTIN("cd", 'c', 'd', cdBuiltin),
+    BUILTIN("history", 'h', 'y', historyBuiltin),
+    BUILTIN("hash", 'h', 'h', hashBuiltin),
+    BUILTIN("set", 's', 't', setBuiltin),
+    BUILTIN("times", 't', 's', timesBuiltin),
+    BUILTIN("shstat", 's', 't', shstatBuiltin),
+    BUILTIN("parallel", 'p', 'l', parallel_builtin),
+    BUILTIN("exit", 'e', 't', exitBuiltin),
+    BUILTIN("echo", 'e', 'o', echoBuiltin),
+    BUILTIN("printf", 'p', 'f', printfBuiltin),
+    BUILTIN("test", 't', 't', testBuiltin),
+    BUILTIN("[", '[', '[', testBuiltin),
+    BUILTIN("true", 't', 'e', trueBuiltin),
+    BUILTIN("false", 'f', 'e', falseBuiltin),
+    BUILTIN("pwd", 'p', 'd', pwdBuiltin),
+};
+
+/**
+ * @brief finds a builtin with one hash and one string comparison.
+ *
+ * @return the builtin, or NULL if name is not one
+ */
+static const builtinEntry *findBuiltin(const char *name)
+{
+    size_t len = strlen(name);
+    if (len == 0)
     {
-        change_dir(argv);
-        return true;
+        return NULL;
     }
-    else if (is(cmd, "history"))
+    const builtinEntry *entry = &builtinTable[BUILTIN_SLOT(len, name[0], name[len - 1])];
+    return entry->name != NULL && strcmp(entry->name, name) == 0 ? entry : NULL;
+}
+
+bool is_builtin(const char *name)
+{
+    return findBuiltin(name) != NULL;
+}
+
+bool do_builtin(struct shell *sh, char **argv)
+{
+    if (argv == NULL)
     {
-        HIST_ENTRY **allHistory = history_list();
-        if (allHistory)
-        {
-            int idx = 0;
-            while (allHistory[idx] != NULL)
-            {
-                printf("\t- %s\n", allHistory[idx]->line);
-                idx++;
-            }
-        }
-        return true;
+        errno = EINVAL;
+        perror("Invalid command string");
+        return false;
     }
-    else if (is(cmd, "exit"))
+
+    if (argv[0] == NULL)
     {
-        sh->exiting = true;
-        return true;
+        errno = EINVAL;
+        perror("Invalid command string portion");
+        return false;
     }
-    else
+
+    const builtinEntry *builtin = findBuiltin(argv[0]);
+    if (builtin == NULL)
     {
         return false;
     }
+    sh->status = builtin->run(sh, argv);
+    return true;
 }
 
 void sh_init(struct shell *sh)
 {
     sh->exiting = false;
+    sh->status = 0;
     sh->prompt = get_prompt("MY_PROMPT");
     sh->shell_terminal = STDIN_FILENO;
-    sh->shell_is_interactive = isatty(sh->shell_terminal);
+    sh->shell_is_interactive = input.command == NULL && input.file == NULL && input.socket == NULL &&
+                              isatty(sh->shell_terminal);
+
+    // Children are reaped as they exit, interactive or not
+    reaper_install();
 
     if (sh->shell_is_interactive) // This will always be true if we are running on stdin and stdout.
     {
@@ -336,7 +661,6 @@ void sh_init(struct shell *sh)
         signal(SIGTSTP, SIG_IGN);
         signal(SIGTTIN, SIG_IGN);
         signal(SIGTTOU, SIG_IGN);
-        signal(SIGCHLD, SIG_IGN);
 
         sh->shell_pgid = getpid();
         if (setpgid(sh->shell_pgid, sh->shell_pgid) < 0)
@@ -357,15 +681,41 @@ void sh_init(struct shell *sh)
 void sh_destroy(struct shell *sh)
 {
     freeUp((void **)&sh->prompt);
+    arena_destroy(&lineArena);
+    tokenizer_destroy(&lineTokens);
+    pathcache_clear();
+    histfile_close(&historyFile);
+    history_index_destroy();
 }
 
 void parse_args(int argc, char **argv)
 {
+    // MAXJOBS sets the maxjobs option, which -o can still change
+    const char *maxJobs = getenv("MAXJOBS");
+    if (maxJobs != NULL)
+    {
+        char assignment[64];
+        snprintf(assignment, sizeof(assignment), "maxjobs=%s", maxJobs);
+        options_set(assignment);
+    }
+
     int c;
-    while ((c = getopt(argc, argv, "v")) != -1)
+    while ((c = getopt(argc, argv, "c:vo:S:")) != -1)
     {
         switch (c)
         {
+        case 'c':
+            input.command = optarg;
+            break;
+        case 'S':
+            input.socket = optarg;
+            break;
+        case 'o':
+            if (options_set(optarg) != 0)
+            {
+                exit(2);
+            }
+            break;
         case 'v':
             fprintf(stdout, "%s Version %d.%d\n", getProgramName(), lab_VERSION_MAJOR, lab_VERSION_MINOR);
             exit(0);
@@ -374,6 +724,10 @@ void parse_args(int argc, char **argv)
             break;
         }
     }
+    if (input.command == NULL && optind < argc)
+    {
+        input.file = argv[optind];
+    }
 }
 
 const char *getProgramName()
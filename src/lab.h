@@ -2,10 +2,14 @@
 #define LAB_H
 #include <stdlib.h>
 #include <stdbool.h>
+#include <sys/resource.h>
 #include <sys/types.h>
 #include <termios.h>
 #include <unistd.h>
 
+#include "pipeline.h"
+#include "reaper.h"
+
 #define lab_VERSION_MAJOR 1
 #define lab_VERSION_MINOR 0
 #define UNUSED(x) (void)x;
@@ -15,18 +19,78 @@ extern "C"
 {
 #endif
 
+    /**
+     * @brief where a job is in its life. A queued job is waiting for a slot
+     * under the maxjobs option, and has no process yet.
+     */
+    typedef enum jobState {
+        JOB_QUEUED,
+        JOB_RUNNING,
+        JOB_DONE,
+    } jobState;
+
     typedef struct job {
         int jobNum;
-        pid_t pid;
+        pid_t pid;      // 0 while the job is queued
         char *command;
+        jobState state;
+        int status;           // The wait status, once done
+        struct rusage usage;  // The resources its last command used, once done
     } job;
 
-    typedef struct jobNode {
+    /**
+     * @brief a job in a jobTable. Entries are linked in the order the jobs
+     * were started, which is also job number order.
+     */
+    typedef struct jobEntry {
         job info;
-        struct jobNode *next;
-    } jobNode;
+        int watch;  // The table's watcher's id for the running process, or -1
+        struct jobEntry *prev;
+        struct jobEntry *next;
+    } jobEntry;
+
+    /**
+     * @brief told when a job's process starts running and when it stops, so
+     * the prompt's event loop holds one pidfd watch for each running job for
+     * its whole life.
+     */
+    typedef struct jobWatcher {
+        int (*watch)(pid_t pid, void *context);  // Returns the watch's id, or -1
+        void (*unwatch)(int watch, void *context);
+        void *context;
+    } jobWatcher;
+
+    /**
+     * @brief the shell's background jobs. Adding and removing a job, and finding
+     * one by job number or by pid, are all O(1). See jobs.h.
+     */
+    typedef struct jobTable {
+        jobEntry *head;
+        jobEntry *tail;
+        jobEntry **byNum;   // Indexed by job number
+        size_t byNumCapacity;
+        jobEntry **byPid;   // Open addressing hash table of the running jobs, keyed by pid
+        size_t byPidCapacity;
+        size_t count;
+        size_t runningCount;
+        size_t doneCount;       // Done jobs still in the table, waiting to be reported
+        jobEntry *firstQueued;  // The oldest queued job, the next one to start
+        const jobWatcher *watcher;  // NULL when nothing watches the running jobs
+    } jobTable;
 
-    jobNode *jobList;
+    extern jobTable jobs;
+
+    /**
+     * @brief where the shell reads commands from, set by parse_args. With
+     * none set, commands are read from stdin.
+     */
+    typedef struct shellInput {
+        const char *command;  // The string given with -c
+        const char *file;     // The script file named after the options
+        const char *socket;   // The Unix socket given with -S to serve commands on
+    } shellInput;
+
+    extern shellInput input;
 
     struct shell {
         int shell_is_interactive;
@@ -35,6 +99,7 @@ extern "C"
         int shell_terminal;
         char *prompt;
         bool exiting;
+        int status;  // The exit status of the last pipeline run, as in $?
     };
 
     /**
@@ -53,6 +118,14 @@ extern "C"
      */
     void printJobRunning(job info);
 
+    /**
+     * @brief prints info about a job to the console in the following format:
+     * [n] Queued command
+     *
+     * @param info the job to print
+     */
+    void printJobQueued(job info);
+
     /**
      * @brief prints info about a job to the console in the following format:
      * [n] Done command
@@ -70,17 +143,43 @@ extern "C"
     void freeUp(void **ptr);
 
     /**
-     * @brief loops through a provided list of jobs, and removes all jobs that
-     * are discovered to be finished. If printAny is true, also prints to the
-     * console any finished jobs while iterating. If printAll && printAny is
-     * true, also prints to the console all jobs that are still running while
-     * iterating.
+     * @brief removes all jobs that the SIGCHLD reaper has seen finish since the
+     * last call, and any that finishJob marked done. Only the jobs that
+     * actually finished are touched, and no system calls are made. If
+     * printAny is true, also prints to the console any finished jobs. If
+     * printAll && printAny is true, instead loops through every job in order,
+     * printing it as done, running or queued.
      *
-     * @param jobList the linked list of jobs to iterate through
+     * @param table the table of jobs to manage
      * @param printAny if finished jobs should be printed to the console
      * @param printAll if running jobs should be printed to the console
      */
-    void reportAndManageFinishedJobs(jobNode **jobList, bool printAny, bool printAll);
+    void reportAndManageFinishedJobs(jobTable *table, bool printAny, bool printAll);
+
+    /**
+     * @brief starts queued jobs, oldest first, while fewer than the maxjobs
+     * option are running. A job that fails to start is marked done. Their
+     * lines are parsed again in the per-line arena, so the caller must
+     * cmd_free afterwards.
+     *
+     * @param sh the shell
+     * @param table the table of jobs
+     */
+    void admitQueuedJobs(struct shell *sh, jobTable *table);
+
+    /**
+     * @brief marks the job a reaped child belonged to as done, recording its
+     * status and resource usage, leaving it in the table for
+     * reportAndManageFinishedJobs to report, and starts queued jobs in the
+     * slot it freed. Like admitQueuedJobs, the caller must cmd_free
+     * afterwards.
+     *
+     * @param sh the shell
+     * @param table the table of jobs
+     * @param exited the child that exited
+     * @return true if the child was a running job
+     */
+    bool finishJob(struct shell *sh, jobTable *table, const childExit *exited);
 
     /**
      * @brief Set the shell prompt. This function will attempt to load a prompt
@@ -106,9 +205,9 @@ extern "C"
 
     /**
      * @brief Convert line read from the user into to format that will work with
-     * execvp. We limit the number of arguments to ARG_MAX loaded from sysconf.
-     * This function allocates memory that must be reclaimed with the cmd_free
-     * function.
+     * execvp. The array and its strings are carved out of a per-line arena
+     * instead of being allocated one by one, and must be reclaimed with the
+     * cmd_free function.
      *
      * @param line The line to process
      *
@@ -117,7 +216,50 @@ extern "C"
     char **cmd_parse(char const *line);
 
     /**
-     * @brief Free the line that was constructed with parse_cmd
+     * @brief Parse a line into a pipeline of commands, separated by "|" and
+     * optionally ending with "&". Like cmd_parse, everything is carved out of
+     * the per-line arena and must be reclaimed with cmd_free.
+     *
+     * @param line The line to process
+     * @param out The pipeline to fill in
+     * @return 0 on success, or -1 if the line is not valid or memory ran out.
+     * errno is EINVAL for a line that is not valid, which has been reported.
+     */
+    int cmd_parse_pipeline(char const *line, pipeline *out);
+
+    /**
+     * @brief Parse a line into a list of pipelines separated by ";", "&",
+     * "&&" and "||", as list_parse does. Like cmd_parse, everything is carved
+     * out of the per-line arena and must be reclaimed with cmd_free.
+     *
+     * @param line The line to process
+     * @param out The list to fill in
+     * @return 0 on success, or -1 if the line is not valid or memory ran out.
+     * errno is EINVAL for a line that is not valid, which has been reported.
+     */
+    int cmd_parse_list(char const *line, commandList *out);
+
+    /**
+     * @brief looks up the programs of a parsed pipeline, opens the files it
+     * redirects, and starts it. Builtins in it run in forked copies of the
+     * shell, so "seq 3 | parallel echo" reads the pipe. Problems are
+     * reported.
+     *
+     * @param sh the shell
+     * @param parsed the pipeline to start
+     * @param isForeground if the pipeline gets the terminal
+     * @param pids filled in with the started processes, which needs room for
+     * 2 * parsed->count - 1 of them
+     * @param started set to how many processes were started
+     * @return 0 on success, or -1 if it could not be started. Any processes
+     * that were started before a failure still need to be waited for.
+     */
+    int start_pipeline(struct shell *sh, pipeline *parsed, bool isForeground, pid_t *pids, size_t *started);
+
+    /**
+     * @brief Free the line that was constructed with parse_cmd. This resets the
+     * per-line arena in O(1), so it also frees every other command parsed since
+     * the last call to cmd_free.
      *
      * @param line the line to free
      */
@@ -127,7 +269,7 @@ extern "C"
      * @brief Trim the whitespace from the start and end of a string.
      * For example "   ls -a   " becomes "ls -a". This function modifies
      * the argument line so that all printable chars are moved to the
-     * front of the string
+     * front of the string, and does not allocate.
      *
      * @param line The line to trim
      * @return The new line with no whitespace
@@ -136,10 +278,10 @@ extern "C"
 
     /**
      * @brief Takes an argument list and checks if the first argument is a
-     * built in command such as exit, cd, jobs, etc. If the command is a
-     * built in command this function will handle the command and then return
-     * true. If the first argument is NOT a built in command this function will
-     * return false.
+     * built in command such as exit, cd, jobs, echo, test, etc. If the command
+     * is a built in command this function will handle the command, store its
+     * exit status in sh->status and then return true. If the first argument
+     * is NOT a built in command this function will return false.
      *
      * @param sh The shell
      * @param argv The command to check
@@ -147,6 +289,15 @@ extern "C"
      */
     bool do_builtin(struct shell *sh, char **argv);
 
+    /**
+     * @brief Checks if a command name is one do_builtin handles, without
+     * running it.
+     *
+     * @param name The command name
+     * @return True if the command is a built in command
+     */
+    bool is_builtin(const char *name);
+
     /**
      * @brief Initialize the shell for use. Allocate all data structures
      * Grab control of the terminal and put the shell in its own
@@ -168,7 +319,10 @@ extern "C"
     void sh_destroy(struct shell *sh);
 
     /**
-     * @brief Parse command line args from the user when the shell was launched
+     * @brief Parse command line args from the user when the shell was launched.
+     * "-c string" runs string, the first argument after the options names
+     * a script file to run, and "-S path" serves command lines on a Unix
+     * socket at path. Any of them makes the shell non-interactive.
      *
      * @param argc Number of args
      * @param argv The arg array
@@ -0,0 +1,375 @@
+#define _GNU_SOURCE
+#include "launch.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "reaper.h"
+#include "zygote.h"
+
+extern char **environ;
+
+#define RELAY_CHUNK 65536 // Bytes a relay asks splice to move at once
+
+/**
+ * @brief the signals the shell ignores, which every child gets back at their
+ * default disposition.
+ */
+static const int jobControlSignals[] = {SIGINT, SIGQUIT, SIGTSTP, SIGTTIN, SIGTTOU, SIGCHLD};
+
+#define JOB_CONTROL_SIGNAL_COUNT (sizeof(jobControlSignals) / sizeof(jobControlSignals[0]))
+
+void setUpChildProcessGroupAndForeground(pid_t id, pid_t pgid, struct shell *sh, bool isForeground)
+{
+    setpgid(id, pgid);
+    if (isForeground)
+        tcsetpgrp(sh->shell_terminal, pgid == 0 ? id : pgid);
+}
+
+void launch_setup_child(struct shell *sh, pid_t pgid, bool isForeground)
+{
+    if (sh->shell_is_interactive && pgid != LAUNCH_SHELL_GROUP)
+    {
+        setUpChildProcessGroupAndForeground(getpid(), pgid, sh, isForeground);
+    }
+    for (size_t idx = 0; idx < JOB_CONTROL_SIGNAL_COUNT; idx++)
+    {
+        signal(jobControlSignals[idx], SIG_DFL);
+    }
+    sigset_t noneBlocked;
+    sigemptyset(&noneBlocked);
+    sigprocmask(SIG_SETMASK, &noneBlocked, NULL);
+}
+
+/**
+ * @brief gives a forked child the stage's stdin, stdout and redirections,
+ * exiting it if one cannot be set up.
+ */
+static void connectStage(const stageIo *io)
+{
+    if ((io->in != STDIN_FILENO && dup2(io->in, STDIN_FILENO) == -1) ||
+        (io->out != STDOUT_FILENO && dup2(io->out, STDOUT_FILENO) == -1))
+    {
+        perror("Error connecting pipeline");
+        _exit(126);
+    }
+    for (size_t idx = 0; idx < io->redirectCount; idx++)
+    {
+        const redirection *r = &io->redirects[idx];
+        if (r->kind == REDIRECT_CLOSE)
+        {
+            close(r->fd);
+        }
+        else if (dup2(r->source, r->fd) == -1)
+        {
+            fprintf(stderr, "%d: %s\n", r->source, strerror(errno));
+            _exit(1);
+        }
+    }
+}
+
+/**
+ * @brief forks and execs in the child. The child copies the shell's page
+ * tables, so this gets slower as the shell's memory grows.
+ */
+static pid_t launchWithFork(struct shell *sh, const char *path, char **argv, bool isForeground, const stageIo *io)
+{
+    pid_t pid = fork();
+    if (pid != 0)
+    {
+        return pid;
+    }
+
+    // Child process
+    launch_setup_child(sh, io->pgid, isForeground);
+    connectStage(io);
+
+    // Transform yourself into the new process and execute
+    execv(path, argv);
+    if (errno == ENOENT)
+    {   // The remembered location went stale, search $PATH again
+        execvp(argv[0], argv);
+    }
+
+    perror("An error occured while executing the command");
+    _exit(127);
+}
+
+/**
+ * @brief starts the child with posix_spawn, which glibc implements with
+ * clone(CLONE_VM|CLONE_VFORK), so no page tables are copied. The process
+ * group, terminal handoff and signal reset are done by spawn attributes.
+ */
+static pid_t launchWithSpawn(struct shell *sh, const char *path, char **argv, bool isForeground, const stageIo *io)
+{
+    posix_spawnattr_t attr;
+    posix_spawn_file_actions_t actions;
+    posix_spawnattr_init(&attr);
+    posix_spawn_file_actions_init(&actions);
+
+    sigset_t defaults;
+    sigset_t noneBlocked;
+    sigemptyset(&defaults);
+    sigemptyset(&noneBlocked);
+    for (size_t idx = 0; idx < JOB_CONTROL_SIGNAL_COUNT; idx++)
+    {
+        sigaddset(&defaults, jobControlSignals[idx]);
+    }
+    posix_spawnattr_setsigdefault(&attr, &defaults);
+    posix_spawnattr_setsigmask(&attr, &noneBlocked);
+    short flags = POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETSIGMASK;
+
+    if (sh->shell_is_interactive && io->pgid != LAUNCH_SHELL_GROUP)
+    {
+        flags |= POSIX_SPAWN_SETPGROUP;
+        posix_spawnattr_setpgroup(&attr, io->pgid);
+#if defined(__GLIBC__) && __GLIBC_PREREQ(2, 35)
+        // Hand over the terminal before exec, as the forked child would. Later
+        // members of a pipeline join a group that already has it.
+        if (isForeground && io->pgid == 0)
+        {
+            posix_spawn_file_actions_addtcsetpgrp_np(&actions, sh->shell_terminal);
+        }
+#endif
+    }
+    posix_spawnattr_setflags(&attr, flags);
+    if (io->in != STDIN_FILENO)
+        posix_spawn_file_actions_adddup2(&actions, io->in, STDIN_FILENO);
+    if (io->out != STDOUT_FILENO)
+        posix_spawn_file_actions_adddup2(&actions, io->out, STDOUT_FILENO);
+    for (size_t idx = 0; idx < io->redirectCount; idx++)
+    {
+        const redirection *r = &io->redirects[idx];
+        if (r->kind == REDIRECT_CLOSE)
+            posix_spawn_file_actions_addclose(&actions, r->fd);
+        else
+            posix_spawn_file_actions_adddup2(&actions, r->source, r->fd);
+    }
+
+    pid_t pid;
+    int error = posix_spawn(&pid, path, &actions, &attr, argv, environ);
+    if (error == ENOENT)
+    {   // The remembered location went stale, search $PATH again
+        error = posix_spawnp(&pid, argv[0], &actions, &attr, argv, environ);
+    }
+
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attr);
+    if (error != 0)
+    {
+        errno = error;
+        return -1;
+    }
+    return pid;
+}
+
+/**
+ * @brief forks a copy of the shell that runs a builtin as a stage of a
+ * pipeline and exits with its status. The copy keeps the reaper for the
+ * commands a builtin like parallel starts, and starts them itself, since
+ * the zygote's children would be the shell's. It is not interactive, so
+ * they stay in the pipeline's process group.
+ */
+static pid_t launchBuiltin(struct shell *sh, char **argv, bool isForeground, const stageIo *io)
+{
+    pid_t pid = fork();
+    if (pid != 0)
+    {
+        return pid;
+    }
+
+    launch_setup_child(sh, io->pgid, isForeground);
+    reaper_install();
+    connectStage(io);
+    sh->shell_is_interactive = false;
+    jobs.watcher = NULL; // The prompt's event loop is the shell's, not this copy's
+    if (options.launcher == LAUNCH_ZYGOTE)
+    {
+        options.launcher = LAUNCH_SPAWN;
+    }
+    do_builtin(sh, argv);
+    fflush(stdout);
+    _exit(sh->status);
+}
+
+/**
+ * @brief starts one process with the chosen launcher.
+ */
+static pid_t launchStage(launchMethod method, struct shell *sh, const char *path, char **argv, bool isForeground, const stageIo *io)
+{
+    if (method == LAUNCH_ZYGOTE)
+    {
+        pid_t pid = zygote_launch(sh, path, argv, isForeground, io);
+        if (pid != -1)
+        {
+            return pid;
+        }
+        // The zygote could not be reached or could not clone, so try without it
+    }
+    if (method != LAUNCH_FORK)
+    {
+        return launchWithSpawn(sh, path, argv, isForeground, io);
+    }
+    return launchWithFork(sh, path, argv, isForeground, io);
+}
+
+pid_t launch_process(launchMethod method, struct shell *sh, const char *path, char **argv, bool isForeground)
+{
+    stageIo io = {0, STDIN_FILENO, STDOUT_FILENO, NULL, 0};
+    return launchStage(method, sh, path, argv, isForeground, &io);
+}
+
+pid_t launch_command(launchMethod method, struct shell *sh, const command *cmd, int inFd)
+{
+    stageIo io = {LAUNCH_SHELL_GROUP, inFd, STDOUT_FILENO, cmd->redirects, cmd->redirectCount};
+    return launchStage(method, sh, cmd->path, cmd->argv, false, &io);
+}
+
+/**
+ * @brief creates a close-on-exec pipe between two pipeline stages, grown to
+ * the pipesize option if it is set.
+ */
+static int makeStagePipe(int fds[2])
+{
+    if (pipe2(fds, O_CLOEXEC) == -1)
+    {
+        return -1;
+    }
+    if (options.pipeSize > 0)
+    {
+        // Sizes over /proc/sys/fs/pipe-max-size fail without privileges, the pipe still works
+        fcntl(fds[1], F_SETPIPE_SZ, options.pipeSize);
+    }
+    return 0;
+}
+
+/**
+ * @brief forks a process that moves everything from in to out with splice,
+ * so the data goes from one pipe buffer to the other without passing
+ * through user space. It joins the pipeline's process group like a stage.
+ *
+ * @param closeFd a descriptor the relay must close so a stage can see EOF
+ */
+static pid_t launchRelay(struct shell *sh, pid_t pgid, bool isForeground, int in, int out, int closeFd)
+{
+    pid_t pid = fork();
+    if (pid != 0)
+    {
+        return pid;
+    }
+
+    launch_setup_child(sh, pgid, isForeground);
+    close(closeFd);
+    size_t chunk = options.pipeSize > 0 ? (size_t)options.pipeSize : RELAY_CHUNK;
+    while (true)
+    {
+        ssize_t moved = splice(in, NULL, out, NULL, chunk, SPLICE_F_MOVE | SPLICE_F_MORE);
+        if (moved == 0)
+        {
+            _exit(0);
+        }
+        if (moved == -1 && errno != EINTR)
+        {
+            _exit(errno == EPIPE ? 0 : 1);
+        }
+    }
+}
+
+/**
+ * @brief records a started process, making the first one the group leader.
+ */
+static void addStarted(struct shell *sh, pid_t pid, bool isForeground, pid_t *pids, size_t *started, stageIo *io)
+{
+    if (sh->shell_is_interactive)
+    {
+        setUpChildProcessGroupAndForeground(pid, io->pgid, sh, isForeground);
+    }
+    if (io->pgid == 0)
+    {
+        io->pgid = pid;
+    }
+    pids[(*started)++] = pid;
+}
+
+int launch_pipeline(launchMethod method, struct shell *sh, const pipeline *line, bool isForeground, pid_t *pids, size_t *started)
+{
+    *started = 0;
+    stageIo io = {0, STDIN_FILENO, STDOUT_FILENO, NULL, 0};
+    int result = 0;
+
+    // Keep the reaper from reaping a command before the rest have joined its
+    // process group, which would stop existing with it
+    sigset_t chld, old;
+    sigemptyset(&chld);
+    sigaddset(&chld, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &chld, &old);
+
+    for (size_t idx = 0; idx < line->count; idx++)
+    {
+        bool last = idx + 1 == line->count;
+        int stagePipe[2] = {-1, -1};
+        if (!last && makeStagePipe(stagePipe) == -1)
+        {
+            result = -1;
+            break;
+        }
+        io.out = last ? STDOUT_FILENO : stagePipe[1];
+
+        const command *cmd = &line->commands[idx];
+        io.redirects = cmd->redirects;
+        io.redirectCount = cmd->redirectCount;
+        pid_t pid = cmd->path == NULL ? launchBuiltin(sh, cmd->argv, isForeground, &io)
+                                       : launchStage(method, sh, cmd->path, cmd->argv, isForeground, &io);
+        int launchErrno = errno;
+
+        // The stage has its own copies of these now
+        if (io.in != STDIN_FILENO)
+            close(io.in);
+        if (!last)
+            close(stagePipe[1]);
+        io.in = last ? STDIN_FILENO : stagePipe[0];
+        if (pid == -1)
+        {
+            errno = launchErrno;
+            result = -1;
+            break;
+        }
+        addStarted(sh, pid, isForeground, pids, started, &io);
+
+        if (!last && options.relay)
+        {
+            int relayPipe[2];
+            if (makeStagePipe(relayPipe) == -1)
+            {
+                result = -1;
+                break;
+            }
+            pid_t relay = launchRelay(sh, io.pgid, isForeground, io.in, relayPipe[1], relayPipe[0]);
+            launchErrno = errno;
+            close(io.in);
+            close(relayPipe[1]);
+            io.in = relayPipe[0];
+            if (relay == -1)
+            {
+                errno = launchErrno;
+                result = -1;
+                break;
+            }
+            addStarted(sh, relay, isForeground, pids, started, &io);
+        }
+    }
+
+    if (io.in != STDIN_FILENO)
+    {
+        close(io.in);
+    }
+    int savedErrno = errno;
+    sigprocmask(SIG_SETMASK, &old, NULL);
+    errno = savedErrno;
+    return result;
+}
@@ -0,0 +1,112 @@
+#ifndef LAUNCH_H
+#define LAUNCH_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#include "lab.h"
+#include "options.h"
+#include "pipeline.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define LAUNCH_SHELL_GROUP -1 // A stageIo pgid that keeps the child in the shell's process group
+
+    /**
+     * @brief where a child's stdin and stdout come from, the redirections
+     * applied after them, and the process group it joins. A pgid of 0 makes
+     * the child the leader of a new group, and LAUNCH_SHELL_GROUP leaves it in
+     * the shell's group.
+     */
+    typedef struct stageIo {
+        pid_t pgid;
+        int in;
+        int out;
+        const redirection *redirects;
+        size_t redirectCount;
+    } stageIo;
+
+    /**
+     * @brief Puts the specified process in the process group pgid, or in its
+     * own group if pgid is 0, and if isForeground is true, gives that group
+     * control of the console.
+     *
+     * @param id the process ID.
+     * @param pgid the process group to join, or 0 to start a new one.
+     * @param sh the shell struct containing info on the file descriptor associated
+     * with the terminal to take control of.
+     * @param isForeground whether or not the process with pid id should run in the
+     * foreground and take control of the console.
+     */
+    void setUpChildProcessGroupAndForeground(pid_t id, pid_t pgid, struct shell *sh, bool isForeground);
+
+    /**
+     * @brief the setup every child does before it runs a program: join its
+     * process group, take the terminal if it is in the foreground, and get
+     * the job control signals back. Only the groups of an interactive shell
+     * are changed.
+     *
+     * @param sh the shell
+     * @param pgid the group to join, 0 for a new one, or LAUNCH_SHELL_GROUP
+     * @param isForeground whether the child should get the terminal
+     */
+    void launch_setup_child(struct shell *sh, pid_t pgid, bool isForeground);
+
+    /**
+     * @brief starts a program as a child of the shell. When the shell is
+     * interactive the child is put in its own process group, given the terminal
+     * if isForeground is true, and has the job control signals the shell
+     * ignores reset to their defaults, no matter which method is used.
+     *
+     * @param method fork + execv, posix_spawn, or the zygote
+     * @param sh the shell
+     * @param path the program to run, usually from pathcache_lookup
+     * @param argv the program's arguments, NULL terminated
+     * @param isForeground whether the child should get the terminal
+     * @return the child's pid, or -1 with errno set if it could not be started
+     */
+    pid_t launch_process(launchMethod method, struct shell *sh, const char *path, char **argv, bool isForeground);
+
+    /**
+     * @brief starts one command with stdin from inFd. It stays in the shell's
+     * process group, so it gets the signals the terminal sends the shell,
+     * such as SIGINT, and never has the terminal to itself.
+     *
+     * @param method fork + execv, posix_spawn, or the zygote
+     * @param sh the shell
+     * @param cmd the command, with its path filled in and its files opened
+     * @param inFd the descriptor to use as the command's stdin
+     * @return the child's pid, or -1 with errno set if it could not be started
+     */
+    pid_t launch_command(launchMethod method, struct shell *sh, const command *cmd, int inFd);
+
+    /**
+     * @brief starts every command of a pipeline, each one's stdout connected
+     * to the next one's stdin. When the shell is interactive they all join the
+     * first command's process group, which gets the terminal if isForeground
+     * is true. The pipesize option grows the pipes, and the relay option puts
+     * a splice process between every pair of commands. Every command must
+     * already have its path filled in and its files opened with
+     * redirect_open. A command whose path is NULL is a builtin, which runs in
+     * a forked copy of the shell whatever the method.
+     *
+     * @param method fork + execv, posix_spawn, or the zygote
+     * @param sh the shell
+     * @param line the pipeline to start
+     * @param isForeground whether the pipeline should get the terminal
+     * @param pids filled with the pid of every process started, in order,
+     * which needs room for 2 * line->count - 1 pids
+     * @param started set to the number of processes started
+     * @return 0 on success, or -1 with errno set if a process could not be
+     * started. The processes started before it are left running.
+     */
+    int launch_pipeline(launchMethod method, struct shell *sh, const pipeline *line, bool isForeground, pid_t *pids, size_t *started);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif
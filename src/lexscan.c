@@ -0,0 +1,217 @@
+#include "lexscan.h"
+
+#include <stdint.h>
+
+#if !defined(LEX_NO_SIMD) && (defined(__x86_64__) || defined(__i386__))
+#define LEX_HAVE_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+/**
+ * @brief the pair of scanners that make up one implementation.
+ */
+typedef struct lexScanners {
+    lexImpl impl;
+    size_t (*findSpecial)(const char *line, size_t len, size_t from);
+    size_t (*skipBlanks)(const char *line, size_t len, size_t from);
+} lexScanners;
+
+/**
+ * @brief returns true if c ends or changes the meaning of an unquoted word.
+ */
+static inline bool isSpecial(char c)
+{
+    return lex_is_blank(c) || lex_is_operator(c) || c == '\'' || c == '"' || c == '\\';
+}
+
+static size_t findSpecialScalar(const char *line, size_t len, size_t from)
+{
+    while (from < len && !isSpecial(line[from]))
+    {
+        from++;
+    }
+    return from;
+}
+
+static size_t skipBlanksScalar(const char *line, size_t len, size_t from)
+{
+    while (from < len && lex_is_blank(line[from]))
+    {
+        from++;
+    }
+    return from;
+}
+
+#ifdef LEX_HAVE_X86_SIMD
+// SSE2 is part of the x86-64 baseline, so these need no target attribute there.
+
+/**
+ * @brief returns a mask with a bit set for every special byte of chunk.
+ */
+static inline unsigned specialMask16(__m128i chunk)
+{
+    __m128i hits = _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\t')));
+    hits = _mm_or_si128(hits, _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\'')));
+    hits = _mm_or_si128(hits, _mm_cmpeq_epi8(chunk, _mm_set1_epi8('"')));
+    hits = _mm_or_si128(hits, _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\\')));
+    hits = _mm_or_si128(hits, _mm_cmpeq_epi8(chunk, _mm_set1_epi8('&')));
+    hits = _mm_or_si128(hits, _mm_cmpeq_epi8(chunk, _mm_set1_epi8('|')));
+    hits = _mm_or_si128(hits, _mm_cmpeq_epi8(chunk, _mm_set1_epi8(';')));
+    hits = _mm_or_si128(hits, _mm_cmpeq_epi8(chunk, _mm_set1_epi8('<')));
+    hits = _mm_or_si128(hits, _mm_cmpeq_epi8(chunk, _mm_set1_epi8('>')));
+    return (unsigned)_mm_movemask_epi8(hits);
+}
+
+static inline unsigned blankMask16(__m128i chunk)
+{
+    __m128i hits = _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\t')));
+    return (unsigned)_mm_movemask_epi8(hits);
+}
+
+static size_t findSpecialSse2(const char *line, size_t len, size_t from)
+{
+    while (from + 16 <= len)
+    {
+        unsigned mask = specialMask16(_mm_loadu_si128((const __m128i *)(line + from)));
+        if (mask != 0)
+        {
+            return from + __builtin_ctz(mask);
+        }
+        from += 16;
+    }
+    return findSpecialScalar(line, len, from);
+}
+
+static size_t skipBlanksSse2(const char *line, size_t len, size_t from)
+{
+    while (from + 16 <= len)
+    {
+        unsigned mask = ~blankMask16(_mm_loadu_si128((const __m128i *)(line + from))) & 0xFFFF;
+        if (mask != 0)
+        {
+            return from + __builtin_ctz(mask);
+        }
+        from += 16;
+    }
+    return skipBlanksScalar(line, len, from);
+}
+
+__attribute__((target("avx2"))) static inline uint32_t specialMask32(__m256i chunk)
+{
+    __m256i hits = _mm256_or_si256(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(' ')), _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\t')));
+    hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\'')));
+    hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('"')));
+    hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\\')));
+    hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('&')));
+    hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('|')));
+    hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(';')));
+    hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('<')));
+    hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('>')));
+    return (uint32_t)_mm256_movemask_epi8(hits);
+}
+
+__attribute__((target("avx2"))) static size_t findSpecialAvx2(const char *line, size_t len, size_t from)
+{
+    while (from + 32 <= len)
+    {
+        uint32_t mask = specialMask32(_mm256_loadu_si256((const __m256i *)(line + from)));
+        if (mask != 0)
+        {
+            return from + __builtin_ctz(mask);
+        }
+        from += 32;
+    }
+    _mm256_zeroupper(); // Avoid the AVX to SSE transition penalty in the tail
+    return findSpecialSse2(line, len, from);
+}
+
+__attribute__((target("avx2"))) static size_t skipBlanksAvx2(const char *line, size_t len, size_t from)
+{
+    while (from + 32 <= len)
+    {
+        __m256i chunk = _mm256_loadu_si256((const __m256i *)(line + from));
+        __m256i hits = _mm256_or_si256(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(' ')), _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\t')));
+        uint32_t mask = ~(uint32_t)_mm256_movemask_epi8(hits);
+        if (mask != 0)
+        {
+            return from + __builtin_ctz(mask);
+        }
+        from += 32;
+    }
+    _mm256_zeroupper();
+    return skipBlanksSse2(line, len, from);
+}
+#endif
+
+static const lexScanners scalarScanners = {LEX_SCALAR, findSpecialScalar, skipBlanksScalar};
+#ifdef LEX_HAVE_X86_SIMD
+static const lexScanners sse2Scanners = {LEX_SSE2, findSpecialSse2, skipBlanksSse2};
+static const lexScanners avx2Scanners = {LEX_AVX2, findSpecialAvx2, skipBlanksAvx2};
+#endif
+
+/**
+ * @brief the scanners in use, chosen on first use by lex_select(LEX_AUTO).
+ */
+static const lexScanners *activeScanners = NULL;
+
+lexImpl lex_select(lexImpl impl)
+{
+    activeScanners = &scalarScanners;
+#ifdef LEX_HAVE_X86_SIMD
+    __builtin_cpu_init();
+    bool haveSse2 = __builtin_cpu_supports("sse2");
+    bool haveAvx2 = __builtin_cpu_supports("avx2");
+    if ((impl == LEX_AUTO || impl == LEX_AVX2) && haveAvx2)
+    {
+        activeScanners = &avx2Scanners;
+    }
+    else if (impl != LEX_SCALAR && haveSse2)
+    {
+        activeScanners = &sse2Scanners;
+    }
+#else
+    (void)impl;
+#endif
+    return activeScanners->impl;
+}
+
+const char *lex_impl_name(lexImpl impl)
+{
+    switch (impl)
+    {
+    case LEX_SCALAR:
+        return "scalar";
+    case LEX_SSE2:
+        return "sse2";
+    case LEX_AVX2:
+        return "avx2";
+    default:
+        return "auto";
+    }
+}
+
+size_t lex_find_special(const char *line, size_t len, size_t from)
+{
+    if (len - from < 16)
+    {   // Too short for a vector, skip the indirect call
+        return findSpecialScalar(line, len, from);
+    }
+    if (activeScanners == NULL)
+    {
+        lex_select(LEX_AUTO);
+    }
+    return activeScanners->findSpecial(line, len, from);
+}
+
+size_t lex_skip_blanks(const char *line, size_t len, size_t from)
+{
+    if (len - from < 16 || !lex_is_blank(line[from]))
+    {   // Nothing worth vectorizing, usually a single separating space
+        return skipBlanksScalar(line, len, from);
+    }
+    if (activeScanners == NULL)
+    {
+        lex_select(LEX_AUTO);
+    }
+    return activeScanners->skipBlanks(line, len, from);
+}
@@ -0,0 +1,79 @@
+#ifndef LEXSCAN_H
+#define LEXSCAN_H
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /**
+     * @brief the implementations of the lexer's byte scanners. LEX_AUTO picks
+     * the fastest one the CPU supports at runtime.
+     */
+    typedef enum lexImpl {
+        LEX_AUTO,
+        LEX_SCALAR,
+        LEX_SSE2,
+        LEX_AVX2,
+    } lexImpl;
+
+    /**
+     * @brief returns true if c separates tokens.
+     */
+    static inline bool lex_is_blank(char c)
+    {
+        return c == ' ' || c == '\t';
+    }
+
+    /**
+     * @brief returns true if c starts a shell operator (&, |, ;, < or >).
+     */
+    static inline bool lex_is_operator(char c)
+    {
+        return c == '&' || c == '|' || c == ';' || c == '<' || c == '>';
+    }
+
+    /**
+     * @brief returns the index of the first byte at or after from that is a
+     * blank, a quote, a backslash or starts an operator, or len if there is
+     * none. This is what ends (or changes the meaning of) an unquoted word.
+     *
+     * @param line the line to scan
+     * @param len the length of the line
+     * @param from the index to start scanning at
+     */
+    size_t lex_find_special(const char *line, size_t len, size_t from);
+
+    /**
+     * @brief returns the index of the first byte at or after from that is not
+     * a blank, or len if the rest of the line is blank.
+     *
+     * @param line the line to scan
+     * @param len the length of the line
+     * @param from the index to start scanning at
+     */
+    size_t lex_skip_blanks(const char *line, size_t len, size_t from);
+
+    /**
+     * @brief chooses the scanner implementation used by lex_find_special and
+     * lex_skip_blanks. Asking for an implementation the CPU or the build does
+     * not support falls back to the best one that is available. Building with
+     * -DLEX_NO_SIMD compiles only the scalar scanners.
+     *
+     * @param impl the implementation to use
+     * @return the implementation actually selected
+     */
+    lexImpl lex_select(lexImpl impl);
+
+    /**
+     * @brief returns a printable name for a scanner implementation.
+     */
+    const char *lex_impl_name(lexImpl impl);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif
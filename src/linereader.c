@@ -0,0 +1,167 @@
+#include "linereader.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+int linereader_open_fd(lineReader *reader, int fd)
+{
+    reader->fd = fd;
+    reader->closeFd = false;
+    reader->eof = false;
+    reader->start = 0;
+    reader->end = 0;
+    reader->capacity = LINEREADER_BLOCK;
+    reader->data = malloc(reader->capacity + 1);
+    return reader->data == NULL ? -1 : 0;
+}
+
+int linereader_open_file(lineReader *reader, const char *path)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+    {
+        return -1;
+    }
+    if (linereader_open_fd(reader, fd) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+    reader->closeFd = true;
+    return 0;
+}
+
+int linereader_open_string(lineReader *reader, const char *text)
+{
+    size_t len = strlen(text);
+    reader->fd = -1;
+    reader->closeFd = false;
+    reader->eof = true;
+    reader->start = 0;
+    reader->end = len;
+    reader->capacity = len;
+    reader->data = malloc(len + 1);
+    if (reader->data == NULL)
+    {
+        return -1;
+    }
+    memcpy(reader->data, text, len);
+    return 0;
+}
+
+/**
+ * @brief moves the unread bytes to the front of the buffer, growing it if it
+ * is still full, then reads one more block. Sets eof at the end of the input
+ * or on a read error.
+ */
+static void fillBuffer(lineReader *reader)
+{
+    size_t pending = reader->end - reader->start;
+    if (reader->start > 0)
+    {
+        memmove(reader->data, reader->data + reader->start, pending);
+        reader->start = 0;
+        reader->end = pending;
+    }
+    if (reader->capacity - reader->end < LINEREADER_BLOCK)
+    {
+        // Only a line longer than the buffer gets here
+        size_t capacity = reader->capacity * 2;
+        char *data = realloc(reader->data, capacity + 1);
+        if (data == NULL)
+        {
+            perror("Error reading commands");
+            reader->eof = true;
+            return;
+        }
+        reader->data = data;
+        reader->capacity = capacity;
+    }
+
+    ssize_t bytes;
+    do
+    {
+        bytes = read(reader->fd, reader->data + reader->end, reader->capacity - reader->end);
+    } while (bytes == -1 && errno == EINTR);
+
+    if (bytes == -1)
+    {
+        perror("Error reading commands");
+    }
+    if (bytes <= 0)
+    {
+        reader->eof = true;
+        return;
+    }
+    reader->end += (size_t)bytes;
+}
+
+char *linereader_next(lineReader *reader)
+{
+    size_t searched = reader->start;
+    for (;;)
+    {
+        char *newline = memchr(reader->data + searched, '\n', reader->end - searched);
+        if (newline != NULL)
+        {
+            char *line = reader->data + reader->start;
+            *newline = '\0';
+            reader->start = newline - reader->data + 1;
+            return line;
+        }
+        if (reader->eof)
+        {
+            break;
+        }
+        // fillBuffer moves the pending bytes to the front, which we have already searched
+        searched = reader->end - reader->start;
+        fillBuffer(reader);
+    }
+
+    if (reader->start == reader->end)
+    {
+        return NULL;
+    }
+    // The last line has no newline. There is always room for the terminator.
+    char *line = reader->data + reader->start;
+    reader->data[reader->end] = '\0';
+    reader->start = reader->end;
+    return line;
+}
+
+bool linereader_has_line(const lineReader *reader)
+{
+    return memchr(reader->data + reader->start, '\n', reader->end - reader->start) != NULL ||
+           (reader->eof && reader->start < reader->end);
+}
+
+void linereader_unread(lineReader *reader)
+{
+    // A file the reader opened is close-on-exec, so no command can read it
+    if (reader->fd == -1 || reader->closeFd || reader->start == reader->end)
+    {
+        return;
+    }
+    off_t pending = (off_t)(reader->end - reader->start);
+    if (lseek(reader->fd, -pending, SEEK_CUR) != -1)
+    {
+        reader->start = 0;
+        reader->end = 0;
+        reader->eof = false;
+    }
+}
+
+void linereader_close(lineReader *reader)
+{
+    if (reader->closeFd)
+    {
+        close(reader->fd);
+    }
+    free(reader->data);
+    reader->data = NULL;
+    reader->fd = -1;
+}
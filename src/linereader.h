@@ -0,0 +1,84 @@
+#ifndef LINEREADER_H
+#define LINEREADER_H
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define LINEREADER_BLOCK 65536
+
+    /**
+     * @brief reads commands for a non-interactive shell. Input is read
+     * LINEREADER_BLOCK bytes at a time and split into lines in place, so
+     * each line costs a memchr instead of a readline call and a malloc.
+     */
+    typedef struct lineReader {
+        int fd;          // -1 when reading a string
+        bool closeFd;    // If the reader opened fd itself
+        bool eof;
+        char *data;
+        size_t start;    // First byte not yet returned
+        size_t end;      // One past the last byte read
+        size_t capacity;
+    } lineReader;
+
+    /**
+     * @brief gets a reader ready to read lines from an open file descriptor,
+     * which is left open by linereader_close.
+     *
+     * @return 0 on success, -1 if the buffer could not be allocated
+     */
+    int linereader_open_fd(lineReader *reader, int fd);
+
+    /**
+     * @brief opens a script file for reading.
+     *
+     * @return 0 on success, -1 with errno set if the file could not be opened
+     */
+    int linereader_open_file(lineReader *reader, const char *path);
+
+    /**
+     * @brief gets a reader ready to read the lines of a string, as given to
+     * the -c flag. The string is copied.
+     *
+     * @return 0 on success, -1 if the copy could not be allocated
+     */
+    int linereader_open_string(lineReader *reader, const char *text);
+
+    /**
+     * @brief returns the next line without its newline. The line lives in the
+     * reader's buffer and may be modified, but is only valid until the next
+     * call. A final line with no newline is still returned.
+     *
+     * @return the line, or NULL at the end of the input or on a read error
+     */
+    char *linereader_next(lineReader *reader);
+
+    /**
+     * @brief returns true if a whole line is buffered, so the next
+     * linereader_next will not wait for input.
+     */
+    bool linereader_has_line(const lineReader *reader);
+
+    /**
+     * @brief hands input that has been read but not returned back to a file
+     * descriptor the reader was given, so that a command started next can
+     * read it, as it would if the shell read one byte at a time. This only
+     * works when the file descriptor is seekable. A pipe keeps whatever the
+     * reader has buffered.
+     */
+    void linereader_unread(lineReader *reader);
+
+    /**
+     * @brief frees the reader's buffer, and closes its file if it opened one.
+     */
+    void linereader_close(lineReader *reader);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif
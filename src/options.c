@@ -0,0 +1,171 @@
+#include "options.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+shellOptions options = {
+    .launcher = LAB_DEFAULT_LAUNCHER,
+    .pipeSize = 0,
+    .relay = false,
+    .preallocate = 0,
+    .noatime = false,
+    .maxJobs = 0,
+    .timing = false,
+    .timeFormat = TIME_TEXT,
+    .notify = false,
+};
+
+/**
+ * @brief how an option's value is stored and parsed.
+ */
+typedef enum optionType {
+    OPTION_ENUM,
+    OPTION_BOOL,
+    OPTION_INT,   // A non-negative int
+} optionType;
+
+/**
+ * @brief describes one option. For OPTION_ENUM, the value is the index of
+ * the matching name in choices, which is NULL terminated. OPTION_BOOL values
+ * are bools and OPTION_INT values are ints.
+ */
+typedef struct optionInfo {
+    const char *name;
+    optionType type;
+    void *value;
+    const char *const *choices;
+} optionInfo;
+
+static const char *const launcherChoices[] = {"fork", "spawn", "zygote", NULL};
+static const char *const timeFormatChoices[] = {"text", "json", NULL};
+
+static const optionInfo optionTable[] = {
+    {"launcher", OPTION_ENUM, &options.launcher, launcherChoices},
+    {"pipesize", OPTION_INT, &options.pipeSize, NULL},
+    {"relay", OPTION_BOOL, &options.relay, NULL},
+    {"preallocate", OPTION_INT, &options.preallocate, NULL},
+    {"noatime", OPTION_BOOL, &options.noatime, NULL},
+    {"maxjobs", OPTION_INT, &options.maxJobs, NULL},
+    {"timing", OPTION_BOOL, &options.timing, NULL},
+    {"timeformat", OPTION_ENUM, &options.timeFormat, timeFormatChoices},
+    {"notify", OPTION_BOOL, &options.notify, NULL},
+};
+
+#define OPTION_COUNT (sizeof(optionTable) / sizeof(optionTable[0]))
+
+/**
+ * @brief returns the option whose name is the first nameLen bytes of name.
+ */
+static const optionInfo *findOption(const char *name, size_t nameLen)
+{
+    for (size_t idx = 0; idx < OPTION_COUNT; idx++)
+    {
+        if (strlen(optionTable[idx].name) == nameLen && strncmp(optionTable[idx].name, name, nameLen) == 0)
+        {
+            return &optionTable[idx];
+        }
+    }
+    return NULL;
+}
+
+int options_set(const char *assignment)
+{
+    const char *equals = strchr(assignment, '=');
+    size_t nameLen = equals == NULL ? strlen(assignment) : (size_t)(equals - assignment);
+    const optionInfo *option = findOption(assignment, nameLen);
+    if (option == NULL)
+    {
+        fprintf(stderr, "set: %.*s: invalid option name\n", (int)nameLen, assignment);
+        return -1;
+    }
+
+    const char *value = equals == NULL ? "" : equals + 1;
+    switch (option->type)
+    {
+    case OPTION_ENUM:
+        for (int idx = 0; option->choices[idx] != NULL; idx++)
+        {
+            if (strcmp(option->choices[idx], value) == 0)
+            {
+                *(int *)option->value = idx;
+                return 0;
+            }
+        }
+        break;
+    case OPTION_BOOL:
+        if (equals == NULL || strcmp(value, "on") == 0)
+        {
+            *(bool *)option->value = true;
+            return 0;
+        }
+        if (strcmp(value, "off") == 0)
+        {
+            *(bool *)option->value = false;
+            return 0;
+        }
+        break;
+    case OPTION_INT:
+    {
+        char *end;
+        errno = 0;
+        long number = strtol(value, &end, 10);
+        if (*value != '\0' && *end == '\0' && errno == 0 && number >= 0 && number <= INT_MAX)
+        {
+            *(int *)option->value = (int)number;
+            return 0;
+        }
+        break;
+    }
+    }
+
+    fprintf(stderr, "set: %s: invalid value for %s\n", value, option->name);
+    return -1;
+}
+
+void options_print(void)
+{
+    for (size_t idx = 0; idx < OPTION_COUNT; idx++)
+    {
+        const optionInfo *option = &optionTable[idx];
+        switch (option->type)
+        {
+        case OPTION_ENUM:
+            printf("%-15s %s\n", option->name, option->choices[*(int *)option->value]);
+            break;
+        case OPTION_BOOL:
+            printf("%-15s %s\n", option->name, *(bool *)option->value ? "on" : "off");
+            break;
+        case OPTION_INT:
+            printf("%-15s %d\n", option->name, *(int *)option->value);
+            break;
+        }
+    }
+}
+
+int options_builtin(char **argv)
+{
+    if (argv[1] == NULL || (strcmp(argv[1], "-o") == 0 && argv[2] == NULL))
+    {
+        options_print();
+        return 0;
+    }
+
+    int result = 0;
+    for (int idx = 1; argv[idx] != NULL; idx++)
+    {
+        if (strcmp(argv[idx], "-o") != 0 || argv[idx + 1] == NULL)
+        {
+            fprintf(stderr, "set: usage: set [-o name[=value]]...\n");
+            return 1;
+        }
+        idx++;
+        if (options_set(argv[idx]) != 0)
+        {
+            result = 1;
+        }
+    }
+    return result;
+}
@@ -0,0 +1,76 @@
+#ifndef OPTIONS_H
+#define OPTIONS_H
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /**
+     * @brief how external commands are started.
+     */
+    typedef enum launchMethod {
+        LAUNCH_FORK,   // fork, then set up the child and execv
+        LAUNCH_SPAWN,  // posix_spawn, which uses a CLONE_VM|CLONE_VFORK child
+        LAUNCH_ZYGOTE, // A helper forked at startup clones the child for the shell
+    } launchMethod;
+
+    /**
+     * @brief how the time keyword prints what it measured.
+     */
+    typedef enum timeFormat {
+        TIME_TEXT,  // One labeled line per measurement, for people
+        TIME_JSON,  // A single JSON object on one line, for tools
+    } timeFormat;
+
+#ifndef LAB_DEFAULT_LAUNCHER
+#define LAB_DEFAULT_LAUNCHER LAUNCH_SPAWN
+#endif
+
+    /**
+     * @brief the shell's tunable settings, changed with "set -o name=value"
+     * or the -o command line flag.
+     */
+    typedef struct shellOptions {
+        launchMethod launcher;
+        int pipeSize;  // Bytes to grow the pipes between pipeline stages to, 0 to leave them alone
+        bool relay;    // Put a process that splices between every pair of pipeline stages
+        int preallocate;  // Bytes to reserve past the end of files opened by > and >>
+        bool noatime;     // Open redirected files with O_NOATIME
+        int maxJobs;      // Background jobs allowed to run at once, 0 for no limit
+        bool timing;      // Print the time and resources each foreground command used
+        timeFormat timeFormat;
+        bool notify;      // Report background jobs as soon as they finish, even at the prompt
+    } shellOptions;
+
+    extern shellOptions options;
+
+    /**
+     * @brief sets one option from a "name=value" string. Boolean options may
+     * be given as just "name", which turns them on.
+     *
+     * @param assignment the option and its new value
+     * @return 0 on success, -1 if the option or value is not valid
+     */
+    int options_set(const char *assignment);
+
+    /**
+     * @brief prints every option and its current value.
+     */
+    void options_print(void);
+
+    /**
+     * @brief the set builtin. "set -o" prints the options and
+     * "set -o name=value" changes one.
+     *
+     * @param argv the command, starting with "set"
+     * @return 0 on success, 1 if any option could not be set
+     */
+    int options_builtin(char **argv);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif
@@ -0,0 +1,103 @@
+#include "outbuf.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+void outbuf_init(outBuffer *out, int fd)
+{
+    fflush(stdout);
+    fflush(stderr);
+    out->fd = fd;
+    out->used = 0;
+    out->error = 0;
+}
+
+/**
+ * @brief writes len bytes to the buffer's file descriptor, retrying after
+ * short writes and interruptions.
+ */
+static void writeAll(outBuffer *out, const char *data, size_t len)
+{
+    while (len > 0 && !out->error)
+    {
+        ssize_t written = write(out->fd, data, len);
+        if (written == -1)
+        {
+            if (errno != EINTR)
+                out->error = errno;
+            continue;
+        }
+        data += written;
+        len -= (size_t)written;
+    }
+}
+
+int outbuf_flush(outBuffer *out)
+{
+    writeAll(out, out->data, out->used);
+    out->used = 0;
+    return out->error ? -1 : 0;
+}
+
+void outbuf_write(outBuffer *out, const char *data, size_t len)
+{
+    if (len > OUTBUF_SIZE - out->used)
+    {
+        outbuf_flush(out);
+        if (len >= OUTBUF_SIZE)
+        {   // Too big to be worth copying
+            writeAll(out, data, len);
+            return;
+        }
+    }
+    memcpy(out->data + out->used, data, len);
+    out->used += len;
+}
+
+void outbuf_puts(outBuffer *out, const char *str)
+{
+    outbuf_write(out, str, strlen(str));
+}
+
+void outbuf_printf(outBuffer *out, const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(out->data + out->used, OUTBUF_SIZE - out->used, format, args);
+    va_end(args);
+    if (len < 0)
+    {
+        return;
+    }
+
+    if ((size_t)len >= OUTBUF_SIZE - out->used)
+    {   // Didn't fit, flush and format again
+        outbuf_flush(out);
+        va_start(args, format);
+        len = vsnprintf(out->data, OUTBUF_SIZE, format, args);
+        va_end(args);
+        if (len < 0)
+        {
+            return;
+        }
+        if ((size_t)len >= OUTBUF_SIZE)
+        {   // Bigger than the whole buffer, so format it on the heap and write it straight out
+            char *large = malloc((size_t)len + 1);
+            if (large == NULL)
+            {
+                out->error = ENOMEM;
+                return;
+            }
+            va_start(args, format);
+            vsnprintf(large, (size_t)len + 1, format, args);
+            va_end(args);
+            writeAll(out, large, (size_t)len);
+            free(large);
+            return;
+        }
+    }
+    out->used += (size_t)len;
+}
@@ -0,0 +1,58 @@
+#ifndef OUTBUF_H
+#define OUTBUF_H
+#include <stdarg.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define OUTBUF_SIZE 65536
+
+    /**
+     * @brief a fixed size output buffer written straight to a file descriptor
+     * with write(2), so builtins that print a lot make one system call per
+     * OUTBUF_SIZE bytes instead of one per line.
+     */
+    typedef struct outBuffer {
+        int fd;
+        size_t used;
+        int error;
+        char data[OUTBUF_SIZE];
+    } outBuffer;
+
+    /**
+     * @brief gets an output buffer ready to write to fd. Anything still
+     * buffered by stdio is flushed first so the output stays in order.
+     */
+    void outbuf_init(outBuffer *out, int fd);
+
+    /**
+     * @brief buffers len bytes, writing the buffer out whenever it fills up.
+     */
+    void outbuf_write(outBuffer *out, const char *data, size_t len);
+
+    /**
+     * @brief buffers a string.
+     */
+    void outbuf_puts(outBuffer *out, const char *str);
+
+    /**
+     * @brief buffers printf style formatted output. Output longer than the
+     * buffer is formatted on the heap and written out whole.
+     */
+    void outbuf_printf(outBuffer *out, const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+    /**
+     * @brief writes out whatever is buffered.
+     *
+     * @return 0 on success, or -1 if any write since outbuf_init failed
+     */
+    int outbuf_flush(outBuffer *out);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif
@@ -0,0 +1,357 @@
+#include "parallel.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "jobs.h"
+#include "launch.h"
+#include "linereader.h"
+#include "options.h"
+#include "pathcache.h"
+#include "reaper.h"
+
+#define PARALLEL_MAX_STATUS 101
+#define PARALLEL_USAGE_STATUS 255
+#define PARALLEL_USAGE "parallel: usage: parallel [-j slots] [-a file] command [arg...] [::: input...]\n"
+
+/**
+ * @brief where the inputs come from: the words after ":::", or the lines
+ * of a reader.
+ */
+typedef struct parallelInputs {
+    char **words;
+    bool useReader;
+    lineReader reader;
+} parallelInputs;
+
+/**
+ * @brief returns the next input, or NULL when there are no more. A line is
+ * only valid until the next call.
+ */
+static char *nextInput(parallelInputs *in)
+{
+    if (in->useReader)
+    {
+        return linereader_next(&in->reader);
+    }
+    return *in->words == NULL ? NULL : *in->words++;
+}
+
+/**
+ * @brief returns the number of times "{}" appears in word.
+ */
+static size_t countPlaceholders(const char *word)
+{
+    size_t count = 0;
+    while ((word = strstr(word, "{}")) != NULL)
+    {
+        count++;
+        word += 2;
+    }
+    return count;
+}
+
+/**
+ * @brief builds the argv for one input, in a single allocation the caller
+ * frees. Every "{}" is replaced by the input, or the input is added as the
+ * last argument if appendInput is true.
+ */
+static char **expandTemplate(char **template, const char *input, bool appendInput)
+{
+    size_t inputLen = strlen(input);
+    size_t wordCount = 0;
+    size_t textSize = appendInput ? inputLen + 1 : 0;
+    for (; template[wordCount] != NULL; wordCount++)
+    {
+        textSize += strlen(template[wordCount]) + 1 + countPlaceholders(template[wordCount]) * inputLen;
+    }
+
+    size_t argc = wordCount + (appendInput ? 1 : 0);
+    char **argv = malloc(sizeof(char *) * (argc + 1) + textSize);
+    if (argv == NULL)
+    {
+        return NULL;
+    }
+    char *text = (char *)(argv + argc + 1);
+    for (size_t idx = 0; idx < wordCount; idx++)
+    {
+        argv[idx] = text;
+        const char *word = template[idx];
+        const char *placeholder;
+        while ((placeholder = strstr(word, "{}")) != NULL)
+        {
+            memcpy(text, word, placeholder - word);
+            text += placeholder - word;
+            memcpy(text, input, inputLen);
+            text += inputLen;
+            word = placeholder + 2;
+        }
+        size_t rest = strlen(word) + 1;
+        memcpy(text, word, rest);
+        text += rest;
+    }
+    if (appendInput)
+    {
+        argv[wordCount] = text;
+        memcpy(text, input, inputLen + 1);
+    }
+    argv[argc] = NULL;
+    return argv;
+}
+
+/**
+ * @brief joins a command's words with spaces, for the job table.
+ */
+static char *joinWords(char **argv)
+{
+    size_t len = 0;
+    for (size_t idx = 0; argv[idx] != NULL; idx++)
+    {
+        len += strlen(argv[idx]) + 1;
+    }
+    char *line = malloc(len + 1);
+    if (line == NULL)
+    {
+        return NULL;
+    }
+    char *end = line;
+    for (size_t idx = 0; argv[idx] != NULL; idx++)
+    {
+        end = stpcpy(end, argv[idx]);
+        *end++ = ' ';
+    }
+    end[-1] = '\0'; // There is always at least one word
+    return line;
+}
+
+/**
+ * @brief what happened when parallel tried to start a command.
+ */
+typedef enum startResult {
+    START_FAILED = -1,   // It could not be started, or failed
+    START_DONE = 0,      // It already ran successfully
+    START_RUNNING = 1,   // It is running, and is in the job table
+} startResult;
+
+/**
+ * @brief starts the command for one input and adds it to the job table. If
+ * the job table is out of memory the command is waited for instead.
+ */
+static startResult startInput(struct shell *sh, char **template, const char *templatePath, bool appendInput, const char *input, int inFd)
+{
+    char **argv = expandTemplate(template, input, appendInput);
+    char *line = argv == NULL ? NULL : joinWords(argv);
+    if (line == NULL)
+    {
+        perror("parallel");
+        free(argv);
+        return START_FAILED;
+    }
+
+    startResult result = START_FAILED;
+    command cmd = {argv, templatePath, NULL, 0};
+    if (cmd.path == NULL)
+    {   // The program name itself has a placeholder
+        cmd.path = pathcache_lookup(argv[0]);
+    }
+    if (cmd.path == NULL)
+    {
+        fprintf(stderr, "%s: command not found\n", argv[0]);
+    }
+    else
+    {
+        pid_t pid = launch_command(options.launcher, sh, &cmd, inFd);
+        if (pid == -1)
+        {
+            perror("parallel");
+        }
+        else if (jobs_add(&jobs, pid, line) != NULL)
+        {
+            result = START_RUNNING;
+        }
+        else
+        {
+            perror("parallel");
+            int status;
+            reaper_wait(pid, &status);
+            result = WIFEXITED(status) && WEXITSTATUS(status) == 0 ? START_DONE : START_FAILED;
+        }
+    }
+    free(line);
+    free(argv);
+    return result;
+}
+
+/**
+ * @brief true for the pids of jobs numbered firstJob or higher, which are the
+ * ones this run of parallel started.
+ */
+static bool isParallelJob(pid_t pid, void *firstJob)
+{
+    jobEntry *entry = jobs_find_pid(&jobs, pid);
+    return entry != NULL && entry->info.jobNum >= *(int *)firstJob;
+}
+
+/**
+ * @brief parses the options, leaving argv at the command.
+ *
+ * @return true if they were valid
+ */
+static bool parseOptions(char ***argv, size_t *slots, const char **file)
+{
+    char **arg = *argv + 1;
+    while (*arg != NULL && (*arg)[0] == '-')
+    {
+        const char *value = NULL;
+        char option = (*arg)[1];
+        if (strcmp(*arg, "--") == 0)
+        {
+            arg++;
+            break;
+        }
+        if ((option == 'j' || option == 'a') && (*arg)[2] != '\0')
+        {
+            value = *arg + 2;
+        }
+        else if ((option == 'j' || option == 'a') && (*arg)[2] == '\0' && arg[1] != NULL)
+        {
+            value = *++arg;
+        }
+        else
+        {
+            return false;
+        }
+
+        if (option == 'a')
+        {
+            *file = value;
+        }
+        else
+        {
+            char *end;
+            unsigned long count = strtoul(value, &end, 10);
+            if (*end != '\0' || count == 0)
+            {
+                return false;
+            }
+            *slots = count;
+        }
+        arg++;
+    }
+    *argv = arg;
+    return *arg != NULL;
+}
+
+int parallel_builtin(struct shell *sh, char **argv)
+{
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t slots = cpus > 0 ? (size_t)cpus : 1;
+    const char *file = NULL;
+    char **template = argv;
+    if (!parseOptions(&template, &slots, &file))
+    {
+        fprintf(stderr, PARALLEL_USAGE);
+        return PARALLEL_USAGE_STATUS;
+    }
+
+    parallelInputs inputs = {NULL, false, {0}};
+    bool appendInput = true;
+    for (char **word = template; *word != NULL; word++)
+    {
+        if (strcmp(*word, ":::") == 0)
+        {
+            *word = NULL; // The template ends here
+            inputs.words = word + 1;
+            break;
+        }
+        if (strstr(*word, "{}") != NULL)
+        {
+            appendInput = false;
+        }
+    }
+    if (template[0] == NULL)
+    {
+        fprintf(stderr, PARALLEL_USAGE);
+        return PARALLEL_USAGE_STATUS;
+    }
+    if (inputs.words == NULL)
+    {
+        inputs.useReader = true;
+        int opened = file == NULL ? linereader_open_fd(&inputs.reader, STDIN_FILENO) : linereader_open_file(&inputs.reader, file);
+        if (opened != 0)
+        {
+            perror(file == NULL ? "parallel" : file);
+            return PARALLEL_USAGE_STATUS;
+        }
+    }
+
+    // Look the program up once, unless the input is part of its name
+    const char *templatePath = NULL;
+    if (strstr(template[0], "{}") == NULL && (templatePath = pathcache_lookup(template[0])) == NULL)
+    {
+        fprintf(stderr, "%s: command not found\n", template[0]);
+        if (inputs.useReader)
+            linereader_close(&inputs.reader);
+        return PARALLEL_USAGE_STATUS;
+    }
+
+    int nullFd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    int firstJob = jobs.tail == NULL ? 1 : jobs.tail->info.jobNum + 1;
+    size_t running = 0;
+    size_t total = 0;
+    size_t failed = 0;
+    bool interrupted = false;
+    fflush(stdout);
+
+    // Each free slot takes the next input, so slots that finish early run more of them
+    while (true)
+    {
+        char *input;
+        while (!interrupted && running < slots && (input = nextInput(&inputs)) != NULL)
+        {
+            total++;
+            startResult result = startInput(sh, template, templatePath, appendInput, input, nullFd == -1 ? STDIN_FILENO : nullFd);
+            if (result == START_RUNNING)
+                running++;
+            else if (result == START_FAILED)
+                failed++;
+        }
+        if (running == 0)
+        {
+            break;
+        }
+
+        childExit exited;
+        reaper_wait_matching(isParallelJob, &firstJob, &exited);
+        running--;
+        jobs_remove(&jobs, jobs_find_pid(&jobs, exited.pid));
+        if (!WIFEXITED(exited.status) || WEXITSTATUS(exited.status) != 0)
+        {
+            failed++;
+        }
+        if (WIFSIGNALED(exited.status) && WTERMSIG(exited.status) == SIGINT)
+        {
+            interrupted = true;
+        }
+    }
+
+    if (inputs.useReader)
+    {
+        linereader_close(&inputs.reader);
+    }
+    if (nullFd != -1)
+    {
+        close(nullFd);
+    }
+    if (failed > 0)
+    {
+        fprintf(stderr, "parallel: %zu of %zu commands failed\n", failed, total);
+    }
+    return failed > PARALLEL_MAX_STATUS ? PARALLEL_MAX_STATUS : (int)failed;
+}
@@ -0,0 +1,34 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+#include "lab.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /**
+     * @brief the parallel builtin:
+     *
+     *   parallel [-j slots] [-a file] command [arg...] [::: input...]
+     *
+     * runs command once per input, with at most slots copies running at a
+     * time (the number of CPUs by default). Every "{}" in the command is
+     * replaced by the input, or the input is added as the last argument if
+     * there is no "{}". The inputs are the words after ":::", the lines of
+     * file, or else the lines of stdin. Each command's stdin is /dev/null, and
+     * while it runs it is in the job table. An interrupted command stops the
+     * remaining inputs from being started.
+     *
+     * @param sh the shell
+     * @param argv the command, starting with "parallel"
+     * @return 0 if every command succeeded, otherwise the number that failed,
+     * up to 101, or 255 if the arguments were not valid
+     */
+    int parallel_builtin(struct shell *sh, char **argv);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif
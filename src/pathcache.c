@@ -0,0 +1,249 @@
+#include "pathcache.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define PATHCACHE_MIN_SLOTS 64
+
+/**
+ * @brief one remembered command. An empty slot has a NULL name.
+ */
+typedef struct pathEntry {
+    char *name;
+    char *path;
+    unsigned hits;
+    uint32_t hash;
+} pathEntry;
+
+/**
+ * @brief an open addressing hash table from command name to program path,
+ * along with the $PATH it was filled from.
+ */
+static struct {
+    pathEntry *slots;
+    size_t capacity;
+    size_t count;
+    char *path;
+} cache = {NULL, 0, 0, NULL};
+
+/**
+ * @brief the 32 bit FNV-1a hash of a string.
+ */
+static uint32_t hashName(const char *name)
+{
+    uint32_t hash = 2166136261u;
+    for (const unsigned char *c = (const unsigned char *)name; *c != '\0'; c++)
+    {
+        hash = (hash ^ *c) * 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * @brief returns the slot holding name, or the empty slot where it belongs.
+ * The table must have at least one empty slot.
+ */
+static pathEntry *findSlot(pathEntry *slots, size_t capacity, const char *name, uint32_t hash)
+{
+    size_t idx = hash & (capacity - 1);
+    while (slots[idx].name != NULL && (slots[idx].hash != hash || strcmp(slots[idx].name, name) != 0))
+    {
+        idx = (idx + 1) & (capacity - 1);
+    }
+    return &slots[idx];
+}
+
+/**
+ * @brief doubles the table once it is half full.
+ *
+ * @return true if there is room for another entry, false if out of memory.
+ */
+static bool reserveEntry(void)
+{
+    if ((cache.count + 1) * 2 <= cache.capacity)
+    {
+        return true;
+    }
+
+    size_t capacity = cache.capacity == 0 ? PATHCACHE_MIN_SLOTS : cache.capacity * 2;
+    pathEntry *slots = calloc(capacity, sizeof(pathEntry));
+    if (slots == NULL)
+    {
+        return false;
+    }
+    for (size_t idx = 0; idx < cache.capacity; idx++)
+    {
+        if (cache.slots[idx].name != NULL)
+        {
+            *findSlot(slots, capacity, cache.slots[idx].name, cache.slots[idx].hash) = cache.slots[idx];
+        }
+    }
+    free(cache.slots);
+    cache.slots = slots;
+    cache.capacity = capacity;
+    return true;
+}
+
+/**
+ * @brief walks $PATH looking for an executable regular file called name.
+ *
+ * @return the full path, which the caller must free, or NULL if not found.
+ */
+static char *searchPath(const char *dirs, const char *name)
+{
+    size_t nameLen = strlen(name);
+    const char *dir = dirs;
+    while (dir != NULL)
+    {
+        const char *end = strchr(dir, ':');
+        size_t dirLen = end == NULL ? strlen(dir) : (size_t)(end - dir);
+
+        // An empty entry means the current directory
+        char *candidate = malloc(dirLen + nameLen + 3);
+        if (candidate == NULL)
+        {
+            return NULL;
+        }
+        if (dirLen == 0)
+        {
+            candidate[0] = '.';
+            dirLen = 1;
+        }
+        else
+        {
+            memcpy(candidate, dir, dirLen);
+        }
+        candidate[dirLen] = '/';
+        memcpy(candidate + dirLen + 1, name, nameLen + 1);
+
+        struct stat info;
+        if (stat(candidate, &info) == 0 && S_ISREG(info.st_mode) && access(candidate, X_OK) == 0)
+        {
+            return candidate;
+        }
+        free(candidate);
+
+        dir = end == NULL ? NULL : end + 1;
+    }
+    return NULL;
+}
+
+void pathcache_clear(void)
+{
+    for (size_t idx = 0; idx < cache.capacity; idx++)
+    {
+        free(cache.slots[idx].name);
+        free(cache.slots[idx].path);
+    }
+    free(cache.slots);
+    free(cache.path);
+    cache.slots = NULL;
+    cache.capacity = 0;
+    cache.count = 0;
+    cache.path = NULL;
+}
+
+const char *pathcache_lookup(const char *name)
+{
+    if (strchr(name, '/') != NULL)
+    {
+        return name;
+    }
+
+    // execvp's default search path when $PATH is unset
+    const char *currentPath = getenv("PATH");
+    if (currentPath == NULL)
+    {
+        currentPath = "/bin:/usr/bin";
+    }
+    if (cache.path != NULL && strcmp(cache.path, currentPath) != 0)
+    {
+        pathcache_clear();
+    }
+
+    uint32_t hash = hashName(name);
+    if (cache.count > 0)
+    {
+        pathEntry *entry = findSlot(cache.slots, cache.capacity, name, hash);
+        if (entry->name != NULL)
+        {
+            entry->hits++;
+            return entry->path;
+        }
+    }
+
+    char *found = searchPath(currentPath, name);
+    if (found == NULL)
+    {
+        errno = ENOENT;
+        return NULL;
+    }
+
+    if (cache.path == NULL)
+    {
+        cache.path = strdup(currentPath);
+    }
+    char *nameCopy = strdup(name);
+    if (cache.path == NULL || nameCopy == NULL || !reserveEntry())
+    {
+        free(nameCopy);
+        free(found);
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    pathEntry *entry = findSlot(cache.slots, cache.capacity, name, hash);
+    entry->name = nameCopy;
+    entry->path = found;
+    entry->hits = 1;
+    entry->hash = hash;
+    cache.count++;
+    return found;
+}
+
+void pathcache_print(void)
+{
+    if (cache.count == 0)
+    {
+        printf("hash: hash table empty\n");
+        return;
+    }
+
+    printf("hits\tcommand\n");
+    for (size_t idx = 0; idx < cache.capacity; idx++)
+    {
+        if (cache.slots[idx].name != NULL)
+        {
+            printf("%4u\t%s\n", cache.slots[idx].hits, cache.slots[idx].path);
+        }
+    }
+}
+
+int pathcache_builtin(char **argv)
+{
+    if (argv[1] == NULL)
+    {
+        pathcache_print();
+        return 0;
+    }
+
+    int result = 0;
+    for (int idx = 1; argv[idx] != NULL; idx++)
+    {
+        if (strcmp(argv[idx], "-r") == 0)
+        {
+            pathcache_clear();
+        }
+        else if (pathcache_lookup(argv[idx]) == NULL)
+        {
+            fprintf(stderr, "hash: %s: not found\n", argv[idx]);
+            result = 1;
+        }
+    }
+    return result;
+}
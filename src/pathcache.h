@@ -0,0 +1,46 @@
+#ifndef PATHCACHE_H
+#define PATHCACHE_H
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /**
+     * @brief finds the absolute path of the program a command name refers to,
+     * the way execvp would, and remembers it so later lookups of the same name
+     * do not walk $PATH again. Names containing a '/' are returned unchanged
+     * and are not cached. The whole cache is dropped whenever $PATH changes.
+     *
+     * @param name the command name, e.g. "ls"
+     * @return the path to exec, owned by the cache and valid until the cache is
+     * next cleared, or NULL with errno set to ENOENT if there is no such program
+     */
+    const char *pathcache_lookup(const char *name);
+
+    /**
+     * @brief forgets every remembered command location, like "hash -r".
+     */
+    void pathcache_clear(void);
+
+    /**
+     * @brief prints every remembered command with its hit count and path, in
+     * the same format as bash's hash builtin.
+     */
+    void pathcache_print(void);
+
+    /**
+     * @brief the hash builtin. With no arguments it prints the cache, "-r"
+     * clears it, and any names given are looked up and remembered.
+     *
+     * @param argv the command, starting with "hash"
+     * @return 0 on success, 1 if any name could not be found
+     */
+    int pathcache_builtin(char **argv);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif
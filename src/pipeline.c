@@ -0,0 +1,324 @@
+#include "pipeline.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief reports an operator the grammar does not allow where it was found.
+ */
+static int syntaxError(const tokenSpan *span)
+{
+    const char *near = span == NULL ? "newline" : token_operator_text(span->kind);
+    fprintf(stderr, "syntax error near unexpected token `%s'\n", near);
+    errno = EINVAL;
+    return -1;
+}
+
+static bool isRedirectOperator(tokenKind kind)
+{
+    return kind == TOKEN_LESS || kind == TOKEN_GREAT || kind == TOKEN_DGREAT ||
+           kind == TOKEN_LESSAND || kind == TOKEN_GREATAND;
+}
+
+/**
+ * @brief returns true if the span is an unquoted, non-empty run of at most
+ * nine digits.
+ */
+static bool isNumber(const tokenSpan *span, const char *text)
+{
+    if (span->kind != TOKEN_WORD || (span->flags & TOKEN_QUOTED) || span->length == 0 || span->length > 9)
+    {
+        return false;
+    }
+    for (uint32_t idx = 0; idx < span->length; idx++)
+    {
+        if (text[span->offset + idx] < '0' || text[span->offset + idx] > '9')
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief returns true if the span is the unquoted word keyword.
+ */
+static bool isKeyword(const tokenSpan *span, const char *text, const char *keyword)
+{
+    size_t len = strlen(keyword);
+    return span->kind == TOKEN_WORD && !(span->flags & TOKEN_QUOTED) && span->length == len &&
+           memcmp(text + span->offset, keyword, len) == 0;
+}
+
+/**
+ * @brief returns true if span idx is the descriptor number of the
+ * redirection right after it, like the 2 in "2>file".
+ */
+static bool isIoNumber(const tokenizer *t, const char *text, size_t idx, size_t end)
+{
+    if (idx + 1 >= end || !isRedirectOperator(t->spans[idx + 1].kind))
+    {
+        return false;
+    }
+    const tokenSpan *span = &t->spans[idx];
+    return span->offset + span->length == t->spans[idx + 1].offset && isNumber(span, text);
+}
+
+/**
+ * @brief fills in the redirection for the operator at span idx, whose target
+ * word is the span after it.
+ */
+static int parseRedirect(const tokenizer *t, char *text, size_t idx, int fd, redirection *out)
+{
+    tokenKind kind = t->spans[idx].kind;
+    const tokenSpan *targetSpan = &t->spans[idx + 1];
+    bool numericTarget = isNumber(targetSpan, text);
+    out->fd = fd >= 0 ? fd : (kind == TOKEN_LESS || kind == TOKEN_LESSAND ? 0 : 1);
+    out->source = -1;
+    out->target = token_materialize_word(targetSpan, text);
+
+    switch (kind)
+    {
+    case TOKEN_LESS:
+        out->kind = REDIRECT_INPUT;
+        break;
+    case TOKEN_GREAT:
+        out->kind = REDIRECT_OUTPUT;
+        break;
+    case TOKEN_DGREAT:
+        out->kind = REDIRECT_APPEND;
+        break;
+    default:
+        if (out->target[0] == '-' && out->target[1] == '\0')
+        {
+            out->kind = REDIRECT_CLOSE;
+        }
+        else if (numericTarget)
+        {
+            out->kind = REDIRECT_DUP;
+            out->source = atoi(out->target);
+        }
+        else
+        {
+            fprintf(stderr, "%s: ambiguous redirect\n", out->target);
+            errno = EINVAL;
+            return -1;
+        }
+        break;
+    }
+    return 0;
+}
+
+/**
+ * @brief builds the command made of spans first up to end, which contain no
+ * pipes.
+ */
+static int parseCommand(const tokenizer *t, char *text, arena *a, size_t first, size_t end, command *out)
+{
+    size_t wordCount = 0;
+    size_t redirectCount = 0;
+    for (size_t idx = first; idx < end; idx++)
+    {
+        if (isIoNumber(t, text, idx, end))
+        {
+            continue;
+        }
+        if (t->spans[idx].kind == TOKEN_WORD)
+        {
+            wordCount++;
+            continue;
+        }
+        // Only redirections get here, and each one needs a target
+        if (idx + 1 >= end || t->spans[idx + 1].kind != TOKEN_WORD)
+        {
+            return syntaxError(idx + 1 < t->count ? &t->spans[idx + 1] : NULL);
+        }
+        redirectCount++;
+        idx++;
+    }
+
+    out->argv = arena_alloc(a, sizeof(char *) * (wordCount + 1));
+    out->redirects = redirectCount == 0 ? NULL : arena_alloc(a, sizeof(redirection) * redirectCount);
+    if (out->argv == NULL || (redirectCount > 0 && out->redirects == NULL))
+    {
+        errno = ENOMEM;
+        return -1;
+    }
+    out->path = NULL;
+    out->redirectCount = redirectCount;
+
+    size_t word = 0;
+    size_t redirect = 0;
+    for (size_t idx = first; idx < end; idx++)
+    {
+        int fd = -1;
+        if (isIoNumber(t, text, idx, end))
+        {
+            fd = atoi(text + t->spans[idx].offset);
+            idx++;
+        }
+        else if (t->spans[idx].kind == TOKEN_WORD)
+        {
+            out->argv[word++] = token_materialize_word(&t->spans[idx], text);
+            continue;
+        }
+        if (parseRedirect(t, text, idx, fd, &out->redirects[redirect++]) != 0)
+        {
+            return -1;
+        }
+        idx++; // Skip the target
+    }
+    out->argv[word] = NULL;
+    return 0;
+}
+
+/**
+ * @brief builds the pipeline made of spans first up to end, which hold no
+ * list operators but a pipeline's own trailing &, which the caller has
+ * already taken off and passes as background.
+ */
+static int parsePipeline(const tokenizer *t, char *text, arena *a, size_t first, size_t end, bool background,
+                         pipeline *out)
+{
+    out->commands = NULL;
+    out->count = 0;
+    out->background = background;
+    out->timed = false;
+    out->next = LIST_THEN;
+    out->sourceStart = first < t->count ? t->spans[first].offset : 0;
+    out->sourceEnd = out->sourceStart;
+
+    // Like bash, "time" is only a keyword when a command follows it
+    size_t firstToken = first;
+    if (end - first > 1 && isKeyword(&t->spans[first], text, "time"))
+    {
+        out->timed = true;
+        firstToken = first + 1;
+    }
+
+    // Check the shape of the pipeline and count the commands before allocating
+    size_t commandCount = 1;
+    bool sawWord = false;
+    for (size_t idx = firstToken; idx < end; idx++)
+    {
+        const tokenSpan *span = &t->spans[idx];
+        if (span->kind == TOKEN_WORD || isRedirectOperator(span->kind))
+        {
+            sawWord = true;
+            continue;
+        }
+        if (span->kind != TOKEN_PIPE || !sawWord)
+        {
+            return syntaxError(span);
+        }
+        commandCount++;
+        sawWord = false;
+    }
+    if (!sawWord)
+    {
+        return syntaxError(end < t->count ? &t->spans[end] : NULL);
+    }
+    const tokenSpan *last = &t->spans[background ? end : end - 1];
+    out->sourceEnd = last->offset + last->length;
+
+    out->commands = arena_alloc(a, sizeof(command) * commandCount);
+    if (out->commands == NULL)
+    {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    size_t cmdFirst = firstToken;
+    for (size_t cmd = 0; cmd < commandCount; cmd++)
+    {
+        size_t cmdEnd = cmdFirst;
+        while (cmdEnd < end && t->spans[cmdEnd].kind != TOKEN_PIPE)
+        {
+            cmdEnd++;
+        }
+        if (parseCommand(t, text, a, cmdFirst, cmdEnd, &out->commands[cmd]) != 0)
+        {
+            return -1;
+        }
+        // Only a lone command may be nothing but redirections, like "> file"
+        if (out->commands[cmd].argv[0] == NULL && commandCount > 1)
+        {
+            return syntaxError(&t->spans[cmdEnd < end ? cmdEnd : cmdFirst]);
+        }
+        cmdFirst = cmdEnd + 1; // Skip the pipe
+    }
+    out->count = commandCount;
+    return 0;
+}
+
+int pipeline_parse(const tokenizer *t, char *text, arena *a, pipeline *out)
+{
+    if (t->count == 0)
+    {
+        memset(out, 0, sizeof(*out));
+        return 0;
+    }
+    bool background = t->spans[t->count - 1].kind == TOKEN_AMP;
+    return parsePipeline(t, text, a, 0, background ? t->count - 1 : t->count, background, out);
+}
+
+static bool isListOperator(tokenKind kind)
+{
+    return kind == TOKEN_SEMI || kind == TOKEN_AMP || kind == TOKEN_AND_IF || kind == TOKEN_OR_IF;
+}
+
+int list_parse(const tokenizer *t, char *text, arena *a, commandList *out)
+{
+    out->pipelines = NULL;
+    out->count = 0;
+    if (t->count == 0)
+    {
+        return 0;
+    }
+
+    // Every operator ends a pipeline, so there is at most one more pipeline than operators
+    size_t capacity = 1;
+    for (size_t idx = 0; idx < t->count; idx++)
+    {
+        capacity += isListOperator(t->spans[idx].kind);
+    }
+    out->pipelines = arena_alloc(a, sizeof(pipeline) * capacity);
+    if (out->pipelines == NULL)
+    {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    size_t first = 0;
+    for (size_t idx = 0; idx <= t->count; idx++)
+    {
+        if (idx < t->count && !isListOperator(t->spans[idx].kind))
+        {
+            continue;
+        }
+        tokenKind kind = idx < t->count ? t->spans[idx].kind : TOKEN_SEMI;
+        pipeline *current = &out->pipelines[out->count];
+        if (parsePipeline(t, text, a, first, idx, kind == TOKEN_AMP, current) != 0)
+        {
+            return -1;
+        }
+        // A job is a single pipeline, so an && or || list cannot be put in the background
+        if (kind == TOKEN_AMP && out->count > 0 && out->pipelines[out->count - 1].next != LIST_THEN)
+        {
+            fprintf(stderr, "cannot run an && or || list in the background\n");
+            errno = EINVAL;
+            return -1;
+        }
+        current->next = kind == TOKEN_AND_IF ? LIST_AND : kind == TOKEN_OR_IF ? LIST_OR : LIST_THEN;
+        out->count++;
+        first = idx + 1;
+        // A ; or & may end the line
+        if (first == t->count && (kind == TOKEN_SEMI || kind == TOKEN_AMP))
+        {
+            break;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,122 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "arena.h"
+#include "tokenizer.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /**
+     * @brief what a redirection does to its file descriptor.
+     */
+    typedef enum redirectionKind {
+        REDIRECT_INPUT,   // [n]<file
+        REDIRECT_OUTPUT,  // [n]>file
+        REDIRECT_APPEND,  // [n]>>file
+        REDIRECT_DUP,     // [n]>&m or [n]<&m
+        REDIRECT_CLOSE,   // [n]>&- or [n]<&-
+    } redirectionKind;
+
+    /**
+     * @brief one redirection of a command. They are applied in order, after
+     * the command's pipes are connected.
+     */
+    typedef struct redirection {
+        redirectionKind kind;
+        int fd;              // The descriptor the command sees
+        int source;          // The descriptor copied to fd. For files, -1 until redirect_open opens it.
+        const char *target;  // The file, for the file kinds
+    } redirection;
+
+    /**
+     * @brief one simple command of a pipeline.
+     */
+    typedef struct command {
+        char **argv;       // NULL terminated. Only empty for a single command of just redirections.
+        const char *path;  // The program to run, filled in by the caller
+        redirection *redirects;
+        size_t redirectCount;
+    } command;
+
+    /**
+     * @brief how a pipeline in a list decides whether the one after it runs.
+     * A pipeline that is skipped leaves the status alone, so in
+     * "false && a || b", b runs.
+     */
+    typedef enum listOperator {
+        LIST_THEN,  // ; or &, or the end of the line: the next one always runs
+        LIST_AND,   // &&: the next one runs if the status is 0
+        LIST_OR,    // ||: the next one runs if the status is not 0
+    } listOperator;
+
+    /**
+     * @brief commands joined by pipes, each one's stdout feeding the next
+     * one's stdin, optionally run in the background.
+     */
+    typedef struct pipeline {
+        command *commands;
+        size_t count;
+        bool background;
+        bool timed;  // The pipeline started with the time keyword
+        listOperator next;   // How it joins the pipeline after it in a list
+        size_t sourceStart;  // Where its text, with any time keyword and trailing &, starts in the line
+        size_t sourceEnd;    // One past where its text ends
+    } pipeline;
+
+    /**
+     * @brief pipelines separated by ;, &, && and ||, run left to right.
+     */
+    typedef struct commandList {
+        pipeline *pipelines;
+        size_t count;
+    } commandList;
+
+    /**
+     * @brief builds a pipeline from the spans from the last call to tokenize.
+     * A line with no tokens gives a pipeline of zero commands. A redirection
+     * operator may be preceded, with no blank in between, by the number of
+     * the descriptor it redirects, as in "2>&1". An unquoted "time" before
+     * the first command is the time keyword and sets timed. Words are
+     * materialized in place in text, and the command and argv arrays are
+     * allocated from the arena.
+     *
+     * @param t the tokenizer holding the spans
+     * @param text a writable copy of the tokenized line
+     * @param a the arena to allocate from
+     * @param out the pipeline to fill in
+     * @return 0 on success, or -1 with errno set to EINVAL on a syntax error,
+     * which has been printed, or ENOMEM if out of memory
+     */
+    int pipeline_parse(const tokenizer *t, char *text, arena *a, pipeline *out);
+
+    /**
+     * @brief builds a list of pipelines from the spans from the last call to
+     * tokenize, following
+     *
+     *   list := pipeline ((";" | "&" | "&&" | "||") pipeline)* [";" | "&"]
+     *
+     * where & puts the pipeline before it in the background, and && and ||
+     * bind as tightly as ;, left to right, as in POSIX. A pipeline ending in &
+     * must not follow && or ||, since the shell runs each job as a single
+     * pipeline. A line with no tokens gives a list of zero pipelines. Each
+     * pipeline is parsed as pipeline_parse does.
+     *
+     * @param t the tokenizer holding the spans
+     * @param text a writable copy of the tokenized line
+     * @param a the arena to allocate from
+     * @param out the list to fill in
+     * @return 0 on success, or -1 with errno set to EINVAL on a syntax error,
+     * which has been printed, or ENOMEM if out of memory
+     */
+    int list_parse(const tokenizer *t, char *text, arena *a, commandList *out);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif
@@ -0,0 +1,210 @@
+#include "reaper.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#define REAPER_RING_SIZE 1024 // Must be a power of two
+
+/**
+ * @brief a single producer, single consumer ring of child exits. The SIGCHLD
+ * handler produces, the shell's main loop consumes. The indexes only ever
+ * grow and are masked when used.
+ */
+static struct {
+    childExit entries[REAPER_RING_SIZE];
+    atomic_size_t head; // Next slot the handler writes
+    atomic_size_t tail; // Next slot the main loop reads
+    atomic_bool overflowed;
+} ring;
+
+/**
+ * @brief exits taken off the ring by reaper_wait while it looked for a
+ * different child. Only touched outside the signal handler.
+ */
+static struct {
+    childExit *entries;
+    size_t start;
+    size_t count;
+    size_t capacity;
+} pending = {NULL, 0, 0, 0};
+
+/**
+ * @brief reaps every child that has exited and records it, until there are
+ * no more or the ring is full. Async-signal-safe.
+ */
+static void reapAvailable(void)
+{
+    size_t head = atomic_load_explicit(&ring.head, memory_order_relaxed);
+    while (true)
+    {
+        size_t tail = atomic_load_explicit(&ring.tail, memory_order_acquire);
+        if (head - tail == REAPER_RING_SIZE)
+        {   // Leave the rest as zombies until the main loop catches up
+            atomic_store_explicit(&ring.overflowed, true, memory_order_relaxed);
+            return;
+        }
+
+        childExit *entry = &ring.entries[head & (REAPER_RING_SIZE - 1)];
+        int status;
+        pid_t pid = wait4(-1, &status, WNOHANG, &entry->usage);
+        if (pid <= 0)
+        {
+            return;
+        }
+
+        entry->pid = pid;
+        entry->status = status;
+        head++;
+        atomic_store_explicit(&ring.head, head, memory_order_release);
+    }
+}
+
+static void onSigchld(int sig)
+{
+    (void)sig;
+    int savedErrno = errno;
+    reapAvailable();
+    errno = savedErrno;
+}
+
+void reaper_install(void)
+{
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = onSigchld;
+    action.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGCHLD, &action, NULL);
+}
+
+/**
+ * @brief takes the oldest exit off the ring itself.
+ */
+static bool popRing(childExit *exit)
+{
+    size_t tail = atomic_load_explicit(&ring.tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&ring.head, memory_order_acquire);
+    if (tail == head)
+    {
+        if (!atomic_exchange_explicit(&ring.overflowed, false, memory_order_relaxed))
+        {
+            return false;
+        }
+
+        // The handler gave up on a full ring, so finish its job with SIGCHLD blocked
+        sigset_t chld, old;
+        sigemptyset(&chld);
+        sigaddset(&chld, SIGCHLD);
+        sigprocmask(SIG_BLOCK, &chld, &old);
+        reapAvailable();
+        sigprocmask(SIG_SETMASK, &old, NULL);
+        head = atomic_load_explicit(&ring.head, memory_order_acquire);
+        if (tail == head)
+        {
+            return false;
+        }
+    }
+
+    *exit = ring.entries[tail & (REAPER_RING_SIZE - 1)];
+    atomic_store_explicit(&ring.tail, tail + 1, memory_order_release);
+    return true;
+}
+
+bool reaper_next(childExit *exit)
+{
+    if (pending.count > 0)
+    {
+        *exit = pending.entries[pending.start++];
+        pending.count--;
+        if (pending.count == 0)
+        {
+            pending.start = 0;
+        }
+        return true;
+    }
+    return popRing(exit);
+}
+
+/**
+ * @brief keeps an exit that reaper_wait was not looking for.
+ */
+static void keepPending(const childExit *exit)
+{
+    if (pending.start + pending.count == pending.capacity)
+    {
+        if (pending.start > 0)
+        {   // Slide the unread exits back to the front before growing
+            memmove(pending.entries, pending.entries + pending.start, pending.count * sizeof(childExit));
+            pending.start = 0;
+        }
+    }
+    if (pending.count == pending.capacity)
+    {
+        size_t capacity = pending.capacity == 0 ? 16 : pending.capacity * 2;
+        childExit *entries = realloc(pending.entries, capacity * sizeof(childExit));
+        if (entries == NULL)
+        {
+            return; // Lose the exit rather than the shell, the job will just never be reported
+        }
+        pending.entries = entries;
+        pending.capacity = capacity;
+    }
+    pending.entries[pending.start + pending.count++] = *exit;
+}
+
+void reaper_wait_matching(bool (*wanted)(pid_t pid, void *context), void *context, childExit *exit)
+{
+    // It may already have been set aside while waiting for another child
+    childExit *unread = pending.entries + pending.start;
+    for (size_t idx = 0; idx < pending.count; idx++)
+    {
+        if (wanted(unread[idx].pid, context))
+        {
+            *exit = unread[idx];
+            pending.count--;
+            memmove(unread + idx, unread + idx + 1, (pending.count - idx) * sizeof(childExit));
+            return;
+        }
+    }
+
+    // Block SIGCHLD so an exit can't slip in between checking the ring and sleeping
+    sigset_t chld, old;
+    sigemptyset(&chld);
+    sigaddset(&chld, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &chld, &old);
+
+    while (true)
+    {
+        if (popRing(exit))
+        {
+            if (wanted(exit->pid, context))
+            {
+                break;
+            }
+            keepPending(exit);
+            continue;
+        }
+        sigsuspend(&old);
+    }
+
+    sigprocmask(SIG_SETMASK, &old, NULL);
+}
+
+static bool isPid(pid_t pid, void *context)
+{
+    return pid == *(pid_t *)context;
+}
+
+int reaper_wait(pid_t pid, int *status)
+{
+    childExit exit;
+    reaper_wait_matching(isPid, &pid, &exit);
+    if (status != NULL)
+        *status = exit.status;
+    return 0;
+}
@@ -0,0 +1,61 @@
+#ifndef REAPER_H
+#define REAPER_H
+#include <stdbool.h>
+#include <sys/resource.h>
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /**
+     * @brief the exit of one child process, as reported by wait4.
+     */
+    typedef struct childExit {
+        pid_t pid;
+        int status;
+        struct rusage usage;  // The resources the child used
+    } childExit;
+
+    /**
+     * @brief installs a SIGCHLD handler that reaps every child as soon as it
+     * exits and records the exit in a lock-free ring, so the shell never has
+     * to poll its jobs with waitpid.
+     */
+    void reaper_install(void);
+
+    /**
+     * @brief takes the next recorded child exit, oldest first. Never blocks
+     * and makes no system calls unless the ring overflowed.
+     *
+     * @param exit filled in with the exit, if there was one
+     * @return true if an exit was returned, false if there are none
+     */
+    bool reaper_next(childExit *exit);
+
+    /**
+     * @brief blocks until the child with the given pid exits. Exits of other
+     * children that are recorded meanwhile are kept for reaper_next.
+     *
+     * @param pid the child to wait for
+     * @param status set to the child's wait status, if not NULL
+     * @return 0 on success
+     */
+    int reaper_wait(pid_t pid, int *status);
+
+    /**
+     * @brief blocks until a child that wanted returns true for exits. Exits of
+     * other children that are recorded meanwhile are kept for reaper_next.
+     *
+     * @param wanted returns true for the pids to wait for
+     * @param context passed to wanted
+     * @param exit filled in with the exit that was waited for
+     */
+    void reaper_wait_matching(bool (*wanted)(pid_t pid, void *context), void *context, childExit *exit);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif
@@ -0,0 +1,147 @@
+#define _GNU_SOURCE
+#include "redirect.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "options.h"
+
+#define REDIRECT_NOT_APPLIED -2 // In saved, for a redirection redirect_apply never got to
+
+/**
+ * @brief opens the file of one redirection with the flags its kind needs.
+ *
+ * @return the descriptor, or -1 with errno set
+ */
+static int openTarget(const redirection *r)
+{
+    int flags = O_CLOEXEC;
+    if (r->kind == REDIRECT_INPUT)
+        flags |= O_RDONLY;
+    else if (r->kind == REDIRECT_OUTPUT)
+        flags |= O_WRONLY | O_CREAT | O_TRUNC;
+    else
+        flags |= O_WRONLY | O_CREAT | O_APPEND;
+
+    if (options.noatime)
+    {
+        int fd = open(r->target, flags | O_NOATIME, 0666);
+        if (fd != -1 || errno != EPERM)
+        {
+            return fd;
+        }
+        // Only the file's owner may use O_NOATIME, so open it normally
+    }
+    return open(r->target, flags, 0666);
+}
+
+/**
+ * @brief reserves the preallocate option's worth of blocks past the end of a
+ * regular file, without changing its size, so the program writing it grows
+ * into contiguous space. Failures only lose the optimization.
+ */
+static void preallocate(int fd)
+{
+    struct stat info;
+    if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode))
+    {
+        fallocate(fd, FALLOC_FL_KEEP_SIZE, info.st_size, options.preallocate);
+    }
+}
+
+int redirect_open(command *cmd)
+{
+    for (size_t idx = 0; idx < cmd->redirectCount; idx++)
+    {
+        redirection *r = &cmd->redirects[idx];
+        if (r->kind == REDIRECT_DUP || r->kind == REDIRECT_CLOSE)
+        {
+            continue;
+        }
+
+        r->source = openTarget(r);
+        if (r->source == -1)
+        {
+            fprintf(stderr, "%s: %s\n", r->target, strerror(errno));
+            redirect_close(cmd);
+            return -1;
+        }
+        if (r->kind != REDIRECT_INPUT && options.preallocate > 0)
+        {
+            preallocate(r->source);
+        }
+    }
+    return 0;
+}
+
+void redirect_close(command *cmd)
+{
+    for (size_t idx = 0; idx < cmd->redirectCount; idx++)
+    {
+        redirection *r = &cmd->redirects[idx];
+        if (r->kind != REDIRECT_DUP && r->kind != REDIRECT_CLOSE && r->source != -1)
+        {
+            close(r->source);
+            r->source = -1;
+        }
+    }
+}
+
+int redirect_apply(const command *cmd, int *saved)
+{
+    for (size_t idx = 0; idx < cmd->redirectCount; idx++)
+    {
+        saved[idx] = REDIRECT_NOT_APPLIED;
+    }
+    fflush(stdout);
+    fflush(stderr);
+
+    for (size_t idx = 0; idx < cmd->redirectCount; idx++)
+    {
+        const redirection *r = &cmd->redirects[idx];
+        // Keep a copy out of the way of low descriptors, or -1 if fd was not open
+        saved[idx] = fcntl(r->fd, F_DUPFD_CLOEXEC, 10);
+        if (saved[idx] == -1 && errno != EBADF)
+        {
+            saved[idx] = REDIRECT_NOT_APPLIED;
+            return -1;
+        }
+
+        if (r->kind == REDIRECT_CLOSE)
+        {
+            close(r->fd);
+        }
+        else if (dup2(r->source, r->fd) == -1)
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void redirect_restore(const command *cmd, const int *saved)
+{
+    fflush(stdout);
+    fflush(stderr);
+
+    // Undo them in reverse, so a descriptor redirected twice ends up as it started
+    for (size_t idx = cmd->redirectCount; idx-- > 0;)
+    {
+        int fd = cmd->redirects[idx].fd;
+        if (saved[idx] == REDIRECT_NOT_APPLIED)
+        {
+            continue;
+        }
+        if (saved[idx] == -1)
+        {
+            close(fd);
+            continue;
+        }
+        dup2(saved[idx], fd);
+        close(saved[idx]);
+    }
+}
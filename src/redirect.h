@@ -0,0 +1,50 @@
+#ifndef REDIRECT_H
+#define REDIRECT_H
+#include "pipeline.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /**
+     * @brief opens the files a command redirects to or from, close-on-exec,
+     * and stores each descriptor in its redirection's source. Files opened
+     * for output are created with mode 0666 less the umask. The noatime
+     * option opens them with O_NOATIME, and the preallocate option reserves
+     * space past the end of output files with fallocate.
+     *
+     * @param cmd the command whose files to open
+     * @return 0 on success, or -1 if a file could not be opened, which has
+     * been reported. Nothing is left open on failure.
+     */
+    int redirect_open(command *cmd);
+
+    /**
+     * @brief closes the files opened by redirect_open. The command's own
+     * copies are not affected.
+     */
+    void redirect_close(command *cmd);
+
+    /**
+     * @brief applies a command's redirections to the shell itself, so a
+     * builtin can run with them. The descriptors they replace are kept in
+     * saved, which needs room for one int per redirection, until
+     * redirect_restore puts them back. The files must already be open.
+     *
+     * @return 0 on success, or -1 with errno set. Whatever was applied is
+     * still recorded in saved.
+     */
+    int redirect_apply(const command *cmd, int *saved);
+
+    /**
+     * @brief undoes redirect_apply, flushing stdout and stderr first so
+     * buffered builtin output goes where it was redirected.
+     */
+    void redirect_restore(const command *cmd, const int *saved);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif
@@ -0,0 +1,175 @@
+#define _GNU_SOURCE
+#include "server.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "linereader.h"
+
+#define SERVER_BACKLOG 16
+#define SERVER_REPLY_BUFFER 65536  // Answers held back until a batch is done
+
+/**
+ * @brief the answers to a client's lines that have not been sent yet.
+ */
+typedef struct replyBuffer {
+    int fd;
+    size_t used;
+    bool failed;  // The client went away, so nothing more is sent
+    char data[SERVER_REPLY_BUFFER];
+} replyBuffer;
+
+/**
+ * @brief sends the held answers. MSG_NOSIGNAL keeps a client that hung up
+ * from killing the shell with SIGPIPE, which the commands it runs still
+ * need to get.
+ */
+static void sendReplies(replyBuffer *replies)
+{
+    size_t sent = 0;
+    while (!replies->failed && sent < replies->used)
+    {
+        ssize_t bytes = send(replies->fd, replies->data + sent, replies->used - sent, MSG_NOSIGNAL);
+        if (bytes == -1 && errno == EINTR)
+        {
+            continue;
+        }
+        if (bytes == -1)
+        {
+            replies->failed = true;
+            break;
+        }
+        sent += (size_t)bytes;
+    }
+    replies->used = 0;
+}
+
+/**
+ * @brief holds a line's answer, sending the ones held first if it does not
+ * fit.
+ */
+static void addReply(replyBuffer *replies, const lineUsage *result)
+{
+    if (SERVER_REPLY_BUFFER - replies->used < USAGE_JSON_MAX + 1)
+    {
+        sendReplies(replies);
+    }
+    int len = usage_format_json(replies->data + replies->used, USAGE_JSON_MAX, result);
+    replies->used += (size_t)(len < USAGE_JSON_MAX ? len : USAGE_JSON_MAX - 1);
+    replies->data[replies->used++] = '\n';
+}
+
+/**
+ * @brief runs the lines one client sends until it closes its end.
+ *
+ * @return false if the handler asked the server to stop
+ */
+static bool serveClient(int client, serverHandler handler, void *context)
+{
+    lineReader reader;
+    if (linereader_open_fd(&reader, client) != 0)
+    {
+        perror("Error reading commands");
+        return true;
+    }
+    static replyBuffer replies;
+    replies.fd = client;
+    replies.used = 0;
+    replies.failed = false;
+
+    bool keepGoing = true;
+    char *line;
+    while (keepGoing && (line = linereader_next(&reader)))
+    {
+        lineUsage result;
+        memset(&result, 0, sizeof(result));
+        keepGoing = handler(line, &result, context);
+        addReply(&replies, &result);
+        if (!keepGoing || !linereader_has_line(&reader))
+        {   // Answer the batch before waiting for the next one
+            sendReplies(&replies);
+        }
+    }
+    sendReplies(&replies);
+    linereader_close(&reader);
+    return keepGoing;
+}
+
+/**
+ * @brief makes the listening socket at path, which only its owner may
+ * connect to. A socket left at path by a server that did not stop cleanly
+ * is replaced, but any other file there is an error.
+ *
+ * @return the socket, or -1 with errno set
+ */
+static int listenAt(const char *path)
+{
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(address.sun_path))
+    {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    strcpy(address.sun_path, path);
+
+    struct stat info;
+    if (lstat(path, &info) == 0 && S_ISSOCK(info.st_mode))
+    {
+        unlink(path);
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd == -1)
+    {
+        return -1;
+    }
+    mode_t mask = umask(077);
+    int bound = bind(fd, (struct sockaddr *)&address, sizeof(address));
+    umask(mask);
+    if (bound != 0 || listen(fd, SERVER_BACKLOG) != 0)
+    {
+        int error = errno;
+        close(fd);
+        errno = error;
+        return -1;
+    }
+    return fd;
+}
+
+int server_run(const char *path, serverHandler handler, void *context)
+{
+    int listener = listenAt(path);
+    if (listener == -1)
+    {
+        return -1;
+    }
+    int result = 0;
+    bool keepGoing = true;
+    while (keepGoing)
+    {
+        int client = accept4(listener, NULL, NULL, SOCK_CLOEXEC);
+        if (client == -1)
+        {
+            // Children exiting interrupt accept with SIGCHLD, and a client may give up before it is accepted
+            if (errno == EINTR || errno == ECONNABORTED)
+            {
+                continue;
+            }
+            result = -1;
+            break;
+        }
+        keepGoing = serveClient(client, handler, context);
+        close(client);
+    }
+    int error = errno;
+    close(listener);
+    unlink(path);
+    errno = error;
+    return result;
+}
@@ -0,0 +1,44 @@
+#ifndef SERVER_H
+#define SERVER_H
+#include <stdbool.h>
+
+#include "usage.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /**
+     * @brief runs one line a client sent and fills in what it took.
+     *
+     * @param line the line, without its newline
+     * @param result where to put the line's exit status and usage
+     * @param context what was given to server_run
+     * @return false to stop the server after this line
+     */
+    typedef bool (*serverHandler)(char *line, lineUsage *result, void *context);
+
+    /**
+     * @brief serves command lines on a Unix socket until the handler stops
+     * it. Clients connect one at a time and send lines separated by
+     * newlines, as many per write as they like. Each line is answered, in
+     * order, with one line holding the JSON object usage_format_json makes.
+     * The answers to a batch of lines are sent together, once no whole line
+     * is left to run without reading again. The socket is made with only its
+     * owner allowed to connect, replacing any socket already at path, and is
+     * removed when the server stops.
+     *
+     * @param path where to make the socket
+     * @param handler runs each line
+     * @param context passed to handler
+     * @return 0 once the handler stops the server, or -1 with errno set if
+     * the socket could not be made or connections could not be accepted
+     */
+    int server_run(const char *path, serverHandler handler, void *context);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif
@@ -0,0 +1,147 @@
+#include "shstat.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define SHSTAT_SUB_BITS 5  // 32 buckets per power of two
+#define SHSTAT_SUB_COUNT (1u << SHSTAT_SUB_BITS)
+#define SHSTAT_MAX_BIT 40  // Values from 2^41 ns, about 37 minutes, share the last buckets
+#define SHSTAT_BUCKETS ((SHSTAT_MAX_BIT - SHSTAT_SUB_BITS + 2) * SHSTAT_SUB_COUNT)
+
+/**
+ * @brief the measurements of one phase.
+ */
+typedef struct phaseStats {
+    uint64_t buckets[SHSTAT_BUCKETS];
+    uint64_t count;
+    uint64_t total;
+    uint64_t max;
+} phaseStats;
+
+static phaseStats stats[SHSTAT_PHASES];
+
+/**
+ * @brief returns the bucket of a value. Values below SHSTAT_SUB_COUNT get a
+ * bucket each, and every power of two above that is split into
+ * SHSTAT_SUB_COUNT equal buckets.
+ */
+static size_t bucketOf(uint64_t value)
+{
+    if (value < SHSTAT_SUB_COUNT)
+    {
+        return value;
+    }
+    unsigned bit = 63 - __builtin_clzll(value);
+    if (bit > SHSTAT_MAX_BIT)
+    {
+        return SHSTAT_BUCKETS - 1;
+    }
+    unsigned shift = bit - SHSTAT_SUB_BITS;
+    return (shift + 1) * SHSTAT_SUB_COUNT + ((value >> shift) - SHSTAT_SUB_COUNT);
+}
+
+/**
+ * @brief returns the highest value that falls in a bucket.
+ */
+static uint64_t bucketHighest(size_t bucket)
+{
+    if (bucket < SHSTAT_SUB_COUNT)
+    {
+        return bucket;
+    }
+    unsigned shift = bucket / SHSTAT_SUB_COUNT - 1;
+    uint64_t top = SHSTAT_SUB_COUNT + bucket % SHSTAT_SUB_COUNT;
+    return ((top + 1) << shift) - 1;
+}
+
+void shstat_record(shstatPhase phase, uint64_t nanoseconds)
+{
+    phaseStats *s = &stats[phase];
+    s->buckets[bucketOf(nanoseconds)]++;
+    s->count++;
+    s->total += nanoseconds;
+    if (nanoseconds > s->max)
+    {
+        s->max = nanoseconds;
+    }
+}
+
+uint64_t shstat_percentile(shstatPhase phase, double percentile)
+{
+    const phaseStats *s = &stats[phase];
+    if (s->count == 0)
+    {
+        return 0;
+    }
+    uint64_t rank = (uint64_t)(percentile / 100.0 * s->count + 0.5);
+    if (rank == 0)
+    {
+        rank = 1;
+    }
+    uint64_t seen = 0;
+    for (size_t bucket = 0; bucket < SHSTAT_BUCKETS; bucket++)
+    {
+        seen += s->buckets[bucket];
+        if (seen >= rank)
+        {
+            uint64_t highest = bucketHighest(bucket);
+            return highest < s->max ? highest : s->max;
+        }
+    }
+    return s->max;
+}
+
+#ifdef LAB_NO_SHSTAT
+
+int shstat_builtin(char **argv)
+{
+    (void)argv;
+    fprintf(stderr, "shstat: this shell was built without it\n");
+    return 1;
+}
+
+#else
+
+static const char *const phaseNames[SHSTAT_PHASES] = {"parse", "builtin", "report", "lookup",
+                                                      "launch", "wait", "terminal"};
+
+/**
+ * @brief prints a duration in nanoseconds with a unit that keeps it short,
+ * like "850ns", "12.4us" or "3.10ms", right aligned in 10 columns.
+ */
+static void printDuration(uint64_t nanoseconds)
+{
+    if (nanoseconds < 1000)
+        printf(" %8luns", (unsigned long)nanoseconds);
+    else if (nanoseconds < 1000000)
+        printf(" %8.1fus", nanoseconds / 1e3);
+    else if (nanoseconds < 1000000000)
+        printf(" %8.2fms", nanoseconds / 1e6);
+    else
+        printf(" %9.2fs", nanoseconds / 1e9);
+}
+
+int shstat_builtin(char **argv)
+{
+    if (argv[1] != NULL && strcmp(argv[1], "-r") == 0)
+    {
+        memset(stats, 0, sizeof(stats));
+        return 0;
+    }
+
+    printf("%-9s %9s %10s %10s %10s %10s %10s\n", "phase", "count", "mean", "p50", "p90", "p99", "max");
+    for (int phase = 0; phase < SHSTAT_PHASES; phase++)
+    {
+        const phaseStats *s = &stats[phase];
+        printf("%-9s %9lu", phaseNames[phase], (unsigned long)s->count);
+        printDuration(s->count == 0 ? 0 : s->total / s->count);
+        printDuration(shstat_percentile(phase, 50));
+        printDuration(shstat_percentile(phase, 90));
+        printDuration(shstat_percentile(phase, 99));
+        printDuration(s->max);
+        printf("\n");
+    }
+    return 0;
+}
+
+#endif
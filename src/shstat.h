@@ -0,0 +1,79 @@
+#ifndef SHSTAT_H
+#define SHSTAT_H
+#include <stdint.h>
+#include <time.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /**
+     * @brief the parts of running a line that the shell itself spends time
+     * in, as opposed to the time its children run.
+     */
+    typedef enum shstatPhase {
+        SHSTAT_PARSE,     // Tokenizing and parsing a line
+        SHSTAT_BUILTIN,   // Running a builtin in the shell
+        SHSTAT_REPORT,    // reportAndManageFinishedJobs
+        SHSTAT_LOOKUP,    // Finding the programs of a pipeline in $PATH
+        SHSTAT_LAUNCH,    // Starting a pipeline's processes with fork or posix_spawn
+        SHSTAT_WAIT,      // Waiting for a foreground pipeline to exit
+        SHSTAT_TERMINAL,  // Taking the terminal back and restoring its modes
+        SHSTAT_PHASES,
+    } shstatPhase;
+
+    /**
+     * @brief returns the current CLOCK_MONOTONIC time in nanoseconds.
+     */
+    static inline uint64_t shstat_now(void)
+    {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+    }
+
+    /**
+     * @brief adds one measurement of a phase to its histogram. Values are
+     * kept to within about 3% in log-linear buckets, like an HDR histogram,
+     * so recording is O(1) and uses no memory.
+     *
+     * @param phase the phase measured
+     * @param nanoseconds how long it took
+     */
+    void shstat_record(shstatPhase phase, uint64_t nanoseconds);
+
+    /**
+     * @brief returns the value at or below which percentile percent of a
+     * phase's measurements fall, rounded up to its bucket's highest value,
+     * or 0 if there are none.
+     */
+    uint64_t shstat_percentile(shstatPhase phase, double percentile);
+
+    /**
+     * @brief the shstat builtin. Prints each phase's count, mean, median,
+     * 90th and 99th percentiles and maximum. "shstat -r" clears them.
+     *
+     * @param argv the command, starting with "shstat"
+     * @return 0, or 1 if the shell was built without it
+     */
+    int shstat_builtin(char **argv);
+
+/*
+ * Instrumentation points. SHSTAT_BEGIN(name) starts timing into a local
+ * named name, and SHSTAT_END(name, phase) records the time since then. Build
+ * with -DLAB_NO_SHSTAT to compile them out entirely.
+ */
+#ifdef LAB_NO_SHSTAT
+#define SHSTAT_BEGIN(name)
+#define SHSTAT_END(name, phase)
+#else
+#define SHSTAT_BEGIN(name) uint64_t name = shstat_now()
+#define SHSTAT_END(name, phase) shstat_record((phase), shstat_now() - (name))
+#endif
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif
@@ -0,0 +1,258 @@
+#include "tokenizer.h"
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lexscan.h"
+
+#define TOKENIZER_MIN_SPANS 64
+
+/**
+ * @brief makes room for at least one more span, doubling the array if needed.
+ *
+ * @return true if successful, false if out of memory.
+ */
+static bool reserveSpan(tokenizer *t)
+{
+    if (t->count < t->capacity)
+    {
+        return true;
+    }
+
+    size_t capacity = t->capacity == 0 ? TOKENIZER_MIN_SPANS : t->capacity * 2;
+    tokenSpan *spans = realloc(t->spans, sizeof(tokenSpan) * capacity);
+    if (spans == NULL)
+    {
+        return false;
+    }
+    t->spans = spans;
+    t->capacity = capacity;
+    return true;
+}
+
+/**
+ * @brief works out which operator starts at line[idx].
+ *
+ * @param length set to the number of bytes in the operator
+ * @return the kind of operator
+ */
+static tokenKind scanOperator(const char *line, size_t len, size_t idx, uint32_t *length)
+{
+    char c = line[idx];
+    char next = idx + 1 < len ? line[idx + 1] : '\0';
+    *length = 2;
+
+    switch (c)
+    {
+    case '|':
+        if (next == '|')
+            return TOKEN_OR_IF;
+        break;
+    case '&':
+        if (next == '&')
+            return TOKEN_AND_IF;
+        break;
+    case '>':
+        if (next == '>')
+            return TOKEN_DGREAT;
+        if (next == '&')
+            return TOKEN_GREATAND;
+        break;
+    case '<':
+        if (next == '&')
+            return TOKEN_LESSAND;
+        break;
+    default:
+        break;
+    }
+
+    *length = 1;
+    switch (c)
+    {
+    case '|':
+        return TOKEN_PIPE;
+    case '&':
+        return TOKEN_AMP;
+    case ';':
+        return TOKEN_SEMI;
+    case '<':
+        return TOKEN_LESS;
+    default:
+        return TOKEN_GREAT;
+    }
+}
+
+/**
+ * @brief returns the index just past the closing double quote of the string
+ * whose opening quote is at line[idx], or len if it is never closed.
+ */
+static size_t skipDoubleQuoted(const char *line, size_t len, size_t idx)
+{
+    idx++;
+    while (idx < len && line[idx] != '"')
+    {
+        idx += (line[idx] == '\\' && idx + 1 < len) ? 2 : 1;
+    }
+    return idx < len ? idx + 1 : len;
+}
+
+int tokenize(tokenizer *t, const char *line, size_t len)
+{
+    t->count = 0;
+    if (len >= UINT32_MAX)
+    {
+        errno = EOVERFLOW;
+        return -1;
+    }
+
+    size_t idx = 0;
+    while ((idx = lex_skip_blanks(line, len, idx)) < len)
+    {
+        if (!reserveSpan(t))
+        {
+            errno = ENOMEM;
+            return -1;
+        }
+        tokenSpan *span = &t->spans[t->count++];
+        span->offset = (uint32_t)idx;
+        span->flags = 0;
+
+        if (lex_is_operator(line[idx]))
+        {
+            span->kind = scanOperator(line, len, idx, &span->length);
+            idx += span->length;
+            continue;
+        }
+
+        // A word runs until an unquoted blank or operator
+        span->kind = TOKEN_WORD;
+        while ((idx = lex_find_special(line, len, idx)) < len)
+        {
+            char c = line[idx];
+            if (lex_is_blank(c) || lex_is_operator(c))
+            {
+                break;
+            }
+
+            span->flags |= TOKEN_QUOTED;
+            if (c == '\'')
+            {
+                const char *close = memchr(line + idx + 1, '\'', len - idx - 1);
+                idx = close == NULL ? len : (size_t)(close - line) + 1;
+            }
+            else if (c == '"')
+            {
+                idx = skipDoubleQuoted(line, len, idx);
+            }
+            else
+            {   // Backslash, the next character is taken literally
+                idx = idx + 2 < len ? idx + 2 : len;
+            }
+        }
+        span->length = (uint32_t)(idx - span->offset);
+    }
+
+    return (int)t->count;
+}
+
+char *token_materialize_word(const tokenSpan *span, char *text)
+{
+    char *word = text + span->offset;
+    if (!(span->flags & TOKEN_QUOTED))
+    {
+        word[span->length] = '\0'; // Overwrites whatever ended the word
+        return word;
+    }
+
+    // Remove the quoting. The word only ever shrinks, so it can be done in place.
+    size_t in = 0;
+    size_t out = 0;
+    char quote = '\0';
+    while (in < span->length)
+    {
+        char c = word[in++];
+        if (quote == '\'')
+        {
+            if (c == '\'')
+                quote = '\0';
+            else
+                word[out++] = c;
+        }
+        else if (c == '\\' && in < span->length && (quote == '\0' || strchr("\"\\$`", word[in]) != NULL))
+        {
+            word[out++] = word[in++];
+        }
+        else if (quote == '"' && c == '"')
+        {
+            quote = '\0';
+        }
+        else if (quote == '\0' && (c == '\'' || c == '"'))
+        {
+            quote = c;
+        }
+        else
+        {
+            word[out++] = c;
+        }
+    }
+    word[out] = '\0';
+    return word;
+}
+
+const char *token_operator_text(tokenKind kind)
+{
+    static const char *const operatorText[] = {
+        [TOKEN_WORD] = "",
+        [TOKEN_PIPE] = "|",
+        [TOKEN_OR_IF] = "||",
+        [TOKEN_AMP] = "&",
+        [TOKEN_AND_IF] = "&&",
+        [TOKEN_SEMI] = ";",
+        [TOKEN_LESS] = "<",
+        [TOKEN_GREAT] = ">",
+        [TOKEN_DGREAT] = ">>",
+        [TOKEN_LESSAND] = "<&",
+        [TOKEN_GREATAND] = ">&",
+    };
+    return operatorText[kind];
+}
+
+char **tokens_to_argv(const tokenizer *t, char *text, arena *a)
+{
+    char **argv = arena_alloc(a, sizeof(char *) * (t->count + 1));
+    if (argv == NULL)
+    {
+        return NULL;
+    }
+
+    for (size_t idx = 0; idx < t->count; idx++)
+    {
+        const tokenSpan *span = &t->spans[idx];
+        if (span->kind == TOKEN_WORD)
+        {
+            argv[idx] = token_materialize_word(span, text);
+        }
+        else
+        {
+            const char *op = token_operator_text(span->kind);
+            argv[idx] = arena_strndup(a, op, strlen(op));
+            if (argv[idx] == NULL)
+            {
+                return NULL;
+            }
+        }
+    }
+    argv[t->count] = NULL;
+
+    return argv;
+}
+
+void tokenizer_destroy(tokenizer *t)
+{
+    free(t->spans);
+    t->spans = NULL;
+    t->count = 0;
+    t->capacity = 0;
+}
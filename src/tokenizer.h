@@ -0,0 +1,111 @@
+#ifndef TOKENIZER_H
+#define TOKENIZER_H
+#include <stddef.h>
+#include <stdint.h>
+
+#include "arena.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /**
+     * @brief what a token is. Everything that is not an operator is a word.
+     */
+    typedef enum tokenKind {
+        TOKEN_WORD,
+        TOKEN_PIPE,      // |
+        TOKEN_OR_IF,     // ||
+        TOKEN_AMP,       // &
+        TOKEN_AND_IF,    // &&
+        TOKEN_SEMI,      // ;
+        TOKEN_LESS,      // <
+        TOKEN_GREAT,     // >
+        TOKEN_DGREAT,    // >>
+        TOKEN_LESSAND,   // <&
+        TOKEN_GREATAND,  // >&
+    } tokenKind;
+
+    /**
+     * @brief set on a word that contains quotes or backslashes, which are
+     * removed when the word is materialized.
+     */
+    #define TOKEN_QUOTED 0x1
+
+    /**
+     * @brief the location of one token inside the line it was scanned from.
+     */
+    typedef struct tokenSpan {
+        uint32_t offset;
+        uint32_t length;
+        uint8_t kind;
+        uint8_t flags;
+    } tokenSpan;
+
+    /**
+     * @brief the spans found by the last call to tokenize. The span array is
+     * kept between calls and only grows, so tokenizing a steady stream of
+     * lines does not allocate.
+     */
+    typedef struct tokenizer {
+        tokenSpan *spans;
+        size_t count;
+        size_t capacity;
+    } tokenizer;
+
+    /**
+     * @brief scans line once and records the offset, length and kind of every
+     * token in t->spans. Words are separated by spaces, tabs and operators
+     * (&, &&, |, ||, ;, <, >, >>, <&, >&). Single quotes, double quotes and
+     * backslashes keep blanks and operator characters inside a word. The line
+     * itself is not modified or copied.
+     *
+     * @param t the tokenizer to record the spans in
+     * @param line the line to scan
+     * @param len the length of line, lines of 4 GiB or more are rejected
+     * @return the number of tokens, or -1 with errno set on error
+     */
+    int tokenize(tokenizer *t, const char *line, size_t len);
+
+    /**
+     * @brief turns the spans from the last call to tokenize into an argv style
+     * array. Quotes are removed and a NUL is written in place at the end of
+     * every word, so text must be a writable copy of the tokenized line, and
+     * the returned words point into it. Operators are copied into the arena,
+     * since the NUL ending the word before an operator may overwrite it.
+     *
+     * @param t the tokenizer holding the spans
+     * @param text a writable copy of the tokenized line
+     * @param a the arena to allocate the array from
+     * @return a NULL terminated array of the tokens, or NULL if out of memory
+     */
+    char **tokens_to_argv(const tokenizer *t, char *text, arena *a);
+
+    /**
+     * @brief removes the quotes and backslashes from the word covered by span,
+     * in place, and NUL terminates it.
+     *
+     * @param span the span of a word inside text
+     * @param text a writable copy of the tokenized line
+     * @return the start of the word inside text
+     */
+    char *token_materialize_word(const tokenSpan *span, char *text);
+
+    /**
+     * @brief returns the text of an operator token kind, e.g. "&&".
+     */
+    const char *token_operator_text(tokenKind kind);
+
+    /**
+     * @brief frees the span array owned by the tokenizer.
+     *
+     * @param t the tokenizer to destroy
+     */
+    void tokenizer_destroy(tokenizer *t);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif
@@ -0,0 +1,120 @@
+#include "usage.h"
+
+#include "options.h"
+
+/**
+ * @brief returns a timeval in seconds.
+ */
+static double seconds(struct timeval time)
+{
+    return time.tv_sec + time.tv_usec / 1e6;
+}
+
+/**
+ * @brief adds b to a, carrying microseconds into seconds.
+ */
+static void addTime(struct timeval *a, struct timeval b)
+{
+    a->tv_sec += b.tv_sec;
+    a->tv_usec += b.tv_usec;
+    if (a->tv_usec >= 1000000)
+    {
+        a->tv_sec++;
+        a->tv_usec -= 1000000;
+    }
+}
+
+void usage_add(struct rusage *total, const struct rusage *one)
+{
+    addTime(&total->ru_utime, one->ru_utime);
+    addTime(&total->ru_stime, one->ru_stime);
+    if (one->ru_maxrss > total->ru_maxrss)
+    {
+        total->ru_maxrss = one->ru_maxrss;
+    }
+    total->ru_minflt += one->ru_minflt;
+    total->ru_majflt += one->ru_majflt;
+    total->ru_nvcsw += one->ru_nvcsw;
+    total->ru_nivcsw += one->ru_nivcsw;
+}
+
+/**
+ * @brief subtracts b from a, borrowing from seconds for microseconds.
+ */
+static void subtractTime(struct timeval *a, struct timeval b)
+{
+    a->tv_sec -= b.tv_sec;
+    a->tv_usec -= b.tv_usec;
+    if (a->tv_usec < 0)
+    {
+        a->tv_sec--;
+        a->tv_usec += 1000000;
+    }
+}
+
+void usage_since(struct rusage *usage, const struct rusage *start)
+{
+    subtractTime(&usage->ru_utime, start->ru_utime);
+    subtractTime(&usage->ru_stime, start->ru_stime);
+    usage->ru_minflt -= start->ru_minflt;
+    usage->ru_majflt -= start->ru_majflt;
+    usage->ru_nvcsw -= start->ru_nvcsw;
+    usage->ru_nivcsw -= start->ru_nivcsw;
+}
+
+void usage_print(FILE *out, const struct rusage *usage)
+{
+    fprintf(out, "user %.3fs sys %.3fs maxrss %ldKB flt %ld/%ld csw %ld/%ld", seconds(usage->ru_utime),
+            seconds(usage->ru_stime), usage->ru_maxrss, usage->ru_minflt, usage->ru_majflt, usage->ru_nvcsw,
+            usage->ru_nivcsw);
+}
+
+int usage_format_json(char *buffer, size_t size, const lineUsage *line)
+{
+    const struct rusage *usage = &line->usage;
+    return snprintf(buffer, size,
+                    "{\"real\":%.6f,\"user\":%.6f,\"sys\":%.6f,\"maxrss_kb\":%ld,\"minflt\":%ld,\"majflt\":%ld,"
+                    "\"nvcsw\":%ld,\"nivcsw\":%ld,\"status\":%d}",
+                    line->real, seconds(usage->ru_utime), seconds(usage->ru_stime), usage->ru_maxrss,
+                    usage->ru_minflt, usage->ru_majflt, usage->ru_nvcsw, usage->ru_nivcsw, line->status);
+}
+
+void usage_print_time(double real, const struct rusage *usage, int status)
+{
+    if (options.timeFormat == TIME_JSON)
+    {
+        lineUsage line = {status, real, *usage};
+        char json[USAGE_JSON_MAX];
+        usage_format_json(json, sizeof(json), &line);
+        fprintf(stderr, "%s\n", json);
+        return;
+    }
+    fprintf(stderr, "real     %.6fs\n", real);
+    fprintf(stderr, "user     %.6fs\n", seconds(usage->ru_utime));
+    fprintf(stderr, "sys      %.6fs\n", seconds(usage->ru_stime));
+    fprintf(stderr, "maxrss   %ldKB\n", usage->ru_maxrss);
+    fprintf(stderr, "faults   %ld minor, %ld major\n", usage->ru_minflt, usage->ru_majflt);
+    fprintf(stderr, "switches %ld voluntary, %ld involuntary\n", usage->ru_nvcsw, usage->ru_nivcsw);
+}
+
+/**
+ * @brief prints a user and system time pair as "0m0.010s 0m0.002s".
+ */
+static void printTimes(const struct rusage *usage)
+{
+    printf("%ldm%.3fs %ldm%.3fs\n", (long)usage->ru_utime.tv_sec / 60,
+           (usage->ru_utime.tv_sec % 60) + usage->ru_utime.tv_usec / 1e6, (long)usage->ru_stime.tv_sec / 60,
+           (usage->ru_stime.tv_sec % 60) + usage->ru_stime.tv_usec / 1e6);
+}
+
+int times_builtin(char **argv)
+{
+    (void)argv;
+    struct rusage self;
+    struct rusage children;
+    getrusage(RUSAGE_SELF, &self);
+    getrusage(RUSAGE_CHILDREN, &children);
+    printTimes(&self);
+    printTimes(&children);
+    return 0;
+}
@@ -0,0 +1,88 @@
+#ifndef USAGE_H
+#define USAGE_H
+#include <stdio.h>
+#include <sys/resource.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define USAGE_JSON_MAX 256 // Room for any object usage_format_json writes
+
+    /**
+     * @brief adds one process's resource usage to a running total. CPU times
+     * and context switches are summed, and the larger maximum RSS is kept,
+     * since processes of a pipeline run at the same time.
+     *
+     * @param total the total to add to
+     * @param one the usage to add
+     */
+    void usage_add(struct rusage *total, const struct rusage *one);
+
+    /**
+     * @brief turns a later reading of the same process's usage into what it
+     * used since start. The maximum RSS is left as it is.
+     *
+     * @param usage the later reading, changed in place
+     * @param start the earlier reading
+     */
+    void usage_since(struct rusage *usage, const struct rusage *start);
+
+    /**
+     * @brief prints resource usage in the following format, with no newline:
+     * user 0.001s sys 0.002s maxrss 1780KB flt 120/0 csw 2/0
+     * where flt is the minor and major page faults, and csw is the voluntary
+     * and involuntary context switches.
+     *
+     * @param out where to print
+     * @param usage the usage to print
+     */
+    void usage_print(FILE *out, const struct rusage *usage);
+
+    /**
+     * @brief what running one line of input took.
+     */
+    typedef struct lineUsage {
+        int status;          // The exit status of its last command
+        double real;         // The wall clock seconds from start to finish
+        struct rusage usage; // What its commands used
+    } lineUsage;
+
+    /**
+     * @brief formats a line's usage as the JSON object usage_print_time
+     * prints for TIME_JSON, without a newline.
+     *
+     * @param buffer where to write it
+     * @param size the buffer's size
+     * @param line the usage to format
+     * @return the length of the object, as snprintf returns
+     */
+    int usage_format_json(char *buffer, size_t size, const lineUsage *line);
+
+    /**
+     * @brief prints what the time keyword measured to stderr, in the format
+     * the timeformat option selects. TIME_TEXT prints one labeled line per
+     * measurement and TIME_JSON prints an object with the keys real, user and
+     * sys in seconds, maxrss_kb, minflt, majflt, nvcsw, nivcsw and status.
+     *
+     * @param real the wall clock seconds
+     * @param usage the resources used
+     * @param status the exit status of the command
+     */
+    void usage_print_time(double real, const struct rusage *usage, int status);
+
+    /**
+     * @brief the times builtin. Prints the user and system CPU time of the
+     * shell, then of all the children it has reaped, as POSIX describes.
+     *
+     * @param argv the command, starting with "times"
+     * @return 0
+     */
+    int times_builtin(char **argv);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif
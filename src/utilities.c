@@ -0,0 +1,787 @@
+#include "utilities.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "outbuf.h"
+
+#define ESCAPE_STOP -1 // From parseEscape for \c, which ends the output
+
+/**
+ * @brief reads the backslash escape that starts at seq, just past the
+ * backslash. Octal escapes are \0nnn if zeroOctal, as echo and %b write
+ * them, or \nnn, as printf formats do. An escape it does not know stands for
+ * the backslash itself.
+ *
+ * @param value set to the byte the escape stands for, or ESCAPE_STOP for \c
+ * @return where the text after the escape starts
+ */
+static const char *parseEscape(const char *seq, bool zeroOctal, int *value)
+{
+    static const char simple[] = "\\\\a\ab\be\033f\fn\nr\rt\tv\v";
+    for (const char *entry = simple; *entry != '\0'; entry += 2)
+    {
+        if (*seq == entry[0])
+        {
+            *value = (unsigned char)entry[1];
+            return seq + 1;
+        }
+    }
+
+    int digits = 0;
+    int base = 0;
+    if (*seq == 'c')
+    {
+        *value = ESCAPE_STOP;
+        return seq + 1;
+    }
+    if (*seq == 'x')
+    {
+        seq++;
+        base = 16;
+        digits = 2;
+    }
+    else if (zeroOctal && *seq == '0')
+    {
+        seq++;
+        base = 8;
+        digits = 3;
+    }
+    else if (!zeroOctal && *seq >= '0' && *seq <= '7')
+    {
+        base = 8;
+        digits = 3;
+    }
+    else
+    {
+        *value = '\\';
+        return seq;
+    }
+
+    int result = 0;
+    int used = 0;
+    for (; used < digits; used++, seq++)
+    {
+        int digit;
+        if (*seq >= '0' && *seq <= '7')
+            digit = *seq - '0';
+        else if (base == 16 && *seq >= '8' && *seq <= '9')
+            digit = *seq - '0';
+        else if (base == 16 && *seq >= 'a' && *seq <= 'f')
+            digit = *seq - 'a' + 10;
+        else if (base == 16 && *seq >= 'A' && *seq <= 'F')
+            digit = *seq - 'A' + 10;
+        else
+            break;
+        result = result * base + digit;
+    }
+    if (base == 16 && used == 0)
+    {   // "\x" with no digits is left as it is
+        *value = '\\';
+        return seq - 1;
+    }
+    *value = result & 0xff;
+    return seq;
+}
+
+/**
+ * @brief copies src to dst with its backslash escapes replaced, as echo -e
+ * and %b do. The result is never longer than src.
+ *
+ * @param stopped set to true if it stopped at \c, so nothing more should be
+ * printed
+ * @return the length of the result
+ */
+static size_t unescape(char *dst, const char *src, bool zeroOctal, bool *stopped)
+{
+    char *start = dst;
+    *stopped = false;
+    while (*src != '\0')
+    {
+        if (*src != '\\')
+        {
+            *dst++ = *src++;
+            continue;
+        }
+        int value;
+        src = parseEscape(src + 1, zeroOctal, &value);
+        if (value == ESCAPE_STOP)
+        {
+            *stopped = true;
+            break;
+        }
+        *dst++ = (char)value;
+    }
+    *dst = '\0';
+    return dst - start;
+}
+
+/**
+ * @brief returns true if arg is an echo option, a dash and nothing but n, e
+ * and E.
+ */
+static bool isEchoOption(const char *arg)
+{
+    return arg[0] == '-' && arg[1] != '\0' && strspn(arg + 1, "neE") == strlen(arg + 1);
+}
+
+int echo_builtin(char **argv)
+{
+    bool newline = true;
+    bool escapes = false;
+    char **arg = argv + 1;
+    for (; *arg != NULL && isEchoOption(*arg); arg++)
+    {
+        for (const char *option = *arg + 1; *option != '\0'; option++)
+        {
+            if (*option == 'n')
+                newline = false;
+            else
+                escapes = *option == 'e';
+        }
+    }
+
+    outBuffer out;
+    outbuf_init(&out, STDOUT_FILENO);
+    for (; *arg != NULL; arg++)
+    {
+        if (!escapes)
+        {
+            outbuf_puts(&out, *arg);
+        }
+        else
+        {
+            char *expanded = malloc(strlen(*arg) + 1);
+            if (expanded == NULL)
+            {
+                perror("echo");
+                outbuf_flush(&out);
+                return 1;
+            }
+            bool stopped;
+            outbuf_write(&out, expanded, unescape(expanded, *arg, true, &stopped));
+            free(expanded);
+            if (stopped)
+            {
+                newline = false;
+                break;
+            }
+        }
+        if (arg[1] != NULL)
+        {
+            outbuf_write(&out, " ", 1);
+        }
+    }
+    if (newline)
+    {
+        outbuf_write(&out, "\n", 1);
+    }
+    return outbuf_flush(&out) == 0 ? 0 : 1;
+}
+
+/**
+ * @brief the arguments printf has not used yet, and whether any were bad.
+ */
+typedef struct printfArgs {
+    char **next;
+    bool failed;
+} printfArgs;
+
+/**
+ * @brief returns the next argument, or "" once they run out, as missing
+ * arguments are printed.
+ */
+static const char *nextArg(printfArgs *args)
+{
+    return *args->next == NULL ? "" : *args->next++;
+}
+
+/**
+ * @brief reports an argument that was not entirely a number. The part that
+ * was is still used.
+ */
+static void checkNumber(printfArgs *args, const char *arg, const char *end)
+{
+    if (*end != '\0' || end == arg || errno == ERANGE)
+    {
+        fprintf(stderr, "printf: %s: %s\n", arg, errno == ERANGE ? strerror(ERANGE) : "invalid number");
+        args->failed = true;
+    }
+}
+
+/**
+ * @brief returns the next argument as a signed integer.
+ */
+static long long nextSigned(printfArgs *args)
+{
+    const char *arg = nextArg(args);
+    if (arg[0] == '\'' || arg[0] == '"')
+    {
+        return (unsigned char)arg[1];
+    }
+    if (arg[0] == '\0')
+    {
+        return 0;
+    }
+    char *end;
+    errno = 0;
+    long long value = strtoll(arg, &end, 0);
+    checkNumber(args, arg, end);
+    return value;
+}
+
+/**
+ * @brief returns the next argument as an unsigned integer. A negative one
+ * wraps around, as with strtoull.
+ */
+static unsigned long long nextUnsigned(printfArgs *args)
+{
+    const char *arg = nextArg(args);
+    if (arg[0] == '\'' || arg[0] == '"')
+    {
+        return (unsigned char)arg[1];
+    }
+    if (arg[0] == '\0')
+    {
+        return 0;
+    }
+    char *end;
+    errno = 0;
+    unsigned long long value = strtoull(arg, &end, 0);
+    checkNumber(args, arg, end);
+    return value;
+}
+
+/**
+ * @brief returns the next argument as a floating point number.
+ */
+static double nextDouble(printfArgs *args)
+{
+    const char *arg = nextArg(args);
+    if (arg[0] == '\'' || arg[0] == '"')
+    {
+        return (unsigned char)arg[1];
+    }
+    if (arg[0] == '\0')
+    {
+        return 0;
+    }
+    char *end;
+    errno = 0;
+    double value = strtod(arg, &end);
+    checkNumber(args, arg, end);
+    return value;
+}
+
+#define PRINTF_SPEC_MAX 40 // Room for "%", the flags, two ints, ".", "ll" and a conversion
+
+/**
+ * @brief prints one conversion, whose text starts at the character after the
+ * %. A * width or precision is taken from the arguments and written into the
+ * format given to outbuf_printf, so every conversion has a single argument.
+ *
+ * @return where the format continues, or NULL if it stopped at \c in a %b
+ * argument or the conversion was not valid
+ */
+static const char *putConversion(outBuffer *out, const char *format, printfArgs *args)
+{
+    char spec[PRINTF_SPEC_MAX];
+    size_t len = 0;
+    spec[len++] = '%';
+    size_t flags = strspn(format, "-+ #0");
+    memcpy(spec + len, format, flags < 5 ? flags : 5); // Repeating a flag changes nothing
+    len += flags < 5 ? flags : 5;
+    format += flags;
+
+    for (int part = 0; part < 2; part++)
+    {
+        size_t partStart = len;
+        if (part == 1)
+        {
+            if (*format != '.')
+                break;
+            spec[len++] = *format++;
+        }
+        if (*format == '*')
+        {
+            format++;
+            long long value = nextSigned(args);
+            if (value > INT_MAX || value < -INT_MAX)
+            {
+                fprintf(stderr, "printf: %lld: invalid field width\n", value);
+                args->failed = true;
+                return NULL;
+            }
+            if (part == 1 && value < 0)
+                len = partStart; // A negative precision is as if there were none
+            else
+                len += snprintf(spec + len, PRINTF_SPEC_MAX - len, "%d", (int)value);
+            continue;
+        }
+        size_t digits = strspn(format, "0123456789");
+        if (digits > 9)
+        {
+            fprintf(stderr, "printf: %.*s: invalid field width\n", (int)digits, format);
+            args->failed = true;
+            return NULL;
+        }
+        memcpy(spec + len, format, digits);
+        len += digits;
+        format += digits;
+    }
+
+    char conversion = *format;
+    if (strchr("diuoxX", conversion) != NULL && conversion != '\0')
+    {
+        spec[len++] = 'l';
+        spec[len++] = 'l';
+    }
+    spec[len++] = conversion == 'b' || conversion == 'c' ? 's' : conversion;
+    spec[len] = '\0';
+
+    // The format is built here, but each case passes the type its conversion needs
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wformat-nonliteral"
+    switch (conversion)
+    {
+    case 'd':
+    case 'i':
+        outbuf_printf(out, spec, nextSigned(args));
+        break;
+    case 'u':
+    case 'o':
+    case 'x':
+    case 'X':
+        outbuf_printf(out, spec, nextUnsigned(args));
+        break;
+    case 'e':
+    case 'E':
+    case 'f':
+    case 'F':
+    case 'g':
+    case 'G':
+        outbuf_printf(out, spec, nextDouble(args));
+        break;
+    case 's':
+        outbuf_printf(out, spec, nextArg(args));
+        break;
+    case 'c':
+    {
+        char single[2] = {nextArg(args)[0], '\0'};
+        outbuf_printf(out, spec, single);
+        break;
+    }
+    case 'b':
+    {   // Expand the escapes first, so the width and precision apply to the result
+        const char *value = nextArg(args);
+        char *expanded = malloc(strlen(value) + 1);
+        if (expanded == NULL)
+        {
+            perror("printf");
+            args->failed = true;
+            return NULL;
+        }
+        bool stopped;
+        unescape(expanded, value, true, &stopped);
+        outbuf_printf(out, spec, expanded);
+        free(expanded);
+        if (stopped)
+        {
+            return NULL;
+        }
+        break;
+    }
+    default:
+        fprintf(stderr, "printf: %%%c: invalid directive\n", conversion == '\0' ? ' ' : conversion);
+        args->failed = true;
+        return NULL;
+    }
+#pragma GCC diagnostic pop
+    return format + 1;
+}
+
+int printf_builtin(char **argv)
+{
+    if (argv[1] == NULL)
+    {
+        fprintf(stderr, "printf: usage: printf format [arguments]\n");
+        return 1;
+    }
+    const char *format = argv[1];
+    printfArgs args = {argv + 2, false};
+
+    outBuffer out;
+    outbuf_init(&out, STDOUT_FILENO);
+    bool stopped = false;
+    do
+    {
+        char **before = args.next;
+        const char *text = format;
+        while (*text != '\0' && !stopped)
+        {
+            size_t plain = strcspn(text, "\\%");
+            outbuf_write(&out, text, plain);
+            text += plain;
+            if (*text == '\\')
+            {
+                int value;
+                text = parseEscape(text + 1, false, &value);
+                if (value == ESCAPE_STOP)
+                {
+                    stopped = true;
+                    break;
+                }
+                char byte = (char)value;
+                outbuf_write(&out, &byte, 1);
+            }
+            else if (*text == '%' && text[1] == '%')
+            {
+                outbuf_write(&out, "%", 1);
+                text += 2;
+            }
+            else if (*text == '%')
+            {
+                // NULL is a bad directive, which set args.failed, or %b reaching \c
+                text = putConversion(&out, text + 1, &args);
+                if (text == NULL)
+                {
+                    stopped = true;
+                    break;
+                }
+            }
+        }
+        // The format is used again for the rest, unless it never used any
+        if (args.next == before)
+        {
+            break;
+        }
+    } while (*args.next != NULL && !stopped);
+
+    int flushed = outbuf_flush(&out);
+    return flushed == 0 && !args.failed ? 0 : 1;
+}
+
+#define TEST_TRUE 0
+#define TEST_FALSE 1
+#define TEST_ERROR 2
+
+/**
+ * @brief a test expression being evaluated, and whether it was valid.
+ */
+typedef struct testParser {
+    char **args;
+    size_t pos;
+    size_t count;
+    bool error;
+} testParser;
+
+/**
+ * @brief reports an expression that is not valid. Only the first problem is
+ * reported.
+ */
+static bool testError(testParser *p, const char *arg, const char *message)
+{
+    if (!p->error)
+    {
+        if (arg == NULL)
+            fprintf(stderr, "test: %s\n", message);
+        else
+            fprintf(stderr, "test: %s: %s\n", arg, message);
+    }
+    p->error = true;
+    return false;
+}
+
+static const char *const binaryOperators[] = {"=", "==", "!=", "-eq", "-ne", "-lt", "-le", "-gt", "-ge",
+                                              "-nt", "-ot", "-ef", "<", ">"};
+
+static bool isBinaryOperator(const char *arg)
+{
+    for (size_t idx = 0; idx < sizeof(binaryOperators) / sizeof(binaryOperators[0]); idx++)
+    {
+        if (strcmp(arg, binaryOperators[idx]) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool isUnaryOperator(const char *arg)
+{
+    return arg[0] == '-' && arg[1] != '\0' && arg[2] == '\0' && strchr("bcdefghkLnprsStuwxzOG", arg[1]) != NULL;
+}
+
+/**
+ * @brief returns true if the argument at pos is followed by a binary operator
+ * and its right operand, which takes precedence over !, ( and the unary
+ * operators, so "test ! = x" compares two strings.
+ */
+static bool atBinary(const testParser *p)
+{
+    return p->pos + 2 < p->count && isBinaryOperator(p->args[p->pos + 1]);
+}
+
+/**
+ * @brief parses an integer operand of -eq and the like.
+ */
+static long long testInteger(testParser *p, const char *arg)
+{
+    char *end;
+    errno = 0;
+    long long value = strtoll(arg, &end, 10);
+    while (*end == ' ' || *end == '\t')
+    {
+        end++;
+    }
+    if (end == arg || *end != '\0' || errno == ERANGE)
+    {
+        testError(p, arg, "integer expression expected");
+    }
+    return value;
+}
+
+static bool fileTest(char op, const char *path)
+{
+    struct stat info;
+    if (op == 'h' || op == 'L')
+    {
+        return lstat(path, &info) == 0 && S_ISLNK(info.st_mode);
+    }
+    if (op == 'r' || op == 'w' || op == 'x')
+    {
+        return access(path, op == 'r' ? R_OK : op == 'w' ? W_OK : X_OK) == 0;
+    }
+    if (op == 't')
+    {
+        char *end;
+        long fd = strtol(path, &end, 10);
+        return end != path && *end == '\0' && fd >= 0 && fd <= INT_MAX && isatty((int)fd);
+    }
+    if (stat(path, &info) != 0)
+    {
+        return false;
+    }
+    switch (op)
+    {
+    case 'b':
+        return S_ISBLK(info.st_mode);
+    case 'c':
+        return S_ISCHR(info.st_mode);
+    case 'd':
+        return S_ISDIR(info.st_mode);
+    case 'f':
+        return S_ISREG(info.st_mode);
+    case 'g':
+        return (info.st_mode & S_ISGID) != 0;
+    case 'k':
+        return (info.st_mode & S_ISVTX) != 0;
+    case 'p':
+        return S_ISFIFO(info.st_mode);
+    case 's':
+        return info.st_size > 0;
+    case 'S':
+        return S_ISSOCK(info.st_mode);
+    case 'u':
+        return (info.st_mode & S_ISUID) != 0;
+    case 'O':
+        return info.st_uid == geteuid();
+    case 'G':
+        return info.st_gid == getegid();
+    default: // 'e'
+        return true;
+    }
+}
+
+/**
+ * @brief returns true if left was modified after right. A file that does not
+ * exist is older than one that does.
+ */
+static bool newerThan(const char *left, const char *right)
+{
+    struct stat leftInfo;
+    struct stat rightInfo;
+    if (stat(left, &leftInfo) != 0)
+    {
+        return false;
+    }
+    if (stat(right, &rightInfo) != 0)
+    {
+        return true;
+    }
+    if (leftInfo.st_mtim.tv_sec != rightInfo.st_mtim.tv_sec)
+    {
+        return leftInfo.st_mtim.tv_sec > rightInfo.st_mtim.tv_sec;
+    }
+    return leftInfo.st_mtim.tv_nsec > rightInfo.st_mtim.tv_nsec;
+}
+
+static bool binaryTest(testParser *p, const char *left, const char *op, const char *right)
+{
+    if (strcmp(op, "=") == 0 || strcmp(op, "==") == 0)
+        return strcmp(left, right) == 0;
+    if (strcmp(op, "!=") == 0)
+        return strcmp(left, right) != 0;
+    if (strcmp(op, "<") == 0)
+        return strcmp(left, right) < 0;
+    if (strcmp(op, ">") == 0)
+        return strcmp(left, right) > 0;
+    if (strcmp(op, "-nt") == 0)
+        return newerThan(left, right);
+    if (strcmp(op, "-ot") == 0)
+        return newerThan(right, left);
+    if (strcmp(op, "-ef") == 0)
+    {
+        struct stat leftInfo;
+        struct stat rightInfo;
+        return stat(left, &leftInfo) == 0 && stat(right, &rightInfo) == 0 &&
+               leftInfo.st_dev == rightInfo.st_dev && leftInfo.st_ino == rightInfo.st_ino;
+    }
+
+    long long a = testInteger(p, left);
+    long long b = testInteger(p, right);
+    if (strcmp(op, "-eq") == 0)
+        return a == b;
+    if (strcmp(op, "-ne") == 0)
+        return a != b;
+    if (strcmp(op, "-lt") == 0)
+        return a < b;
+    if (strcmp(op, "-le") == 0)
+        return a <= b;
+    if (strcmp(op, "-gt") == 0)
+        return a > b;
+    return a >= b; // "-ge"
+}
+
+static bool testOr(testParser *p);
+
+/**
+ * @brief a single test: a binary or unary one, a parenthesized expression,
+ * or a string, which is true if it is not empty.
+ */
+static bool testPrimary(testParser *p)
+{
+    if (p->pos >= p->count)
+    {
+        return testError(p, NULL, "argument expected");
+    }
+    char **args = p->args + p->pos;
+    if (atBinary(p))
+    {
+        p->pos += 3;
+        return binaryTest(p, args[0], args[1], args[2]);
+    }
+    if (strcmp(args[0], "(") == 0 && p->pos + 1 < p->count)
+    {
+        p->pos++;
+        bool value = testOr(p);
+        if (p->pos >= p->count || strcmp(p->args[p->pos], ")") != 0)
+        {
+            return testError(p, NULL, "`)' expected");
+        }
+        p->pos++;
+        return value;
+    }
+    if (isUnaryOperator(args[0]) && p->pos + 1 < p->count)
+    {
+        p->pos += 2;
+        if (args[0][1] == 'n')
+            return args[1][0] != '\0';
+        if (args[0][1] == 'z')
+            return args[1][0] == '\0';
+        return fileTest(args[0][1], args[1]);
+    }
+    p->pos++;
+    return args[0][0] != '\0';
+}
+
+static bool testNot(testParser *p)
+{
+    if (p->pos + 1 < p->count && strcmp(p->args[p->pos], "!") == 0 && !atBinary(p))
+    {
+        p->pos++;
+        return !testNot(p);
+    }
+    return testPrimary(p);
+}
+
+static bool testAnd(testParser *p)
+{
+    bool value = testNot(p);
+    while (p->pos + 1 < p->count && strcmp(p->args[p->pos], "-a") == 0)
+    {
+        p->pos++;
+        bool right = testNot(p); // Both sides are always parsed, to find errors
+        value = value && right;
+    }
+    return value;
+}
+
+static bool testOr(testParser *p)
+{
+    bool value = testAnd(p);
+    while (p->pos + 1 < p->count && strcmp(p->args[p->pos], "-o") == 0)
+    {
+        p->pos++;
+        bool right = testAnd(p);
+        value = value || right;
+    }
+    return value;
+}
+
+int test_builtin(char **argv)
+{
+    size_t count = 0;
+    while (argv[count + 1] != NULL)
+    {
+        count++;
+    }
+    if (strcmp(argv[0], "[") == 0)
+    {
+        if (count == 0 || strcmp(argv[count], "]") != 0)
+        {
+            fprintf(stderr, "[: missing `]'\n");
+            return TEST_ERROR;
+        }
+        count--;
+    }
+    if (count == 0)
+    {
+        return TEST_FALSE;
+    }
+
+    testParser p = {argv + 1, 0, count, false};
+    bool value = testOr(&p);
+    if (!p.error && p.pos < p.count)
+    {
+        testError(&p, p.args[p.pos], "unexpected argument");
+    }
+    if (p.error)
+    {
+        return TEST_ERROR;
+    }
+    return value ? TEST_TRUE : TEST_FALSE;
+}
+
+int pwd_builtin(char **argv)
+{
+    (void)argv;
+    char *cwd = getcwd(NULL, 0);
+    if (cwd == NULL)
+    {
+        perror("pwd");
+        return 1;
+    }
+    outBuffer out;
+    outbuf_init(&out, STDOUT_FILENO);
+    outbuf_puts(&out, cwd);
+    outbuf_write(&out, "\n", 1);
+    free(cwd);
+    return outbuf_flush(&out) == 0 ? 0 : 1;
+}
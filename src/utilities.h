@@ -0,0 +1,60 @@
+#ifndef UTILITIES_H
+#define UTILITIES_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /**
+     * @brief the echo builtin: prints its arguments separated by spaces and
+     * followed by a newline. Leading options made only of n, e and E leave out
+     * the newline (-n), or turn backslash escapes on (-e) or off (-E, the
+     * default), like bash.
+     *
+     * @param argv the command, starting with "echo"
+     * @return 0, or 1 if the output could not be written
+     */
+    int echo_builtin(char **argv);
+
+    /**
+     * @brief the printf builtin:
+     *
+     *   printf format [argument...]
+     *
+     * prints the arguments as format says, reusing format until they run out.
+     * It knows the backslash escapes, and the conversions %s, %b, %c, %d, %i,
+     * %u, %o, %x, %X, %e, %E, %f, %F, %g, %G and %% with their flags, width
+     * and precision. A numeric argument starting with a quote is the value of
+     * the character after it.
+     *
+     * @param argv the command, starting with "printf"
+     * @return 0, or 1 if an argument was not a valid number, the format was
+     * not valid or the output could not be written
+     */
+    int printf_builtin(char **argv);
+
+    /**
+     * @brief the test and [ builtins: evaluates the POSIX file, string and
+     * integer tests, combined with !, -a, -o and parentheses. [ needs ] as
+     * its last argument.
+     *
+     * @param argv the command, starting with "test" or "["
+     * @return 0 if the expression is true, 1 if it is false, or 2 if it is not
+     * valid
+     */
+    int test_builtin(char **argv);
+
+    /**
+     * @brief the pwd builtin: prints the current directory.
+     *
+     * @param argv the command, starting with "pwd"
+     * @return 0, or 1 if the directory could not be found or printed
+     */
+    int pwd_builtin(char **argv);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif
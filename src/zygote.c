@@ -0,0 +1,668 @@
+#define _GNU_SOURCE
+#include "zygote.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+extern char **environ;
+
+#define ZYGOTE_SOCKET_FD 3 // Where the zygote keeps its end of the socket
+#define ZYGOTE_MAX_FDS 64  // Descriptors one request may carry
+#define ZYGOTE_MAX_OPS 128 // Descriptor changes one request may make
+#define ZYGOTE_STACK_SIZE (256 * 1024) // For the child until it execs
+
+/**
+ * @brief the fixed part of a request, followed by opCount zygoteOps and
+ * textSize bytes of strings: the path, the arguments and then the
+ * environment, each NUL terminated. The descriptors come with it as
+ * SCM_RIGHTS, the first being the working directory.
+ */
+typedef struct zygoteHeader {
+    uint32_t textSize;
+    uint32_t argc;
+    uint32_t envc;
+    uint32_t opCount;
+    int32_t pgid;
+    int32_t isForeground;
+} zygoteHeader;
+
+/**
+ * @brief what a zygoteOp does to the child's descriptor fd.
+ */
+typedef enum zygoteOpKind {
+    ZYGOTE_INSTALL,  // Make it a copy of the source'th descriptor sent
+    ZYGOTE_DUP,      // Make it a copy of the child's descriptor source
+    ZYGOTE_CLOSE,    // Close it
+} zygoteOpKind;
+
+typedef struct zygoteOp {
+    int32_t kind;
+    int32_t fd;
+    int32_t source;
+} zygoteOp;
+
+typedef struct zygoteReply {
+    int32_t pid;
+    int32_t error;  // The errno of a failed clone, or 0
+} zygoteReply;
+
+/**
+ * @brief a request as the zygote received it.
+ */
+typedef struct zygoteRequest {
+    zygoteHeader header;
+    zygoteOp ops[ZYGOTE_MAX_OPS];
+    int fds[ZYGOTE_MAX_FDS];
+    size_t fdCount;
+    char *text;
+    char **argv;  // argc arguments, then envc variables, each list NULL terminated
+} zygoteRequest;
+
+static int zygoteFd = -1;
+static char *textBuffer;  // The strings of the request being sent, kept between launches
+static size_t textCapacity;
+
+/**
+ * @brief reads exactly len bytes, retrying after short reads.
+ *
+ * @return 0 on success, or -1 on an error or end of file
+ */
+static int readAll(int fd, void *data, size_t len)
+{
+    char *next = data;
+    while (len > 0)
+    {
+        ssize_t got = read(fd, next, len);
+        if (got == -1 && errno == EINTR)
+        {
+            continue;
+        }
+        if (got <= 0)
+        {
+            return -1;
+        }
+        next += got;
+        len -= (size_t)got;
+    }
+    return 0;
+}
+
+/**
+ * @brief sends exactly len bytes without raising SIGPIPE if the other end
+ * is gone.
+ */
+static int sendAll(int fd, const void *data, size_t len)
+{
+    const char *next = data;
+    while (len > 0)
+    {
+        ssize_t sent = send(fd, next, len, MSG_NOSIGNAL);
+        if (sent == -1 && errno == EINTR)
+        {
+            continue;
+        }
+        if (sent == -1)
+        {
+            return -1;
+        }
+        next += sent;
+        len -= (size_t)sent;
+    }
+    return 0;
+}
+
+/**
+ * @brief reads the next request, and the descriptors that came with it.
+ *
+ * @return 0 on success, or -1 if the shell is gone or sent something invalid
+ */
+static int receiveRequest(int sock, zygoteRequest *req)
+{
+    union {
+        char buffer[CMSG_SPACE(sizeof(int) * ZYGOTE_MAX_FDS)];
+        struct cmsghdr align;
+    } control;
+    struct iovec iov = {&req->header, sizeof(req->header)};
+    struct msghdr msg = {0};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buffer;
+    msg.msg_controllen = sizeof(control.buffer);
+
+    ssize_t got;
+    do
+    {
+        got = recvmsg(sock, &msg, MSG_WAITALL | MSG_CMSG_CLOEXEC);
+    } while (got == -1 && errno == EINTR);
+    if (got != (ssize_t)sizeof(req->header) || (msg.msg_flags & MSG_CTRUNC))
+    {
+        return -1;
+    }
+
+    req->fdCount = 0;
+    for (struct cmsghdr *c = CMSG_FIRSTHDR(&msg); c != NULL; c = CMSG_NXTHDR(&msg, c))
+    {
+        if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SCM_RIGHTS)
+        {
+            req->fdCount = (c->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            memcpy(req->fds, CMSG_DATA(c), req->fdCount * sizeof(int));
+        }
+    }
+
+    zygoteHeader *h = &req->header;
+    if (req->fdCount == 0 || h->opCount > ZYGOTE_MAX_OPS ||
+        readAll(sock, req->ops, h->opCount * sizeof(zygoteOp)) != 0)
+    {
+        return -1;
+    }
+    for (uint32_t idx = 0; idx < h->opCount; idx++)
+    {
+        const zygoteOp *op = &req->ops[idx];
+        if (op->fd < 0 || (op->kind == ZYGOTE_INSTALL && (op->source < 0 || (size_t)op->source >= req->fdCount)))
+        {
+            return -1;
+        }
+    }
+    req->text = malloc(h->textSize + 1);
+    req->argv = malloc(sizeof(char *) * ((size_t)h->argc + h->envc + 2));
+    if (req->text == NULL || req->argv == NULL || readAll(sock, req->text, h->textSize) != 0)
+    {
+        return -1;
+    }
+    req->text[h->textSize] = '\0';
+
+    // Point the arguments and variables at the strings after the path
+    char *next = req->text + strlen(req->text) + 1;
+    char *end = req->text + h->textSize;
+    size_t slot = 0;
+    for (uint32_t idx = 0; idx < h->argc + h->envc; idx++)
+    {
+        if (next >= end)
+        {
+            return -1;
+        }
+        if (idx == h->argc)
+        {
+            req->argv[slot++] = NULL;
+        }
+        req->argv[slot++] = next;
+        next += strlen(next) + 1;
+    }
+    if (h->envc == 0)
+    {
+        req->argv[slot++] = NULL;
+    }
+    req->argv[slot] = NULL;
+    return 0;
+}
+
+/**
+ * @brief frees a request and closes its descriptors.
+ */
+static void releaseRequest(zygoteRequest *req)
+{
+    for (size_t idx = 0; idx < req->fdCount; idx++)
+    {
+        close(req->fds[idx]);
+    }
+    req->fdCount = 0;
+    free(req->text);
+    free(req->argv);
+    req->text = NULL;
+    req->argv = NULL;
+}
+
+/**
+ * @brief what the cloned child needs. It shares the zygote's memory until it
+ * execs, so it must change nothing the zygote uses afterwards.
+ */
+typedef struct childArgs {
+    struct shell *sh;
+    const zygoteRequest *req;
+} childArgs;
+
+/**
+ * @brief execs argv[0] from the directories of the $PATH in envp, as execvp
+ * would. The child shares the zygote's memory until it execs, so environ is
+ * never pointed at envp for execvp to search.
+ *
+ * @return only if nothing could be run, with errno set
+ */
+static void execInPath(char **argv, char **envp)
+{
+    const char *path = "/bin:/usr/bin"; // What execvp searches without a $PATH
+    for (char **var = envp; *var != NULL; var++)
+    {
+        if (strncmp(*var, "PATH=", 5) == 0)
+        {
+            path = *var + 5;
+            break;
+        }
+    }
+    if (strchr(argv[0], '/') != NULL)
+    {
+        execve(argv[0], argv, envp);
+        return;
+    }
+
+    size_t nameLen = strlen(argv[0]);
+    bool denied = false;
+    while (true)
+    {
+        const char *end = strchrnul(path, ':');
+        size_t dirLen = (size_t)(end - path);
+        char candidate[PATH_MAX];
+        if (dirLen + 1 + nameLen < sizeof(candidate))
+        {   // An empty entry is the current directory
+            memcpy(candidate, path, dirLen);
+            candidate[dirLen] = '/';
+            memcpy(candidate + (dirLen == 0 ? 0 : dirLen + 1), argv[0], nameLen + 1);
+            execve(candidate, argv, envp);
+            denied = denied || errno == EACCES;
+        }
+        if (*end == '\0')
+        {
+            break;
+        }
+        path = end + 1;
+    }
+    errno = denied ? EACCES : ENOENT;
+}
+
+/**
+ * @brief runs in the cloned child: sets it up like a forked child and execs
+ * the program. Never returns.
+ */
+static int runChild(void *context)
+{
+    const childArgs *args = context;
+    const zygoteRequest *req = args->req;
+
+    // Reply now rather than after the exec, and let the shell have the CPU
+    // if they share one, so it goes on while the exec happens, as it would
+    // after a fork
+    zygoteReply reply = {getpid(), 0};
+    if (sendAll(ZYGOTE_SOCKET_FD, &reply, sizeof(reply)) != 0)
+    {
+        _exit(127);
+    }
+    close(ZYGOTE_SOCKET_FD);
+    sched_yield();
+
+    // Move the descriptors received out of the way of the ones being set
+    int fds[ZYGOTE_MAX_FDS];
+    int lowest = 3;
+    for (uint32_t idx = 0; idx < req->header.opCount; idx++)
+    {
+        const zygoteOp *op = &req->ops[idx];
+        int highest = op->kind == ZYGOTE_DUP && op->source > op->fd ? op->source : op->fd;
+        if (highest >= lowest)
+            lowest = highest + 1;
+    }
+    for (size_t idx = 0; idx < req->fdCount; idx++)
+    {
+        fds[idx] = req->fds[idx];
+        if (fds[idx] < lowest)
+        {
+            fds[idx] = fcntl(req->fds[idx], F_DUPFD_CLOEXEC, lowest);
+            close(req->fds[idx]);
+        }
+    }
+
+    if (fchdir(fds[0]) == -1)
+    {
+        perror("Error changing directory");
+        _exit(126);
+    }
+    launch_setup_child(args->sh, req->header.pgid, req->header.isForeground);
+    for (uint32_t idx = 0; idx < req->header.opCount; idx++)
+    {
+        const zygoteOp *op = &req->ops[idx];
+        int source = op->kind == ZYGOTE_INSTALL ? fds[op->source] : op->source;
+        if (op->kind == ZYGOTE_CLOSE)
+        {
+            close(op->fd);
+        }
+        else if (dup2(source, op->fd) == -1)
+        {
+            fprintf(stderr, "%d: %s\n", op->source, strerror(errno));
+            _exit(1);
+        }
+    }
+
+    char **argv = req->argv;
+    char **envp = argv + req->header.argc + 1;
+    execve(req->text, argv, envp);
+    if (errno == ENOENT)
+    {   // The remembered location went stale, search the shell's $PATH again
+        execInPath(argv, envp);
+    }
+    perror("An error occured while executing the command");
+    _exit(127);
+}
+
+/**
+ * @brief the zygote's loop: clone a child for every request, and reply with
+ * its pid. Exits when the shell closes the socket.
+ */
+static void zygoteMain(struct shell *sh)
+{
+    zygoteRequest *req = calloc(1, sizeof(zygoteRequest));
+    char *stack = mmap(NULL, ZYGOTE_STACK_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+    if (req == NULL || stack == MAP_FAILED)
+    {
+        _exit(1);
+    }
+    while (receiveRequest(ZYGOTE_SOCKET_FD, req) == 0)
+    {
+        // Like posix_spawn, the child borrows the zygote's memory and the
+        // zygote waits until it execs, but its parent is the shell, which can
+        // wait for it
+        childArgs args = {sh, req};
+        pid_t pid = clone(runChild, stack + ZYGOTE_STACK_SIZE, CLONE_VM | CLONE_VFORK | CLONE_PARENT | SIGCHLD, &args);
+        releaseRequest(req);
+        // The child replied itself, unless there is none
+        zygoteReply reply = {-1, errno};
+        if (pid == -1 && sendAll(ZYGOTE_SOCKET_FD, &reply, sizeof(reply)) != 0)
+        {
+            break;
+        }
+    }
+    _exit(0);
+}
+
+int zygote_start(struct shell *sh)
+{
+    if (zygoteFd != -1)
+    {
+        return 0;
+    }
+    int pair[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, pair) == -1)
+    {
+        return -1;
+    }
+
+    pid_t shellPid = getpid();
+    pid_t pid = fork();
+    if (pid == -1)
+    {
+        int savedErrno = errno;
+        close(pair[0]);
+        close(pair[1]);
+        errno = savedErrno;
+        return -1;
+    }
+    if (pid == 0)
+    {
+        // Keep only stdin, stdout, stderr and the socket, so no pipe the
+        // shell has open is held open by the zygote too
+        prctl(PR_SET_PDEATHSIG, SIGKILL);
+        if (getppid() != shellPid)
+        {
+            _exit(0);
+        }
+        if (pair[1] != ZYGOTE_SOCKET_FD)
+        {
+            dup3(pair[1], ZYGOTE_SOCKET_FD, O_CLOEXEC);
+        }
+        close_range(ZYGOTE_SOCKET_FD + 1, ~0U, 0);
+        signal(SIGCHLD, SIG_DFL);
+        zygoteMain(sh);
+    }
+
+    close(pair[1]);
+    zygoteFd = pair[0];
+    return 0;
+}
+
+void zygote_stop(void)
+{
+    if (zygoteFd != -1)
+    {
+        close(zygoteFd);
+        zygoteFd = -1;
+    }
+    free(textBuffer);
+    textBuffer = NULL;
+    textCapacity = 0;
+}
+
+bool zygote_running(void)
+{
+    return zygoteFd != -1;
+}
+
+/**
+ * @brief a request being built by the shell.
+ */
+typedef struct requestBuilder {
+    zygoteOp ops[ZYGOTE_MAX_OPS];
+    size_t opCount;
+    int fds[ZYGOTE_MAX_FDS];
+    size_t fdCount;
+} requestBuilder;
+
+/**
+ * @brief adds an op making the child's fd a copy of the shell's descriptor
+ * source.
+ *
+ * @return 0, or -1 if the request is full
+ */
+static int addInstall(requestBuilder *b, int fd, int source)
+{
+    if (b->opCount == ZYGOTE_MAX_OPS || b->fdCount == ZYGOTE_MAX_FDS)
+    {
+        errno = E2BIG;
+        return -1;
+    }
+    b->ops[b->opCount++] = (zygoteOp){ZYGOTE_INSTALL, fd, (int32_t)b->fdCount};
+    b->fds[b->fdCount++] = source;
+    return 0;
+}
+
+static int addOp(requestBuilder *b, zygoteOpKind kind, int fd, int source)
+{
+    if (b->opCount == ZYGOTE_MAX_OPS)
+    {
+        errno = E2BIG;
+        return -1;
+    }
+    b->ops[b->opCount++] = (zygoteOp){kind, fd, source};
+    return 0;
+}
+
+/**
+ * @brief returns true if an earlier op set the child's descriptor fd, so a
+ * redirection like 2>&1 can copy it inside the child.
+ */
+static bool childHasFd(const requestBuilder *b, int fd)
+{
+    for (size_t idx = 0; idx < b->opCount; idx++)
+    {
+        if (b->ops[idx].fd == fd)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief turns io into the ops that give the child the descriptors a forked
+ * child would have: stdin, stdout and stderr, then each redirection in
+ * order. A copy of a descriptor the child does not have yet, like 2>&5, is
+ * sent the shell's.
+ */
+static int buildOps(requestBuilder *b, int cwdFd, const stageIo *io)
+{
+    b->opCount = 0;
+    b->fdCount = 0;
+    b->fds[b->fdCount++] = cwdFd;
+    if (addInstall(b, STDIN_FILENO, io->in) != 0 || addInstall(b, STDOUT_FILENO, io->out) != 0 ||
+        addInstall(b, STDERR_FILENO, STDERR_FILENO) != 0)
+    {
+        return -1;
+    }
+    for (size_t idx = 0; idx < io->redirectCount; idx++)
+    {
+        const redirection *r = &io->redirects[idx];
+        int result;
+        if (r->kind == REDIRECT_CLOSE)
+            result = addOp(b, ZYGOTE_CLOSE, r->fd, -1);
+        else if (r->kind != REDIRECT_DUP)
+            result = addInstall(b, r->fd, r->source);
+        else if (childHasFd(b, r->source) || fcntl(r->source, F_GETFD) == -1)
+            result = addOp(b, ZYGOTE_DUP, r->fd, r->source);
+        else
+            result = addInstall(b, r->fd, r->source);
+        if (result != 0)
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief copies the path, then argv and the environment, into textBuffer,
+ * each NUL terminated, counting them in header.
+ *
+ * @return 0, or -1 if memory ran out
+ */
+static int packText(zygoteHeader *header, const char *path, char **argv)
+{
+    size_t size = strlen(path) + 1;
+    for (char **arg = argv; *arg != NULL; arg++)
+    {
+        header->argc++;
+        size += strlen(*arg) + 1;
+    }
+    for (char **var = environ; *var != NULL; var++)
+    {
+        header->envc++;
+        size += strlen(*var) + 1;
+    }
+    if (size > textCapacity)
+    {
+        char *grown = realloc(textBuffer, size);
+        if (grown == NULL)
+        {
+            return -1;
+        }
+        textBuffer = grown;
+        textCapacity = size;
+    }
+
+    char *end = stpcpy(textBuffer, path) + 1;
+    for (char **arg = argv; *arg != NULL; arg++)
+    {
+        end = stpcpy(end, *arg) + 1;
+    }
+    for (char **var = environ; *var != NULL; var++)
+    {
+        end = stpcpy(end, *var) + 1;
+    }
+    header->textSize = (uint32_t)size;
+    return 0;
+}
+
+/**
+ * @brief sends a request with one sendmsg: the header and ops, with the
+ * descriptors attached, then the strings in textBuffer.
+ */
+static int sendRequest(const zygoteHeader *header, const requestBuilder *b)
+{
+    char message[sizeof(zygoteHeader) + sizeof(zygoteOp) * ZYGOTE_MAX_OPS];
+    size_t messageSize = sizeof(zygoteHeader) + sizeof(zygoteOp) * b->opCount;
+    memcpy(message, header, sizeof(zygoteHeader));
+    memcpy(message + sizeof(zygoteHeader), b->ops, sizeof(zygoteOp) * b->opCount);
+
+    union {
+        char buffer[CMSG_SPACE(sizeof(int) * ZYGOTE_MAX_FDS)];
+        struct cmsghdr align;
+    } control;
+    memset(&control, 0, sizeof(control));
+    struct iovec iov[2] = {{message, messageSize}, {textBuffer, header->textSize}};
+    struct msghdr msg = {0};
+    msg.msg_iov = iov;
+    msg.msg_iovlen = 2;
+    msg.msg_control = control.buffer;
+    msg.msg_controllen = CMSG_SPACE(sizeof(int) * b->fdCount);
+    struct cmsghdr *c = CMSG_FIRSTHDR(&msg);
+    c->cmsg_level = SOL_SOCKET;
+    c->cmsg_type = SCM_RIGHTS;
+    c->cmsg_len = CMSG_LEN(sizeof(int) * b->fdCount);
+    memcpy(CMSG_DATA(c), b->fds, sizeof(int) * b->fdCount);
+
+    ssize_t sent;
+    do
+    {
+        sent = sendmsg(zygoteFd, &msg, MSG_NOSIGNAL);
+    } while (sent == -1 && errno == EINTR);
+    if (sent == -1)
+    {
+        return -1;
+    }
+    // The descriptors went with the first byte, so the rest can be sent plainly
+    size_t done = (size_t)sent;
+    if (done < messageSize && sendAll(zygoteFd, message + done, messageSize - done) != 0)
+    {
+        return -1;
+    }
+    done = done > messageSize ? done - messageSize : 0;
+    return sendAll(zygoteFd, textBuffer + done, header->textSize - done);
+}
+
+pid_t zygote_launch(struct shell *sh, const char *path, char **argv, bool isForeground, const stageIo *io)
+{
+    if (zygoteFd == -1 && zygote_start(sh) != 0)
+    {
+        return -1;
+    }
+
+    zygoteHeader header = {0, 0, 0, 0, io->pgid, isForeground};
+    if (packText(&header, path, argv) != 0)
+    {
+        return -1;
+    }
+    int cwdFd = open(".", O_PATH | O_DIRECTORY | O_CLOEXEC);
+    if (cwdFd == -1)
+    {
+        return -1;
+    }
+    requestBuilder b;
+    if (buildOps(&b, cwdFd, io) != 0)
+    {
+        close(cwdFd);
+        return -1;
+    }
+    header.opCount = (uint32_t)b.opCount;
+
+    zygoteReply reply;
+    int sent = sendRequest(&header, &b);
+    close(cwdFd);
+    if (sent != 0 || readAll(zygoteFd, &reply, sizeof(reply)) != 0)
+    {   // The zygote is gone, so the next launch starts a new one
+        zygote_stop();
+        errno = ECONNRESET;
+        return -1;
+    }
+    if (reply.pid == -1)
+    {
+        errno = reply.error;
+        return -1;
+    }
+    return reply.pid;
+}
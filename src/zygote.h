@@ -0,0 +1,61 @@
+#ifndef ZYGOTE_H
+#define ZYGOTE_H
+#include <stdbool.h>
+#include <sys/types.h>
+
+#include "lab.h"
+#include "launch.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /**
+     * @brief forks the zygote, a helper process that starts commands for the
+     * shell. It is meant to be started right after sh_init, while the shell
+     * is still small: each command it starts is cloned from the zygote
+     * instead of the shell, with CLONE_PARENT so it is still the shell's
+     * child, so launching no longer gets slower as the shell's heap grows.
+     * The zygote keeps a copy of sh, and only the shell's stdin, stdout and
+     * stderr. Does nothing if it is already running.
+     *
+     * @param sh the shell
+     * @return 0 on success, or -1 with errno set
+     */
+    int zygote_start(struct shell *sh);
+
+    /**
+     * @brief tells the zygote to exit by closing the shell's end of its
+     * socket. The zygote is reaped like any other child.
+     */
+    void zygote_stop(void);
+
+    /**
+     * @brief returns true if the zygote is running.
+     */
+    bool zygote_running(void);
+
+    /**
+     * @brief has the zygote start a program. The program's path, arguments,
+     * environment and working directory, and the descriptors io needs, are
+     * sent over a Unix socket with SCM_RIGHTS. The child then joins its
+     * process group, takes the terminal, resets its signals, applies the
+     * descriptors and execs, as a forked child would. The zygote is started
+     * first if it is not running.
+     *
+     * @param sh the shell
+     * @param path the program to run
+     * @param argv the program's arguments, NULL terminated
+     * @param isForeground whether the child should get the terminal
+     * @param io the child's descriptors and process group
+     * @return the child's pid, or -1 with errno set if the zygote could not
+     * start it or could not be reached
+     */
+    pid_t zygote_launch(struct shell *sh, const char *path, char **argv, bool isForeground, const stageIo *io);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif
@@ -1,8 +1,32 @@
 #define RUNNING 1
 
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
 #include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
 #include "harness/unity.h"
 #include "../src/lab.h"
+#include "../src/tokenizer.h"
+#include "../src/lexscan.h"
+#include "../src/pathcache.h"
+#include "../src/options.h"
+#include "../src/launch.h"
+#include "../src/reaper.h"
+#include "../src/jobs.h"
+#include "../src/histfile.h"
+#include "../src/histindex.h"
+#include "../src/linereader.h"
+#include "../src/redirect.h"
+#include "../src/parallel.h"
+#include "../src/usage.h"
+#include "../src/shstat.h"
+#include "../src/utilities.h"
+#include "../src/zygote.h"
+#include "../src/eventloop.h"
+#include "../src/server.h"
 
 
 void setUp(void) {
@@ -37,6 +61,8 @@ void test_cmd_parse2(void)
      free(expected[0]);
      free(expected[1]);
      free(expected);
+     free(stng);
+     cmd_free(actual);
 }
 
 void test_cmd_parse(void)
@@ -51,6 +77,123 @@ void test_cmd_parse(void)
      cmd_free(rval);
 }
 
+void test_cmd_parse_tabs_and_repeated_spaces(void)
+{
+     char **rval = cmd_parse(" \tls  \t-a\t\t-l   ");
+     TEST_ASSERT_TRUE(rval);
+     TEST_ASSERT_EQUAL_STRING("ls", rval[0]);
+     TEST_ASSERT_EQUAL_STRING("-a", rval[1]);
+     TEST_ASSERT_EQUAL_STRING("-l", rval[2]);
+     TEST_ASSERT_FALSE(rval[3]);
+     cmd_free(rval);
+}
+
+void test_cmd_parse_blank(void)
+{
+     char **rval = cmd_parse("   ");
+     TEST_ASSERT_TRUE(rval);
+     TEST_ASSERT_FALSE(rval[0]);
+     cmd_free(rval);
+}
+
+void test_cmd_parse_1mb_line(void)
+{
+     // 131072 tokens of "abcdefg " make a 1 MiB line
+     const size_t len = 1 << 20;
+     char *line = (char*) malloc(len + 1);
+     for (size_t i = 0; i < len; i++)
+     {
+          line[i] = (i % 8 == 7) ? ' ' : 'a' + i % 8;
+     }
+     line[len] = '\0';
+
+     char **rval = cmd_parse(line);
+     TEST_ASSERT_TRUE(rval);
+     size_t count = 0;
+     while (rval[count] != NULL)
+     {
+          TEST_ASSERT_EQUAL_STRING("abcdefg", rval[count]);
+          count++;
+     }
+     TEST_ASSERT_EQUAL_UINT(len / 8, count);
+     cmd_free(rval);
+     free(line);
+}
+
+void test_tokenize_spans(void)
+{
+     tokenizer t = {NULL, 0, 0};
+     const char *line = "  echo\thello   world ";
+     TEST_ASSERT_EQUAL_INT(3, tokenize(&t, line, strlen(line)));
+     TEST_ASSERT_EQUAL_UINT32(2, t.spans[0].offset);
+     TEST_ASSERT_EQUAL_UINT32(4, t.spans[0].length);
+     TEST_ASSERT_EQUAL_UINT32(7, t.spans[1].offset);
+     TEST_ASSERT_EQUAL_UINT32(5, t.spans[1].length);
+     TEST_ASSERT_EQUAL_UINT32(15, t.spans[2].offset);
+     TEST_ASSERT_EQUAL_UINT32(5, t.spans[2].length);
+     tokenizer_destroy(&t);
+}
+
+void test_tokenize_operators(void)
+{
+     tokenizer t = {NULL, 0, 0};
+     const char *line = "a|b||c&d&&e;f<g>h>>i 2>&1<&0";
+     const uint8_t kinds[] = {TOKEN_WORD, TOKEN_PIPE, TOKEN_WORD, TOKEN_OR_IF, TOKEN_WORD,
+                              TOKEN_AMP, TOKEN_WORD, TOKEN_AND_IF, TOKEN_WORD, TOKEN_SEMI,
+                              TOKEN_WORD, TOKEN_LESS, TOKEN_WORD, TOKEN_GREAT, TOKEN_WORD,
+                              TOKEN_DGREAT, TOKEN_WORD, TOKEN_WORD, TOKEN_GREATAND, TOKEN_WORD,
+                              TOKEN_LESSAND, TOKEN_WORD};
+     TEST_ASSERT_EQUAL_INT(sizeof(kinds), tokenize(&t, line, strlen(line)));
+     for (size_t i = 0; i < sizeof(kinds); i++)
+     {
+          TEST_ASSERT_EQUAL_UINT8(kinds[i], t.spans[i].kind);
+     }
+     tokenizer_destroy(&t);
+}
+
+void test_cmd_parse_quotes(void)
+{
+     char **rval = cmd_parse("echo 'a  b' \"c \\\"d\\\"\" e\\ f 'x|y'&");
+     TEST_ASSERT_TRUE(rval);
+     TEST_ASSERT_EQUAL_STRING("echo", rval[0]);
+     TEST_ASSERT_EQUAL_STRING("a  b", rval[1]);
+     TEST_ASSERT_EQUAL_STRING("c \"d\"", rval[2]);
+     TEST_ASSERT_EQUAL_STRING("e f", rval[3]);
+     TEST_ASSERT_EQUAL_STRING("x|y", rval[4]);
+     TEST_ASSERT_EQUAL_STRING("&", rval[5]);
+     TEST_ASSERT_FALSE(rval[6]);
+     cmd_free(rval);
+}
+
+void test_lex_scanners_agree(void)
+{
+     // Every implementation must find the same boundaries as the scalar one
+     const char alphabet[] = "abc/._- \t'\"\\&|;<>";
+     const size_t len = 4099;
+     char *line = (char*) malloc(len);
+     srand(452);
+     for (size_t i = 0; i < len; i++)
+     {
+          line[i] = (rand() % 8 == 0) ? alphabet[rand() % (sizeof(alphabet) - 1)] : 'a';
+     }
+
+     const lexImpl impls[] = {LEX_SSE2, LEX_AVX2};
+     for (size_t impl = 0; impl < sizeof(impls) / sizeof(impls[0]); impl++)
+     {
+          for (size_t from = 0; from < len; from += 7)
+          {
+               lex_select(LEX_SCALAR);
+               size_t special = lex_find_special(line, len, from);
+               size_t blanks = lex_skip_blanks(line, len, from);
+               lex_select(impls[impl]);
+               TEST_ASSERT_EQUAL_size_t(special, lex_find_special(line, len, from));
+               TEST_ASSERT_EQUAL_size_t(blanks, lex_skip_blanks(line, len, from));
+          }
+     }
+     lex_select(LEX_AUTO);
+     free(line);
+}
+
 void test_trim_white_no_whitespace(void)
 {
      char *line = (char*) calloc(10, sizeof(char));
@@ -114,6 +257,28 @@ void test_trim_white_mostly_whitespace(void)
      free(line);
 }
 
+void test_trim_white_tabs(void)
+{
+     char *line = (char*) calloc(10, sizeof(char));
+     strncpy(line, "\t ls\t \t", 10);
+     char *rval = trim_white(line);
+     TEST_ASSERT_EQUAL_STRING("ls", rval);
+     free(line);
+}
+
+void test_trim_white_1mb_padding(void)
+{
+     // A short command surrounded by half a MiB of spaces on each side
+     const size_t pad = 1 << 19;
+     char *line = (char*) malloc(2 * pad + 6);
+     memset(line, ' ', 2 * pad + 5);
+     memcpy(line + pad, "ls -a", 5);
+     line[2 * pad + 5] = '\0';
+     char *rval = trim_white(line);
+     TEST_ASSERT_EQUAL_STRING("ls -a", rval);
+     free(line);
+}
+
 void test_get_prompt_default(void)
 {
      char *prompt = get_prompt("MY_PROMPT");
@@ -160,7 +325,1025 @@ void test_ch_dir_root(void)
      free(actual);
      cmd_free(cmd);
 }
+
+void test_pathcache_lookup(void)
+{
+     const char *first = pathcache_lookup("sh");
+     TEST_ASSERT_NOT_NULL(first);
+     TEST_ASSERT_EQUAL_CHAR('/', first[0]);
+     TEST_ASSERT_EQUAL_STRING("/sh", strrchr(first, '/'));
+     TEST_ASSERT_EQUAL_PTR(first, pathcache_lookup("sh")); // Remembered, not searched again
+     TEST_ASSERT_EQUAL_STRING("./x/y", pathcache_lookup("./x/y"));
+     TEST_ASSERT_NULL(pathcache_lookup("no-such-command-anywhere"));
+     pathcache_clear();
+}
+
+void test_pathcache_path_change(void)
+{
+     char *oldPath = strdup(getenv("PATH"));
+     TEST_ASSERT_NOT_NULL(pathcache_lookup("sh"));
+     setenv("PATH", "/nonexistent-dir", true);
+     TEST_ASSERT_NULL(pathcache_lookup("sh"));
+     setenv("PATH", oldPath, true);
+     TEST_ASSERT_NOT_NULL(pathcache_lookup("sh"));
+     pathcache_clear();
+     free(oldPath);
+}
+
+void test_options_set(void)
+{
+     launchMethod saved = options.launcher;
+     TEST_ASSERT_EQUAL_INT(0, options_set("launcher=fork"));
+     TEST_ASSERT_EQUAL_INT(LAUNCH_FORK, options.launcher);
+     TEST_ASSERT_EQUAL_INT(0, options_set("launcher=spawn"));
+     TEST_ASSERT_EQUAL_INT(LAUNCH_SPAWN, options.launcher);
+     TEST_ASSERT_EQUAL_INT(-1, options_set("launcher=vfork"));
+     TEST_ASSERT_EQUAL_INT(-1, options_set("nosuchoption=1"));
+     TEST_ASSERT_EQUAL_INT(LAUNCH_SPAWN, options.launcher);
+     options.launcher = saved;
+}
+
+void test_reaper_wait_keeps_other_exits(void)
+{
+     struct shell sh;
+     memset(&sh, 0, sizeof(sh));
+     char *quick[] = {"true", NULL};
+     char *slow[] = {"sleep", "0.2", NULL};
+     char *failing[] = {"false", NULL};
+
+     reaper_install();
+     pid_t first = launch_process(LAUNCH_SPAWN, &sh, pathcache_lookup("true"), quick, false);
+     pid_t second = launch_process(LAUNCH_FORK, &sh, pathcache_lookup("sleep"), slow, false);
+     pid_t third = launch_process(LAUNCH_SPAWN, &sh, pathcache_lookup("false"), failing, false);
+     TEST_ASSERT_TRUE(first > 0 && second > 0 && third > 0);
+
+     int status = -1;
+     TEST_ASSERT_EQUAL_INT(0, reaper_wait(third, &status));
+     TEST_ASSERT_TRUE(WIFEXITED(status));
+     TEST_ASSERT_EQUAL_INT(1, WEXITSTATUS(status));
+     TEST_ASSERT_EQUAL_INT(0, reaper_wait(second, &status));
+     TEST_ASSERT_EQUAL_INT(0, WEXITSTATUS(status));
+
+     // The first child's exit was set aside while waiting for the others
+     childExit exited;
+     TEST_ASSERT_TRUE(reaper_next(&exited));
+     TEST_ASSERT_EQUAL_INT(first, exited.pid);
+     TEST_ASSERT_FALSE(reaper_next(&exited));
+     signal(SIGCHLD, SIG_DFL);
+     pathcache_clear();
+}
+
+void test_jobs_numbering_and_lookup(void)
+{
+     jobTable table = {NULL, NULL, NULL, 0, NULL, 0, 0, 0, 0, NULL, NULL};
+     jobEntry *first = jobs_add(&table, 100, "a &");
+     jobEntry *second = jobs_add(&table, 200, "b &");
+     jobEntry *third = jobs_add(&table, 300, "c &");
+     TEST_ASSERT_EQUAL_INT(1, first->info.jobNum);
+     TEST_ASSERT_EQUAL_INT(2, second->info.jobNum);
+     TEST_ASSERT_EQUAL_INT(3, third->info.jobNum);
+     TEST_ASSERT_EQUAL_STRING("b &", second->info.command);
+
+     TEST_ASSERT_EQUAL_PTR(second, jobs_find_pid(&table, 200));
+     TEST_ASSERT_EQUAL_PTR(third, jobs_find_num(&table, 3));
+     TEST_ASSERT_NULL(jobs_find_pid(&table, 400));
+
+     // Removing the highest job frees its number, removing another doesn't
+     jobs_remove(&table, second);
+     TEST_ASSERT_NULL(jobs_find_pid(&table, 200));
+     TEST_ASSERT_NULL(jobs_find_num(&table, 2));
+     jobs_remove(&table, third);
+     TEST_ASSERT_EQUAL_INT(2, jobs_add(&table, 500, "d &")->info.jobNum);
+
+     // Iteration stays in the order the jobs were started
+     TEST_ASSERT_EQUAL_PTR(first, table.head);
+     TEST_ASSERT_EQUAL_INT(500, table.head->next->info.pid);
+     TEST_ASSERT_NULL(table.head->next->next);
+     jobs_destroy(&table);
+}
+
+void test_jobs_many(void)
+{
+     jobTable table = {NULL, NULL, NULL, 0, NULL, 0, 0, 0, 0, NULL, NULL};
+     const int count = 10000;
+     for (int i = 1; i <= count; i++)
+     {
+          TEST_ASSERT_NOT_NULL(jobs_add(&table, i * 7, "x &"));
+     }
+     // Remove every other job, then make sure the rest can still be found
+     for (int i = 1; i <= count; i += 2)
+     {
+          jobs_remove(&table, jobs_find_pid(&table, i * 7));
+     }
+     for (int i = 1; i <= count; i++)
+     {
+          jobEntry *entry = jobs_find_pid(&table, i * 7);
+          if (i % 2 == 1)
+               TEST_ASSERT_NULL(entry);
+          else
+               TEST_ASSERT_EQUAL_INT(i, entry->info.jobNum);
+     }
+     TEST_ASSERT_EQUAL_size_t(count / 2, table.count);
+     jobs_destroy(&table);
+}
+
+void test_jobs_queue(void)
+{
+     jobTable table = {NULL, NULL, NULL, 0, NULL, 0, 0, 0, 0, NULL, NULL};
+     jobEntry *running = jobs_add(&table, 100, "a &");
+     jobEntry *firstQueued = jobs_add(&table, 0, "b &");
+     jobs_add(&table, 200, "c &"); // Started right away, like a parallel command
+     jobEntry *secondQueued = jobs_add(&table, 0, "d &");
+     TEST_ASSERT_EQUAL_size_t(2, table.runningCount);
+     TEST_ASSERT_EQUAL_PTR(firstQueued, table.firstQueued);
+     TEST_ASSERT_EQUAL_INT(JOB_QUEUED, firstQueued->info.state);
+     TEST_ASSERT_NULL(jobs_find_pid(&table, 0));
+
+     // A finished job stays listed, but its pid is free for reuse
+     jobs_finish(&table, running);
+     TEST_ASSERT_EQUAL_INT(JOB_DONE, running->info.state);
+     TEST_ASSERT_NULL(jobs_find_pid(&table, 100));
+     TEST_ASSERT_EQUAL_size_t(1, table.doneCount);
+     TEST_ASSERT_EQUAL_size_t(1, table.runningCount);
+
+     // Queued jobs start oldest first
+     jobs_start(&table, firstQueued, 300);
+     TEST_ASSERT_EQUAL_PTR(firstQueued, jobs_find_pid(&table, 300));
+     TEST_ASSERT_EQUAL_PTR(secondQueued, table.firstQueued);
+     TEST_ASSERT_EQUAL_size_t(2, table.runningCount);
+     jobs_start(&table, secondQueued, 400);
+     TEST_ASSERT_NULL(table.firstQueued);
+
+     jobs_remove(&table, running);
+     TEST_ASSERT_EQUAL_size_t(0, table.doneCount);
+     jobs_remove(&table, secondQueued);
+     TEST_ASSERT_EQUAL_size_t(2, table.runningCount);
+     jobs_destroy(&table);
+}
+
+void test_jobs_grow_with_done_and_queued(void)
+{
+     jobTable table = {NULL, NULL, NULL, 0, NULL, 0, 0, 0, 0, NULL, NULL};
+     jobEntry *done = jobs_add(&table, 100, "a &");
+     jobs_finish(&table, done);
+     jobEntry *queued = jobs_add(&table, 0, "b &");
+
+     // Enough running jobs to grow the pid table, which must only take them
+     for (int i = 1; i <= 20; i++)
+     {
+          TEST_ASSERT_NOT_NULL(jobs_add(&table, 1000 + i, "c &"));
+     }
+     jobs_remove(&table, done);
+     jobs_remove(&table, queued);
+     TEST_ASSERT_NULL(jobs_find_pid(&table, 100));
+     TEST_ASSERT_NULL(jobs_find_pid(&table, 0));
+     for (int i = 1; i <= 20; i++)
+     {
+          TEST_ASSERT_NOT_NULL(jobs_find_pid(&table, 1000 + i));
+     }
+     jobs_destroy(&table);
+}
+
+/**
+ * @brief a jobWatcher that counts the jobs it watches, with the pid as the
+ * watch's id.
+ */
+static int countJobWatch(pid_t pid, void *watching)
+{
+     (*(int *)watching)++;
+     return (int)pid;
+}
+
+static void countJobUnwatch(int watch, void *watching)
+{
+     TEST_ASSERT_GREATER_THAN(0, watch);
+     (*(int *)watching)--;
+}
+
+void test_jobs_watcher(void)
+{
+     int watching = 0;
+     const jobWatcher watcher = {countJobWatch, countJobUnwatch, &watching};
+     jobTable table = {NULL, NULL, NULL, 0, NULL, 0, 0, 0, 0, NULL, &watcher};
+
+     // Each running job is watched once, from when it starts until it stops running
+     jobEntry *running = jobs_add(&table, 100, "a &");
+     jobEntry *queued = jobs_add(&table, 0, "b &");
+     TEST_ASSERT_EQUAL_INT(1, watching);
+     TEST_ASSERT_EQUAL_INT(100, running->watch);
+     TEST_ASSERT_EQUAL_INT(-1, queued->watch);
+     jobs_start(&table, queued, 200);
+     TEST_ASSERT_EQUAL_INT(2, watching);
+     jobs_finish(&table, running);
+     TEST_ASSERT_EQUAL_INT(1, watching);
+     TEST_ASSERT_EQUAL_INT(-1, running->watch);
+     jobs_remove(&table, running);
+     jobs_remove(&table, queued);
+     TEST_ASSERT_EQUAL_INT(0, watching);
+     jobs_destroy(&table);
+}
+
+static bool isWantedPid(pid_t pid, void *wanted)
+{
+     return pid == *(pid_t *)wanted;
+}
+
+void test_usage_add(void)
+{
+     struct rusage total;
+     memset(&total, 0, sizeof(total));
+     struct rusage first = {.ru_utime = {1, 600000}, .ru_stime = {0, 100}, .ru_maxrss = 2000, .ru_nvcsw = 3, .ru_nivcsw = 1};
+     struct rusage second = {.ru_utime = {0, 500000}, .ru_stime = {2, 0}, .ru_maxrss = 1000, .ru_nvcsw = 4, .ru_nivcsw = 2};
+     usage_add(&total, &first);
+     usage_add(&total, &second);
+     TEST_ASSERT_EQUAL_INT(2, total.ru_utime.tv_sec);
+     TEST_ASSERT_EQUAL_INT(100000, total.ru_utime.tv_usec);
+     TEST_ASSERT_EQUAL_INT(2, total.ru_stime.tv_sec);
+     TEST_ASSERT_EQUAL_INT(2000, total.ru_maxrss); // Pipeline stages overlap, so the peak is kept
+     TEST_ASSERT_EQUAL_INT(7, total.ru_nvcsw);
+     TEST_ASSERT_EQUAL_INT(3, total.ru_nivcsw);
+
+     // The reaper keeps what each child used
+     struct shell sh;
+     memset(&sh, 0, sizeof(sh));
+     char *argv[] = {"true", NULL};
+     reaper_install();
+     pid_t pid = launch_process(LAUNCH_SPAWN, &sh, pathcache_lookup("true"), argv, false);
+     TEST_ASSERT_TRUE(pid > 0);
+     childExit exited;
+     reaper_wait_matching(isWantedPid, &pid, &exited);
+     TEST_ASSERT_EQUAL_INT(pid, exited.pid);
+     TEST_ASSERT_GREATER_THAN(0, exited.usage.ru_maxrss);
+     signal(SIGCHLD, SIG_DFL);
+     pathcache_clear();
+}
+
+void test_shstat_percentiles(void)
+{
+     char *reset[] = {"shstat", "-r", NULL};
+     shstat_builtin(reset);
+     TEST_ASSERT_EQUAL_UINT64(0, shstat_percentile(SHSTAT_LAUNCH, 50));
+
+     // Small values are exact, larger ones within a bucket's 1/32
+     for (uint64_t value = 1; value <= 10000; value++)
+     {
+          shstat_record(SHSTAT_LAUNCH, value * 1000);
+     }
+     uint64_t median = shstat_percentile(SHSTAT_LAUNCH, 50);
+     TEST_ASSERT_TRUE(median >= 5000000 && median <= 5000000 + 5000000 / 32);
+     uint64_t p99 = shstat_percentile(SHSTAT_LAUNCH, 99);
+     TEST_ASSERT_TRUE(p99 >= 9900000 && p99 <= 9900000 + 9900000 / 32);
+     TEST_ASSERT_EQUAL_UINT64(10000000, shstat_percentile(SHSTAT_LAUNCH, 100));
+     shstat_record(SHSTAT_WAIT, 17);
+     TEST_ASSERT_EQUAL_UINT64(17, shstat_percentile(SHSTAT_WAIT, 50));
+     shstat_builtin(reset);
+}
+
+/**
+ * @brief collects lines loaded from a history file, for the tests below.
+ */
+typedef struct loadedLines {
+     char lines[16][16];
+     int count;
+} loadedLines;
+
+static void collectLine(const char *line, size_t len, void *ctx)
+{
+     loadedLines *loaded = (loadedLines *)ctx;
+     snprintf(loaded->lines[loaded->count++], 16, "%.*s", (int)len, line);
+}
+
+void test_histfile_append_and_load_tail(void)
+{
+     char path[] = "/tmp/test-histfile-XXXXXX";
+     close(mkstemp(path));
+     histFile writer, otherWriter;
+     TEST_ASSERT_EQUAL_INT(0, histfile_open(&writer, path, 100));
+     TEST_ASSERT_EQUAL_INT(0, histfile_open(&otherWriter, path, 100));
+
+     // Two shells appending to the same file
+     char line[16];
+     for (int i = 0; i < 6; i++)
+     {
+          snprintf(line, sizeof(line), "cmd %d", i);
+          TEST_ASSERT_EQUAL_INT(0, histfile_append(i % 2 ? &otherWriter : &writer, line));
+     }
+
+     loadedLines loaded = {.count = 0};
+     TEST_ASSERT_EQUAL_INT(3, histfile_load(&writer, 3, collectLine, &loaded));
+     TEST_ASSERT_EQUAL_STRING("cmd 3", loaded.lines[0]);
+     TEST_ASSERT_EQUAL_STRING("cmd 5", loaded.lines[2]);
+
+     histfile_close(&writer);
+     histfile_close(&otherWriter);
+     unlink(path);
+}
+
+void test_histfile_compact(void)
+{
+     char path[] = "/tmp/test-histfile-XXXXXX";
+     close(mkstemp(path));
+     histFile hf;
+     TEST_ASSERT_EQUAL_INT(0, histfile_open(&hf, path, 4));
+
+     char line[16];
+     for (int i = 0; i < 5; i++)
+     {
+          snprintf(line, sizeof(line), "cmd %d", i);
+          histfile_append(&hf, line);
+     }
+     // One line over the limit is within the slack, so nothing changes
+     TEST_ASSERT_EQUAL_INT(0, histfile_compact(&hf));
+     loadedLines loaded = {.count = 0};
+     TEST_ASSERT_EQUAL_INT(5, histfile_load(&hf, 16, collectLine, &loaded));
+
+     for (int i = 5; i < 10; i++)
+     {
+          snprintf(line, sizeof(line), "cmd %d", i);
+          histfile_append(&hf, line);
+     }
+     TEST_ASSERT_EQUAL_INT(0, histfile_compact(&hf));
+     loaded.count = 0;
+     TEST_ASSERT_EQUAL_INT(4, histfile_load(&hf, 16, collectLine, &loaded));
+     TEST_ASSERT_EQUAL_STRING("cmd 6", loaded.lines[0]);
+     TEST_ASSERT_EQUAL_STRING("cmd 9", loaded.lines[3]);
+
+     // Appends keep going at the new end of the file
+     histfile_append(&hf, "cmd 10");
+     loaded.count = 0;
+     TEST_ASSERT_EQUAL_INT(5, histfile_load(&hf, 16, collectLine, &loaded));
+     TEST_ASSERT_EQUAL_STRING("cmd 10", loaded.lines[4]);
+
+     histfile_close(&hf);
+     unlink(path);
+}
+
+/**
+ * @brief collects the ids found by a history search.
+ */
+typedef struct foundIds {
+     uint32_t ids[16];
+     size_t count;
+} foundIds;
+
+static void collectId(uint32_t id, void *ctx)
+{
+     foundIds *found = (foundIds *)ctx;
+     found->ids[found->count++] = id;
+}
+
+void test_histindex_search(void)
+{
+     histIndex index;
+     memset(&index, 0, sizeof(index));
+     const char *entries[] = {"make check", "git commit -m fix", "make bench", "cd /tmp", "git status", "makemake"};
+     for (size_t i = 0; i < sizeof(entries) / sizeof(entries[0]); i++)
+     {
+          TEST_ASSERT_EQUAL_INT(0, histindex_add(&index, entries[i], strlen(entries[i])));
+     }
+
+     foundIds found = {.count = 0};
+     TEST_ASSERT_EQUAL_size_t(3, histindex_search(&index, "make", collectId, &found));
+     TEST_ASSERT_EQUAL_UINT32(0, found.ids[0]);
+     TEST_ASSERT_EQUAL_UINT32(2, found.ids[1]);
+     TEST_ASSERT_EQUAL_UINT32(5, found.ids[2]);
+
+     // Has all the trigrams of "ake m" but not in that order
+     found.count = 0;
+     TEST_ASSERT_EQUAL_size_t(0, histindex_search(&index, "kemake m", collectId, &found));
+
+     // Too short for trigrams
+     found.count = 0;
+     TEST_ASSERT_EQUAL_size_t(2, histindex_search(&index, "gi", collectId, &found));
+     TEST_ASSERT_EQUAL_UINT32(4, found.ids[1]);
+
+     found.count = 0;
+     TEST_ASSERT_EQUAL_size_t(0, histindex_search(&index, "nowhere", collectId, &found));
+
+     size_t len;
+     TEST_ASSERT_EQUAL_STRING("cd /tmp", histindex_entry(&index, 3, &len));
+     TEST_ASSERT_EQUAL_size_t(7, len);
+     histindex_destroy(&index);
+}
+
+void test_histindex_search_short_entries(void)
+{
+     // Entries under 3 bytes have no trigrams, so the trigram table is never made
+     histIndex index;
+     memset(&index, 0, sizeof(index));
+     TEST_ASSERT_EQUAL_INT(0, histindex_add(&index, "ls", 2));
+     TEST_ASSERT_EQUAL_INT(0, histindex_add(&index, "cd", 2));
+     foundIds found = {.count = 0};
+     TEST_ASSERT_EQUAL_size_t(0, histindex_search(&index, "foo", collectId, &found));
+     TEST_ASSERT_EQUAL_size_t(1, histindex_search(&index, "ls", collectId, &found));
+     histindex_destroy(&index);
+}
 #endif
+void test_linereader_string(void)
+{
+     lineReader reader;
+     TEST_ASSERT_EQUAL_INT(0, linereader_open_string(&reader, "ls -a\n\necho hi"));
+     TEST_ASSERT_EQUAL_STRING("ls -a", linereader_next(&reader));
+     TEST_ASSERT_EQUAL_STRING("", linereader_next(&reader));
+     TEST_ASSERT_EQUAL_STRING("echo hi", linereader_next(&reader));
+     TEST_ASSERT_NULL(linereader_next(&reader));
+     linereader_close(&reader);
+}
+
+void test_linereader_file_lines_across_blocks(void)
+{
+     char path[] = "/tmp/test-linereader-XXXXXX";
+     int fd = mkstemp(path);
+     // A line longer than a block, then enough short lines to straddle the next block boundary
+     size_t longLen = LINEREADER_BLOCK * 2 + 10;
+     char *longLine = malloc(longLen + 1);
+     memset(longLine, 'a', longLen);
+     longLine[longLen] = '\n';
+     write(fd, longLine, longLen + 1);
+     char line[32];
+     for (int i = 0; i < 10000; i++)
+     {
+          int len = snprintf(line, sizeof(line), "cmd %d\n", i);
+          write(fd, line, len);
+     }
+     close(fd);
+
+     lineReader reader;
+     TEST_ASSERT_EQUAL_INT(0, linereader_open_file(&reader, path));
+     TEST_ASSERT_EQUAL_size_t(longLen, strlen(linereader_next(&reader)));
+     for (int i = 0; i < 10000; i++)
+     {
+          snprintf(line, sizeof(line), "cmd %d", i);
+          TEST_ASSERT_EQUAL_STRING(line, linereader_next(&reader));
+     }
+     TEST_ASSERT_NULL(linereader_next(&reader));
+     linereader_close(&reader);
+     free(longLine);
+     unlink(path);
+}
+
+void test_cmd_parse_pipeline(void)
+{
+     pipeline parsed;
+     TEST_ASSERT_EQUAL_INT(0, cmd_parse_pipeline("ls -l|grep 'a|b' | wc -l &", &parsed));
+     TEST_ASSERT_EQUAL_size_t(3, parsed.count);
+     TEST_ASSERT_TRUE(parsed.background);
+     TEST_ASSERT_EQUAL_STRING("-l", parsed.commands[0].argv[1]);
+     TEST_ASSERT_EQUAL_STRING("a|b", parsed.commands[1].argv[1]);
+     TEST_ASSERT_NULL(parsed.commands[1].argv[2]);
+     TEST_ASSERT_EQUAL_STRING("wc", parsed.commands[2].argv[0]);
+     TEST_ASSERT_FALSE(parsed.timed);
+     cmd_free(NULL);
+
+     // time is a keyword only when unquoted and followed by a command
+     TEST_ASSERT_EQUAL_INT(0, cmd_parse_pipeline("time ls | wc", &parsed));
+     TEST_ASSERT_TRUE(parsed.timed);
+     TEST_ASSERT_EQUAL_size_t(2, parsed.count);
+     TEST_ASSERT_EQUAL_STRING("ls", parsed.commands[0].argv[0]);
+     TEST_ASSERT_EQUAL_INT(0, cmd_parse_pipeline("'time' ls", &parsed));
+     TEST_ASSERT_FALSE(parsed.timed);
+     TEST_ASSERT_EQUAL_INT(0, cmd_parse_pipeline("time", &parsed));
+     TEST_ASSERT_FALSE(parsed.timed);
+     TEST_ASSERT_EQUAL_STRING("time", parsed.commands[0].argv[0]);
+     cmd_free(NULL);
+
+     TEST_ASSERT_EQUAL_INT(0, cmd_parse_pipeline("   ", &parsed));
+     TEST_ASSERT_EQUAL_size_t(0, parsed.count);
+     const char *invalid[] = {"| ls", "ls |", "ls | | wc", "&", "ls & wc"};
+     for (size_t idx = 0; idx < sizeof(invalid) / sizeof(invalid[0]); idx++)
+     {
+          TEST_ASSERT_EQUAL_INT(-1, cmd_parse_pipeline(invalid[idx], &parsed));
+          TEST_ASSERT_EQUAL_INT(EINVAL, errno);
+     }
+     cmd_free(NULL);
+}
+
+void test_cmd_parse_list(void)
+{
+     commandList list;
+     const char *line = "time a | b && c || d; sleep 1 &e 'x;y'&";
+     TEST_ASSERT_EQUAL_INT(0, cmd_parse_list(line, &list));
+     TEST_ASSERT_EQUAL_size_t(5, list.count);
+     TEST_ASSERT_TRUE(list.pipelines[0].timed);
+     TEST_ASSERT_EQUAL_size_t(2, list.pipelines[0].count);
+     TEST_ASSERT_EQUAL_INT(LIST_AND, list.pipelines[0].next);
+     TEST_ASSERT_EQUAL_INT(LIST_OR, list.pipelines[1].next);
+     TEST_ASSERT_EQUAL_INT(LIST_THEN, list.pipelines[2].next);
+     TEST_ASSERT_FALSE(list.pipelines[2].background);
+     TEST_ASSERT_TRUE(list.pipelines[3].background);
+     TEST_ASSERT_EQUAL_STRING("x;y", list.pipelines[4].commands[0].argv[1]);
+     TEST_ASSERT_TRUE(list.pipelines[4].background);
+
+     // A background pipeline's own text is what its job is parsed from again
+     const pipeline *sleep = &list.pipelines[3];
+     TEST_ASSERT_EQUAL_STRING_LEN("sleep 1 &", line + sleep->sourceStart, sleep->sourceEnd - sleep->sourceStart);
+     const pipeline *last = &list.pipelines[4];
+     TEST_ASSERT_EQUAL_STRING("e 'x;y'&", line + last->sourceStart);
+     TEST_ASSERT_EQUAL_size_t(strlen(line), last->sourceEnd);
+     cmd_free(NULL);
+
+     TEST_ASSERT_EQUAL_INT(0, cmd_parse_list("ls;", &list));
+     TEST_ASSERT_EQUAL_size_t(1, list.count);
+     TEST_ASSERT_EQUAL_INT(0, cmd_parse_list("", &list));
+     TEST_ASSERT_EQUAL_size_t(0, list.count);
+     const char *invalid[] = {"; ls", "ls &&", "ls || ; wc", "ls ;;", "a && b &", "a & && b", "&& ls"};
+     for (size_t idx = 0; idx < sizeof(invalid) / sizeof(invalid[0]); idx++)
+     {
+          TEST_ASSERT_EQUAL_INT(-1, cmd_parse_list(invalid[idx], &list));
+          TEST_ASSERT_EQUAL_INT(EINVAL, errno);
+     }
+     cmd_free(NULL);
+}
+
+/**
+ * @brief runs myprogram -c command and returns its exit status. The shell is
+ * found beside the tests, since the cd tests leave another directory current.
+ */
+static int runShellCommand(const char *command)
+{
+     char shellPath[4096];
+     ssize_t len = readlink("/proc/self/exe", shellPath, sizeof(shellPath) - sizeof("myprogram"));
+     TEST_ASSERT_GREATER_THAN(0, len);
+     shellPath[len] = '\0';
+     strcpy(strrchr(shellPath, '/') + 1, "myprogram");
+
+     pid_t shell = fork();
+     TEST_ASSERT_NOT_EQUAL(-1, shell);
+     if (shell == 0)
+     {
+          execl(shellPath, "myprogram", "-c", command, (char *)NULL);
+          _exit(127);
+     }
+     int status;
+     TEST_ASSERT_EQUAL_INT(shell, waitpid(shell, &status, 0));
+     TEST_ASSERT_TRUE(WIFEXITED(status));
+     return WEXITSTATUS(status);
+}
+
+void test_script_exit_status(void)
+{
+     // The shell exits with the status of the last pipeline it ran
+     TEST_ASSERT_EQUAL_INT(1, runShellCommand("false"));
+     TEST_ASSERT_EQUAL_INT(1, runShellCommand("true && false"));
+     TEST_ASSERT_EQUAL_INT(0, runShellCommand("false || true"));
+     TEST_ASSERT_EQUAL_INT(0, runShellCommand("false; true"));
+     TEST_ASSERT_EQUAL_INT(2, runShellCommand("true &&"));
+}
+
+void test_launch_pipeline_relay_exits(void)
+{
+     struct shell sh;
+     memset(&sh, 0, sizeof(sh));
+     reaper_install();
+
+     // false exits without reading, so yes and the relay have to see a broken pipe
+     pipeline parsed;
+     TEST_ASSERT_EQUAL_INT(0, cmd_parse_pipeline("yes | false", &parsed));
+     parsed.commands[0].path = pathcache_lookup("yes");
+     parsed.commands[1].path = pathcache_lookup("false");
+     options.relay = true;
+     pid_t pids[3];
+     size_t started;
+     TEST_ASSERT_EQUAL_INT(0, launch_pipeline(LAUNCH_SPAWN, &sh, &parsed, true, pids, &started));
+     options.relay = false;
+     TEST_ASSERT_EQUAL_size_t(3, started);
+
+     int status;
+     TEST_ASSERT_EQUAL_INT(0, reaper_wait(pids[2], &status));
+     TEST_ASSERT_EQUAL_INT(1, WEXITSTATUS(status));
+     reaper_wait(pids[1], NULL);
+     TEST_ASSERT_EQUAL_INT(0, reaper_wait(pids[0], &status));
+     TEST_ASSERT_TRUE(WIFSIGNALED(status));
+     TEST_ASSERT_EQUAL_INT(SIGPIPE, WTERMSIG(status));
+     signal(SIGCHLD, SIG_DFL);
+     pathcache_clear();
+     cmd_free(NULL);
+}
+
+void test_cmd_parse_redirections(void)
+{
+     pipeline parsed;
+     TEST_ASSERT_EQUAL_INT(0, cmd_parse_pipeline("sort <in.txt -r 2>&1 >>'out file' 2 >x 3<&-", &parsed));
+     command *cmd = &parsed.commands[0];
+     TEST_ASSERT_EQUAL_STRING("sort", cmd->argv[0]);
+     TEST_ASSERT_EQUAL_STRING("-r", cmd->argv[1]);
+     TEST_ASSERT_EQUAL_STRING("2", cmd->argv[2]); // Not touching the >, so it is an argument
+     TEST_ASSERT_NULL(cmd->argv[3]);
+     TEST_ASSERT_EQUAL_size_t(5, cmd->redirectCount);
+     TEST_ASSERT_EQUAL_INT(REDIRECT_INPUT, cmd->redirects[0].kind);
+     TEST_ASSERT_EQUAL_INT(0, cmd->redirects[0].fd);
+     TEST_ASSERT_EQUAL_STRING("in.txt", cmd->redirects[0].target);
+     TEST_ASSERT_EQUAL_INT(REDIRECT_DUP, cmd->redirects[1].kind);
+     TEST_ASSERT_EQUAL_INT(2, cmd->redirects[1].fd);
+     TEST_ASSERT_EQUAL_INT(1, cmd->redirects[1].source);
+     TEST_ASSERT_EQUAL_INT(REDIRECT_APPEND, cmd->redirects[2].kind);
+     TEST_ASSERT_EQUAL_STRING("out file", cmd->redirects[2].target);
+     TEST_ASSERT_EQUAL_INT(REDIRECT_OUTPUT, cmd->redirects[3].kind);
+     TEST_ASSERT_EQUAL_INT(1, cmd->redirects[3].fd);
+     TEST_ASSERT_EQUAL_INT(REDIRECT_CLOSE, cmd->redirects[4].kind);
+     TEST_ASSERT_EQUAL_INT(3, cmd->redirects[4].fd);
+     cmd_free(NULL);
+
+     const char *invalid[] = {"ls >", "ls > | wc", "> x | wc", "ls >& file"};
+     for (size_t idx = 0; idx < sizeof(invalid) / sizeof(invalid[0]); idx++)
+     {
+          TEST_ASSERT_EQUAL_INT(-1, cmd_parse_pipeline(invalid[idx], &parsed));
+          TEST_ASSERT_EQUAL_INT(EINVAL, errno);
+     }
+     cmd_free(NULL);
+}
+
+void test_redirect_apply_and_restore(void)
+{
+     char path[] = "/tmp/test-redirect-XXXXXX";
+     close(mkstemp(path));
+     char line[64];
+     snprintf(line, sizeof(line), "set >%s 2>&1", path);
+     pipeline parsed;
+     TEST_ASSERT_EQUAL_INT(0, cmd_parse_pipeline(line, &parsed));
+     command *cmd = &parsed.commands[0];
+
+     TEST_ASSERT_EQUAL_INT(0, redirect_open(cmd));
+     int saved[2];
+     TEST_ASSERT_EQUAL_INT(0, redirect_apply(cmd, saved));
+     printf("to the file\n");
+     fflush(stdout);
+     fprintf(stderr, "also to the file\n");
+     redirect_restore(cmd, saved);
+     redirect_close(cmd);
+     cmd_free(NULL);
+
+     char contents[64] = {0};
+     FILE *file = fopen(path, "r");
+     fread(contents, 1, sizeof(contents) - 1, file);
+     fclose(file);
+     TEST_ASSERT_EQUAL_STRING("to the file\nalso to the file\n", contents);
+     TEST_ASSERT_EQUAL_INT(-1, redirect_open(&(command){NULL, NULL, &(redirection){REDIRECT_INPUT, 0, -1, "/nonexistent/file"}, 1}));
+     unlink(path);
+}
+
+void test_parallel_builtin(void)
+{
+     struct shell sh;
+     memset(&sh, 0, sizeof(sh));
+     reaper_install();
+
+     char *argv[] = {"parallel", "-j", "2", "sh", "-c", "exit {}", ":::", "0", "1", "0", "3", "0", NULL};
+     TEST_ASSERT_EQUAL_INT(2, parallel_builtin(&sh, argv));
+     TEST_ASSERT_EQUAL_size_t(0, jobs.count); // Every command was taken back out of the job table
+     childExit exited;
+     TEST_ASSERT_FALSE(reaper_next(&exited));
+
+     char *noCommand[] = {"parallel", "-j", "0", "true", NULL};
+     TEST_ASSERT_EQUAL_INT(255, parallel_builtin(&sh, noCommand));
+     signal(SIGCHLD, SIG_DFL);
+     pathcache_clear();
+}
+
+void test_builtin_in_pipeline(void)
+{
+     struct shell sh;
+     memset(&sh, 0, sizeof(sh));
+     reaper_install();
+     char path[] = "/tmp/test-pipeline-XXXXXX";
+     close(mkstemp(path));
+
+     // Both stages are builtins, so each runs in a copy of the shell and parallel reads the pipe
+     char line[128];
+     snprintf(line, sizeof(line), "printf 'a\\nb\\n' | parallel -j 1 echo n >%s", path);
+     pipeline parsed;
+     TEST_ASSERT_EQUAL_INT(0, cmd_parse_pipeline(line, &parsed));
+     pid_t pids[3];
+     size_t started;
+     fflush(stdout); // As the shell does, so the copies don't write what it buffered
+     TEST_ASSERT_EQUAL_INT(0, start_pipeline(&sh, &parsed, true, pids, &started));
+     TEST_ASSERT_EQUAL_size_t(2, started);
+     for (size_t idx = 0; idx < started; idx++)
+     {
+          int status;
+          TEST_ASSERT_EQUAL_INT(0, reaper_wait(pids[idx], &status));
+          TEST_ASSERT_EQUAL_INT(0, status);
+     }
+     cmd_free(NULL);
+
+     char contents[16] = {0};
+     FILE *file = fopen(path, "r");
+     fread(contents, 1, sizeof(contents) - 1, file);
+     fclose(file);
+     unlink(path);
+     TEST_ASSERT_EQUAL_STRING("n a\nn b\n", contents);
+     signal(SIGCHLD, SIG_DFL);
+     pathcache_clear();
+}
+
+void test_is_builtin(void)
+{
+     const char *builtins[] = {"jobs", "cd", "history", "hash", "set", "times", "shstat", "parallel", "exit"};
+     for (size_t idx = 0; idx < sizeof(builtins) / sizeof(builtins[0]); idx++)
+     {
+          TEST_ASSERT_TRUE_MESSAGE(is_builtin(builtins[idx]), builtins[idx]);
+     }
+     // Same slot or same first and last characters as a builtin, but not one
+     TEST_ASSERT_FALSE(is_builtin("ls"));
+     TEST_ASSERT_FALSE(is_builtin("jobz"));
+     TEST_ASSERT_FALSE(is_builtin("exist"));
+     TEST_ASSERT_FALSE(is_builtin("c"));
+     TEST_ASSERT_FALSE(is_builtin(""));
+}
+
+/**
+ * @brief runs a builtin line with its stdout redirected to a temporary file,
+ * and returns what it wrote in contents.
+ */
+static int runBuiltinCaptured(struct shell *sh, const char *line, char *contents, size_t size)
+{
+     char path[] = "/tmp/test-utilities-XXXXXX";
+     close(mkstemp(path));
+     char redirected[256];
+     snprintf(redirected, sizeof(redirected), "%s >%s", line, path);
+     pipeline parsed;
+     TEST_ASSERT_EQUAL_INT(0, cmd_parse_pipeline(redirected, &parsed));
+     command *cmd = &parsed.commands[0];
+     TEST_ASSERT_EQUAL_INT(0, redirect_open(cmd));
+     int saved[1];
+     TEST_ASSERT_EQUAL_INT(0, redirect_apply(cmd, saved));
+     TEST_ASSERT_TRUE(do_builtin(sh, cmd->argv));
+     redirect_restore(cmd, saved);
+     redirect_close(cmd);
+     cmd_free(NULL);
+
+     memset(contents, 0, size);
+     FILE *file = fopen(path, "r");
+     fread(contents, 1, size - 1, file);
+     fclose(file);
+     unlink(path);
+     return sh->status;
+}
+
+void test_utilities_output(void)
+{
+     struct shell sh;
+     memset(&sh, 0, sizeof(sh));
+     char contents[128];
+     runBuiltinCaptured(&sh, "echo one   two", contents, sizeof(contents));
+     TEST_ASSERT_EQUAL_STRING("one two\n", contents);
+     runBuiltinCaptured(&sh, "echo -n -e 'a\\tb\\c' c", contents, sizeof(contents));
+     TEST_ASSERT_EQUAL_STRING("a\tb", contents);
+     runBuiltinCaptured(&sh, "echo -x", contents, sizeof(contents));
+     TEST_ASSERT_EQUAL_STRING("-x\n", contents);
+
+     runBuiltinCaptured(&sh, "printf '%s=%03d|%-3s|%x\\n' a 7 b 255 c", contents, sizeof(contents));
+     TEST_ASSERT_EQUAL_STRING("a=007|b  |ff\nc=000|   |0\n", contents);
+     runBuiltinCaptured(&sh, "printf '%*.*s|%b|%c|%d' 4 2 xyz '\\0101' hello \"'A\"", contents, sizeof(contents));
+     TEST_ASSERT_EQUAL_STRING("  xy|A|h|65", contents);
+     TEST_ASSERT_EQUAL_INT(1, runBuiltinCaptured(&sh, "printf %d 12x", contents, sizeof(contents)));
+     TEST_ASSERT_EQUAL_STRING("12", contents);
+
+     // A bad directive stops printf with an error, and \c in %b stops it cleanly
+     TEST_ASSERT_EQUAL_INT(1, runBuiltinCaptured(&sh, "printf 'a%qb' x", contents, sizeof(contents)));
+     TEST_ASSERT_EQUAL_STRING("a", contents);
+     TEST_ASSERT_EQUAL_INT(1, runBuiltinCaptured(&sh, "printf '%ld\\n' 5", contents, sizeof(contents)));
+     TEST_ASSERT_EQUAL_INT(0, runBuiltinCaptured(&sh, "printf '%b-x\\n' 'a\\cb' c", contents, sizeof(contents)));
+     TEST_ASSERT_EQUAL_STRING("a", contents);
+     // Wider than the output buffer, so none of it may be cut off
+     static char wide[70004];
+     TEST_ASSERT_EQUAL_INT(0, runBuiltinCaptured(&sh, "printf 'a%70000s|' x", wide, sizeof(wide)));
+     TEST_ASSERT_EQUAL_size_t(70002, strlen(wide));
+     TEST_ASSERT_EQUAL_STRING("x|", wide + 70000);
+
+     char cwd[4096];
+     TEST_ASSERT_NOT_NULL(getcwd(cwd, sizeof(cwd) - 1));
+     strcat(cwd, "\n");
+     TEST_ASSERT_EQUAL_INT(0, runBuiltinCaptured(&sh, "pwd", contents, sizeof(contents)));
+     TEST_ASSERT_EQUAL_STRING(cwd, contents);
+}
+
+void test_utilities_test_status(void)
+{
+     struct shell sh;
+     memset(&sh, 0, sizeof(sh));
+     static const struct {
+          const char *line;
+          int status;
+     } cases[] = {
+          {"true", 0}, {"false", 1}, {"test", 1}, {"test x", 0}, {"test ''", 1}, {"test -n", 0},
+          {"test -d /", 0}, {"test -f /", 1}, {"[ -e /nonexistent ]", 1}, {"[ ! -e /nonexistent ]", 0},
+          {"[ abc = abc ]", 0}, {"[ abc != abc ]", 1}, {"[ ! = x ]", 1}, {"[ 3 -lt 12 ]", 0}, {"[ 3 -ge 12 ]", 1},
+          {"[ 1 -eq 1 -a x = y ]", 1}, {"[ 1 -eq 1 -o x = y ]", 0}, {"[ ( 1 -eq 2 ) -o -z '' ]", 0},
+          {"test x -eq 1", 2}, {"[ 1 = 1", 2}, {"test ( x", 2}, {"test a b", 2},
+     };
+     for (size_t idx = 0; idx < sizeof(cases) / sizeof(cases[0]); idx++)
+     {
+          char **argv = cmd_parse(cases[idx].line);
+          TEST_ASSERT_TRUE(do_builtin(&sh, argv));
+          TEST_ASSERT_EQUAL_INT_MESSAGE(cases[idx].status, sh.status, cases[idx].line);
+          cmd_free(argv);
+     }
+}
+
+void test_zygote_launch(void)
+{
+     struct shell sh;
+     memset(&sh, 0, sizeof(sh));
+     TEST_ASSERT_EQUAL_INT(0, zygote_start(&sh));
+     TEST_ASSERT_TRUE(zygote_running());
+
+     // The child gets the shell's working directory and redirections, and is the shell's child
+     char path[] = "/tmp/test-zygote-XXXXXX";
+     close(mkstemp(path));
+     char line[128];
+     snprintf(line, sizeof(line), "sh -c 'pwd; echo $PPID; echo err >&2' >%s 2>&1", path);
+     pipeline parsed;
+     TEST_ASSERT_EQUAL_INT(0, cmd_parse_pipeline(line, &parsed));
+     command *cmd = &parsed.commands[0];
+     cmd->path = pathcache_lookup("sh");
+     TEST_ASSERT_EQUAL_INT(0, redirect_open(cmd));
+     char cwd[256];
+     TEST_ASSERT_NOT_NULL(getcwd(cwd, sizeof(cwd)));
+     TEST_ASSERT_EQUAL_INT(0, chdir("/tmp"));
+     pid_t pid = launch_command(LAUNCH_ZYGOTE, &sh, cmd, STDIN_FILENO);
+     TEST_ASSERT_EQUAL_INT(0, chdir(cwd));
+     redirect_close(cmd);
+     cmd_free(NULL);
+     TEST_ASSERT_NOT_EQUAL(-1, pid);
+     int status;
+     TEST_ASSERT_EQUAL_INT(pid, waitpid(pid, &status, 0));
+     TEST_ASSERT_EQUAL_INT(0, WEXITSTATUS(status));
+
+     char contents[128] = {0};
+     char expected[128];
+     snprintf(expected, sizeof(expected), "/tmp\n%d\nerr\n", (int)getpid());
+     FILE *file = fopen(path, "r");
+     fread(contents, 1, sizeof(contents) - 1, file);
+     fclose(file);
+     unlink(path);
+     TEST_ASSERT_EQUAL_STRING(expected, contents);
+
+     // A program that is not there fails in the child, like with fork
+     char *missing[] = {"/nonexistent/program", NULL};
+     pid = launch_process(LAUNCH_ZYGOTE, &sh, missing[0], missing, false);
+     TEST_ASSERT_NOT_EQUAL(-1, pid);
+     TEST_ASSERT_EQUAL_INT(pid, waitpid(pid, &status, 0));
+     TEST_ASSERT_EQUAL_INT(127, WEXITSTATUS(status));
+
+     zygote_stop();
+     TEST_ASSERT_FALSE(zygote_running());
+     while (waitpid(-1, NULL, 0) > 0)
+     {   // Reap the zygote, which exits once its socket is closed
+     }
+     pathcache_clear();
+}
+
+/**
+ * @brief counts the times a watch's callback ran, and removes the watch if
+ * asked to.
+ */
+typedef struct watchCount {
+     eventLoop *loop;
+     int calls;
+     bool once;
+} watchCount;
+
+static void countWatch(int watch, void *context)
+{
+     watchCount *count = context;
+     count->calls++;
+     if (count->once)
+     {
+          eventloop_unwatch(count->loop, watch);
+     }
+}
+
+/**
+ * @brief runs the loop until count's callback has run calls times in all.
+ * A wait may run nothing, if a signal interrupted it.
+ */
+static void waitForCalls(eventLoop *loop, const watchCount *count, int calls)
+{
+     while (count->calls < calls)
+     {
+          TEST_ASSERT_NOT_EQUAL(-1, eventloop_wait(loop));
+     }
+}
+
+void test_eventloop(void)
+{
+     eventBackend backends[] = {EVENT_IO_URING, EVENT_EPOLL};
+     for (size_t idx = 0; idx < sizeof(backends) / sizeof(backends[0]); idx++)
+     {
+          eventLoop loop;
+          TEST_ASSERT_EQUAL_INT(0, eventloop_init(&loop, backends[idx]));
+
+          // A readable pipe fires every wait until its watch is removed
+          int fds[2];
+          TEST_ASSERT_EQUAL_INT(0, pipe(fds));
+          watchCount piped = {&loop, 0, false};
+          int pipeWatch = eventloop_watch_fd(&loop, fds[0], countWatch, &piped);
+          TEST_ASSERT_NOT_EQUAL(-1, pipeWatch);
+          TEST_ASSERT_EQUAL_INT(1, write(fds[1], "x", 1));
+          waitForCalls(&loop, &piped, 2);
+          eventloop_unwatch(&loop, pipeWatch);
+
+          // A child's exit, then a timer, each fire once and remove themselves
+          watchCount exited = {&loop, 0, true};
+          pid_t pid = fork();
+          if (pid == 0)
+          {
+               _exit(3);
+          }
+          TEST_ASSERT_NOT_EQUAL(-1, eventloop_watch_pid(&loop, pid, countWatch, &exited));
+          waitForCalls(&loop, &exited, 1);
+          int status;
+          TEST_ASSERT_EQUAL_INT(pid, waitpid(pid, &status, 0));
+          TEST_ASSERT_EQUAL_INT(3, WEXITSTATUS(status));
+          errno = 0;
+          TEST_ASSERT_EQUAL_INT(-1, eventloop_watch_pid(&loop, pid, countWatch, &exited));
+          TEST_ASSERT_EQUAL_INT(ESRCH, errno);
+
+          watchCount timer = {&loop, 0, true};
+          TEST_ASSERT_NOT_EQUAL(-1, eventloop_watch_timer(&loop, 10, countWatch, &timer));
+          waitForCalls(&loop, &timer, 1);
+          TEST_ASSERT_EQUAL_INT(1, timer.calls);
+          TEST_ASSERT_EQUAL_INT(1, exited.calls);
+          TEST_ASSERT_EQUAL_INT(2, piped.calls);
+
+          close(fds[0]);
+          close(fds[1]);
+          eventloop_destroy(&loop);
+     }
+}
+
+/**
+ * @brief a server handler that answers each line with the number it holds
+ * as its status, and stops at "stop".
+ */
+static bool echoStatus(char *line, lineUsage *result, void *context)
+{
+     UNUSED(context);
+     result->status = atoi(line);
+     result->real = 0.5;
+     return strcmp(line, "stop") != 0;
+}
+
+void test_server_batch(void)
+{
+     char path[] = "/tmp/test-server-XXXXXX";
+     close(mkstemp(path));
+     unlink(path);
+     pid_t server = fork();
+     if (server == 0)
+     {
+          _exit(server_run(path, echoStatus, NULL) == 0 ? 0 : 1);
+     }
+     TEST_ASSERT_NOT_EQUAL(-1, server);
+
+     struct sockaddr_un address = {.sun_family = AF_UNIX};
+     strcpy(address.sun_path, path);
+     int client = -1;
+     for (int tries = 0; tries < 200 && client == -1; tries++)
+     {
+          client = socket(AF_UNIX, SOCK_STREAM, 0);
+          if (connect(client, (struct sockaddr *)&address, sizeof(address)) != 0)
+          {
+               close(client);
+               client = -1;
+               usleep(10000);
+          }
+     }
+     TEST_ASSERT_NOT_EQUAL(-1, client);
+
+     // One write carries the whole batch, and every line is answered in order
+     const char *batch = "0\n3\n\n127\nstop\n";
+     TEST_ASSERT_EQUAL_INT((int)strlen(batch), write(client, batch, strlen(batch)));
+     char replies[4096] = {0};
+     size_t used = 0;
+     ssize_t bytes;
+     while ((bytes = read(client, replies + used, sizeof(replies) - 1 - used)) > 0)
+     {
+          used += (size_t)bytes;
+     }
+     close(client);
+     int expected[] = {0, 3, 0, 127, 0};
+     char *reply = replies;
+     for (size_t idx = 0; idx < sizeof(expected) / sizeof(expected[0]); idx++)
+     {
+          char *newline = strchr(reply, '\n');
+          TEST_ASSERT_NOT_NULL(newline);
+          *newline = '\0';
+          char want[32];
+          snprintf(want, sizeof(want), "\"status\":%d}", expected[idx]);
+          TEST_ASSERT_NOT_NULL(strstr(reply, want));
+          TEST_ASSERT_EQUAL_PTR(reply, strstr(reply, "{\"real\":0.500000,"));
+          reply = newline + 1;
+     }
+     TEST_ASSERT_EQUAL_STRING("", reply);
+
+     int status;
+     TEST_ASSERT_EQUAL_INT(server, waitpid(server, &status, 0));
+     TEST_ASSERT_EQUAL_INT(0, WEXITSTATUS(status));
+     TEST_ASSERT_EQUAL_INT(-1, access(path, F_OK));
+}
+
 int main(void) {
   #if RUNNING
   UNITY_BEGIN();
@@ -172,10 +1355,51 @@ int main(void) {
   RUN_TEST(test_trim_white_both_whitespace_single);
   RUN_TEST(test_trim_white_both_whitespace_double);
   RUN_TEST(test_trim_white_all_whitespace);
+  RUN_TEST(test_trim_white_mostly_whitespace);
+  RUN_TEST(test_trim_white_tabs);
+  RUN_TEST(test_trim_white_1mb_padding);
+  RUN_TEST(test_cmd_parse_tabs_and_repeated_spaces);
+  RUN_TEST(test_cmd_parse_blank);
+  RUN_TEST(test_cmd_parse_1mb_line);
+  RUN_TEST(test_tokenize_spans);
+  RUN_TEST(test_tokenize_operators);
+  RUN_TEST(test_cmd_parse_quotes);
+  RUN_TEST(test_lex_scanners_agree);
   RUN_TEST(test_get_prompt_default);
   RUN_TEST(test_get_prompt_custom);
   RUN_TEST(test_ch_dir_home);
   RUN_TEST(test_ch_dir_root);
+  RUN_TEST(test_pathcache_lookup);
+  RUN_TEST(test_pathcache_path_change);
+  RUN_TEST(test_options_set);
+  RUN_TEST(test_reaper_wait_keeps_other_exits);
+  RUN_TEST(test_jobs_numbering_and_lookup);
+  RUN_TEST(test_jobs_many);
+  RUN_TEST(test_jobs_queue);
+  RUN_TEST(test_jobs_grow_with_done_and_queued);
+  RUN_TEST(test_jobs_watcher);
+  RUN_TEST(test_usage_add);
+  RUN_TEST(test_shstat_percentiles);
+  RUN_TEST(test_histfile_append_and_load_tail);
+  RUN_TEST(test_histfile_compact);
+  RUN_TEST(test_histindex_search);
+  RUN_TEST(test_histindex_search_short_entries);
+  RUN_TEST(test_linereader_string);
+  RUN_TEST(test_linereader_file_lines_across_blocks);
+  RUN_TEST(test_cmd_parse_pipeline);
+  RUN_TEST(test_cmd_parse_list);
+  RUN_TEST(test_script_exit_status);
+  RUN_TEST(test_launch_pipeline_relay_exits);
+  RUN_TEST(test_cmd_parse_redirections);
+  RUN_TEST(test_redirect_apply_and_restore);
+  RUN_TEST(test_parallel_builtin);
+  RUN_TEST(test_builtin_in_pipeline);
+  RUN_TEST(test_is_builtin);
+  RUN_TEST(test_utilities_output);
+  RUN_TEST(test_utilities_test_status);
+  RUN_TEST(test_zygote_launch);
+  RUN_TEST(test_eventloop);
+  RUN_TEST(test_server_batch);
   #endif
 
   return UNITY_END();